@@ -0,0 +1,221 @@
+/**********************************************************************/
+/** @addtogroup embedded_gcov
+ * @{
+ * @file
+ * @version $Id: $
+ *
+ * @brief Formats of the data sent from the target to the host tools.
+ *
+ * Shared by the embedded gcov code and the host tools in tools/,
+ * so both sides agree on the layout of the transfer formats.
+ * Only plain constants here, no code and no user settings.
+ *
+ **********************************************************************/
+#ifndef GCOV_FORMAT_H
+#define GCOV_FORMAT_H GCOV_FORMAT_H
+
+/* Binary file and memory output (GCOV_OPT_OUTPUT_BINARY_FILE,
+ * GCOV_OPT_OUTPUT_BINARY_MEMORY) ---------------------------------- */
+/*
+ * For each file:
+ *   N bytes  filename, with trailing null char
+ *   4 bytes  gcda data byte count, MSB first
+ *   N bytes  the gcda data (or its transfer encoding, see below)
+ * After the last file:
+ *   9 bytes  GCOV_BINARY_END_MARKER, with trailing null char
+ *
+ * The byte count is that of the gcda data once expanded, so for
+ * transfer encoded data the host finds where the data ends by
+ * reading it. Older versions wrote count / 255 (instead of
+ * count / 256) as the third byte, wrong once the count reaches 255.
+ */
+#define GCOV_BINARY_END_MARKER  "Gcov End"
+
+/* Framed serial output (GCOV_OPT_OUTPUT_SERIAL_FRAMED) ------------- */
+/*
+ * Each frame is COBS encoded (so it contains no zero bytes)
+ * and sent between two zero delimiter bytes, so the host can
+ * find frames in a log that also holds console text.
+ *
+ * Before COBS encoding a frame is:
+ *   1 byte   frame type, GCOV_FRAME_*
+ *   2 bytes  sequence number, MSB first, 0 for the OPEN frame of
+ *            each dump and incremented (mod 65536) for every frame
+ *   N bytes  payload, depending on type
+ *   4 bytes  CRC-32 (IEEE 802.3, as zlib crc32) of the type,
+ *            sequence and payload bytes, MSB first
+ *
+ * Payloads:
+ *   OPEN   none, start of a dump
+ *   BEGIN  4 byte gcda data byte count, MSB first, then the
+ *          filename (no trailing null char)
+ *   DATA   up to GCOV_FRAME_DATA_SIZE bytes of gcda data
+ *   END    none, end of the current file
+ *   CLOSE  none, end of the dump
+ *
+ * A missing sequence number tells the host that a frame was lost
+ * or damaged, so it can drop the file instead of writing bad data.
+ */
+#define GCOV_FRAME_DELIMITER    0x00
+#define GCOV_FRAME_OPEN         'O'
+#define GCOV_FRAME_BEGIN        'B'
+#define GCOV_FRAME_DATA         'D'
+#define GCOV_FRAME_END          'E'
+#define GCOV_FRAME_CLOSE        'C'
+
+/* Bytes of type and sequence number before the payload */
+#define GCOV_FRAME_HEADER_SIZE  3
+/* Bytes of CRC after the payload */
+#define GCOV_FRAME_CRC_SIZE     4
+
+/* Reflected CRC-32 polynomial, as used by zlib and Ethernet */
+#define GCOV_FRAME_CRC_POLY     0xEDB88320UL
+
+/* Transfer encoding (GCOV_OPT_TRANSFER_PACKED, GCOV_OPT_DELTA_DUMP,
+ * GCOV_OPT_TRANSFER_LZ, GCOV_OPT_TEST_CAPTURE, GCOV_OPT_TRANSFER_HITS) */
+/*
+ * Replaces the gcda data of each file (whatever the output method)
+ * with a shorter encoding of the same 32-bit words, and/or with
+ * only the functions that changed since the file was last sent.
+ *
+ * Packed: most counters are zero or small, a zero counter is two
+ * zero words, and the record tags repeat over and over.
+ *
+ * Delta: the gcda data holds the header and only the function
+ * records (each with its counter records) whose counters changed.
+ * Records of unchanged functions, and the empty records of
+ * functions whose counters are in another file, are left out,
+ * and a file where nothing changed is not sent at all.
+ * The host replaces the records with the same function ident
+ * in its copy of the file, which it last updated from the dump
+ * with the base generation number; if it did not, some update
+ * was lost and the result may be stale.
+ *
+ * Test: the file is from the dump at the end of a test, which
+ * holds only the files the test ran code in. The host keeps the
+ * files of each test id apart from those of other tests and of
+ * ordinary dumps. Test dumps are never deltas.
+ *
+ * Hits: only whether each counter is nonzero is sent. The values of
+ * each counter record (not its tag and length, which still give the
+ * number of values) are replaced by GCOV_TRANSFER_HIT_WORDS(count)
+ * words, bit i % 32 of word i / 32 set if value i is nonzero.
+ * All-zero counter records of gcc 12 and later have no values,
+ * so no bits either. The host writes each value as 0 or 1.
+ * Top N value and indirect call profiles (counter types 3 and 4,
+ * gcc 11 and later) are sent as they are, not as bitmaps.
+ *
+ * The transfer data of a file is:
+ *   4 bytes  GCOV_TRANSFER_MAGIC, MSB first (not a valid gcda start)
+ *   token    flags, GCOV_TRANSFER_*, kind WORD
+ *   token    dump generation number, kind WORD,
+ *            only with the GENERATION flag
+ *   token    base generation number, kind WORD, only with the DELTA flag
+ *   token    test id, kind WORD, only with the TEST flag
+ *   token    gcda data byte count once expanded, kind WORD
+ *            (with the HITS flag, of the gcda data with hit bitmaps)
+ *   then, with the PACKED flag:
+ *   tokens   the gcda words, until the byte count is reached
+ *   or without it:
+ *   bytes    the gcda data, as is
+ *
+ * With the LZ flag, everything after the header tokens (the tokens
+ * or the gcda data) is compressed, as groups of up to 8 items:
+ *   1 byte   flags, bit 0 for the first item: 0 literal, 1 match
+ *   items    literal: 1 byte, as is
+ *            match: 2 bytes MSB first, (length - 3) << 12 | (offset - 1),
+ *            copy length bytes (3 to 18) from offset bytes back
+ *            (1 to 4096), one byte at a time, so the copy can
+ *            overlap the bytes it makes
+ * The last group ends with the data. Offsets only reach back into
+ * the same file's data; how far back is up to the target's window.
+ *
+ * The dump generation number goes up by one for every dump.
+ *
+ * A token is an unsigned LEB128 number (7 bits per byte, least
+ * significant group first, high bit set on all but the last byte)
+ * holding (value << 2) | kind, so it takes 1 to 5 bytes:
+ *   WORD     value is the next word
+ *   ZEROS    value + 1 zero words follow
+ *   NEGATED  the next word is -value (such as the negated lengths
+ *            of all-zero counter arrays)
+ *   RECENT   the next word is entry value of the recent words list
+ *
+ * The recent words list has GCOV_TRANSFER_RECENT_WORDS entries,
+ * all zero at the start of each file. A WORD token (after the
+ * header tokens) with a value of 32 or more is put first in the list,
+ * moving the others down and dropping the last one; a RECENT token
+ * moves its entry first. Both ends keep the list the same way.
+ *
+ * Words are in target byte order when expanded, as in the gcda data.
+ * The sinks' begin length is still the expanded gcda byte count.
+ */
+#define GCOV_TRANSFER_MAGIC     0x67637470UL    /* "gctp" */
+
+/* Flags */
+#define GCOV_TRANSFER_PACKED     0x01   /* zero runs and varint words */
+#define GCOV_TRANSFER_GENERATION 0x02   /* dump generation number follows */
+#define GCOV_TRANSFER_DELTA      0x04   /* changed functions only, base generation follows */
+#define GCOV_TRANSFER_LZ         0x08   /* LZ compressed after the header */
+#define GCOV_TRANSFER_TEST       0x10   /* from a test dump, test id follows */
+#define GCOV_TRANSFER_HITS       0x20   /* hit bitmaps instead of counter values */
+
+/* Token kinds */
+#define GCOV_TRANSFER_WORD      0
+#define GCOV_TRANSFER_ZEROS     1
+#define GCOV_TRANSFER_NEGATED   2
+#define GCOV_TRANSFER_RECENT    3
+#define GCOV_TRANSFER_KIND_BITS 2
+
+/* Entries in the recent words list */
+#define GCOV_TRANSFER_RECENT_WORDS 8
+
+/* Smallest WORD value that goes into the recent words list */
+#define GCOV_TRANSFER_RECENT_MIN 32
+
+/* Words of hit bitmap for a counter record of count values */
+#define GCOV_TRANSFER_HIT_WORDS(count) (((count) + 31) / 32)
+
+/* Largest token, in bytes */
+#define GCOV_TRANSFER_TOKEN_MAX 5
+
+/* LZ match limits */
+#define GCOV_TRANSFER_LZ_MIN_MATCH  3
+#define GCOV_TRANSFER_LZ_MAX_MATCH  18
+#define GCOV_TRANSFER_LZ_MAX_OFFSET 4096
+
+#endif /* GCOV_FORMAT_H */
+
+/** @}
+ */
+/*
+ * embedded-gcov gcov_format.h target to host transfer formats
+ *
+ * Copyright (c) 2021 California Institute of Technology (“Caltech”).
+ * U.S. Government sponsorship acknowledged.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *        this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *        this list of conditions and the following disclaimer in the documentation
+ *        and/or other materials provided with the distribution.
+ *    Neither the name of Caltech nor its operating division, the Jet Propulsion Laboratory,
+ *        nor the names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
@@ -30,7 +30,10 @@
  *  Uses gcc-internal data definitions.
  */
 
+#include <string.h> // for memcpy, memset
+
 #include "gcov_gcc.h"
+#include "gcov_format.h"
 
 #ifdef GCOV_OPT_RESET_WATCHDOG
 /* In an embedded system, you might want to reset any watchdog timer below, */
@@ -90,6 +93,7 @@ typedef void (*gcov_merge_fn) (gcov_type *, gcov_unsigned_t);
  * @version: gcov version magic indicating the gcc version used for compilation
  * @next: list head for a singly-linked list
  * @stamp: uniquifying time stamp
+ * @checksum: unique object checksum (gcc 12 and later)
  * @filename: name of the associated gcov data file
  * @merge: merge functions (null for unused counter type)
  * @n_functions: number of instrumented functions
@@ -103,12 +107,32 @@ struct gcov_info {
 	gcov_unsigned_t version;
 	struct gcov_info *next;
 	gcov_unsigned_t stamp;
+#if GCOV_HEADER_CHECKSUM
+	gcov_unsigned_t checksum;
+#endif
 	const char *filename;
 	gcov_merge_fn merge[GCOV_COUNTERS];
 	unsigned n_functions;
 	struct gcov_fn_info **functions;
 };
 
+#if GCOV_TOPN_LISTS
+/**
+ * struct gcov_kvp - one (value, count) pair of a top N value profile
+ * @value: profiled value
+ * @count: number of times the value was seen
+ * @next: next pair of the same profile, or NULL
+ *
+ * The third counter of each top N group points to the first pair.
+ */
+/* Compare to libgcc/libgcov.h */
+struct gcov_kvp {
+	gcov_type value;
+	gcov_type count;
+	struct gcov_kvp *next;
+};
+#endif
+
 /**
  * gcov_info_filename - return info filename
  * @info: profiling data set
@@ -120,132 +144,447 @@ const char *gcov_info_filename(struct gcov_info *info)
 	return info->filename;
 }
 
+/**
+ * gcov_info_next - return next profiling data set
+ * @info: profiling data set
+ *
+ * Returns the data set linked after @info, or NULL at the end of the list.
+ * The list is chained through the next field gcc provides for this.
+ */
+struct gcov_info *gcov_info_next(struct gcov_info *info)
+{
+	return info->next;
+}
+
+/**
+ * gcov_info_set_next - link a profiling data set to the next one
+ * @info: profiling data set
+ * @next: data set to follow @info, or NULL
+ */
+void gcov_info_set_next(struct gcov_info *info, struct gcov_info *next)
+{
+	info->next = next;
+}
+
 /* See gcc/gcov-io.h for description of number formats */
 
 /**
  * store_gcov_unsigned - store 32 bit number in gcov format to buffer
- * @buffer: target buffer or NULL
+ * @buffer: target buffer
  * @off: offset into the buffer
  * @v: value to be stored
  *
  * Number format defined by gcc: numbers are recorded in the 32 bit
  * unsigned binary form of the endianness of the machine generating the
- * file. Returns the number of bytes stored. If @buffer is %NULL, doesn't
- * store anything.
+ * file. Returns the number of buffer words stored.
  */
 /* Slightly like gcc/gcov-io.c function gcov_write_unsigned() (1-word item) */
-/* Need buffer to be 32-bit-aligned for type-safe internal usage */
 static size_t store_gcov_unsigned(gcov_unsigned_t *buffer, size_t off, gcov_unsigned_t v)
 {
-	gcov_unsigned_t *data;
+	buffer[off] = v;
 
-	if (buffer) {
-		data = buffer + off;
-		*data = v;
-	}
-
-	/* return count of buffer data type units */
-	return sizeof(*data)/sizeof(*buffer);
+	return 1;
 }
 
 /**
  * store_gcov_tag_length - 32 bit tag and 32 bit length in gcov format to buffer
- * @buffer: target buffer or NULL
+ * @buffer: target buffer
  * @off: offset into the buffer
  * @tag: tag value to be stored
  * @length: length value to be stored
  *
  * Number format defined by gcc: numbers are recorded in the 32 bit
  * unsigned binary form of the endianness of the machine generating the
- * file. 64 bit numbers are stored as two 32 bit numbers, the low part
- * first. Returns the number of bytes stored. If @buffer is %NULL, doesn't store
- * anything.
+ * file. Returns the number of buffer words stored.
  */
 /* Slightly like gcc/gcov-io.c function gcov_write_tag_length() (1-word tag and 1-word length) */
 /* or gcov_write_tag() (1-word tag and implied 1-word "length = 0") */
-/* Need buffer to be 32-bit-aligned for type-safe internal usage */
 static size_t store_gcov_tag_length(gcov_unsigned_t *buffer, size_t off, gcov_unsigned_t tag, gcov_unsigned_t length)
 {
-	gcov_unsigned_t *data;
-
-	if (buffer) {
-		data = buffer + off;
+	buffer[off] = tag;
+	buffer[off + 1] = length;
 
-		data[0] = tag;
-		data[1] = length;
-	}
-
-	/* return count of buffer data type units */
-	return sizeof(*data)/sizeof(*buffer) * 2;
+	return 2;
 }
 
 /**
  * store_gcov_counter - store 64 bit number in gcov format to buffer
- * @buffer: target buffer or NULL
+ * @buffer: target buffer
  * @off: offset into the buffer
  * @v: value to be stored
  *
  * Number format defined by gcc: numbers are recorded in the 32 bit
  * unsigned binary form of the endianness of the machine generating the
  * file. 64 bit numbers are stored as two 32 bit numbers, the low part
- * first. Returns the number of bytes stored. If @buffer is %NULL, doesn't store
- * anything.
+ * first. Returns the number of buffer words stored.
  */
 /* Slightly like gcc/gcov-io.c function gcov_write_counter() (2-word item) */
-/* Need buffer to be 32-bit-aligned for type-safe internal usage */
 static size_t store_gcov_counter(gcov_unsigned_t *buffer, size_t off, gcov_type v)
 {
-	gcov_unsigned_t *data;
+	buffer[off] = (gcov_unsigned_t)(v & 0xffffffffUL);
+	buffer[off + 1] = (gcov_unsigned_t)(v >> 32);
+
+	return 2;
+}
+
+/**
+ * gcov_fn_selected - test whether a function's data belongs to this data set
+ * @info: profiling data set
+ * @fn: function information, may be NULL
+ *
+ * An inline or template function compiled into several object files
+ * (a comdat function) keeps only one copy at link time. Each object file
+ * still lists the function, but only the file holding the selected copy
+ * is the function's key. The other entries get an empty function record
+ * and no counters, so the host does not read the same counts twice.
+ */
+/* Compare to libgcc/libgcov-driver.c function write_one_data() */
+static int gcov_fn_selected(const struct gcov_info *gi_ptr, const struct gcov_fn_info *fi_ptr)
+{
+	return fi_ptr && fi_ptr->key == gi_ptr;
+}
+
+/* Encoder positions, what gcov_gcda_fill() produces next */
+enum {
+	GCOV_CURSOR_HEADER,	/* file header */
+	GCOV_CURSOR_SUMMARY,	/* object summary */
+	GCOV_CURSOR_FUNCTION,	/* function record of functions[fi_idx] */
+	GCOV_CURSOR_COUNTER,	/* counter record header of counter type ct_idx */
+	GCOV_CURSOR_VALUES,	/* counter values from cv_idx on */
+	GCOV_CURSOR_DONE
+};
+
+/**
+ * gcov_gcda_start - set up a cursor to convert one profiling data set
+ * @cursor: encoder position to be set up
+ * @info: profiling data set to be converted
+ */
+void gcov_gcda_start(struct gcov_cursor *cursor, struct gcov_info *gi_ptr)
+{
+	cursor->info = gi_ptr;
+	cursor->state = GCOV_CURSOR_HEADER;
+	cursor->fi_idx = 0;
+	cursor->ct_idx = 0;
+	cursor->cv_idx = 0;
+	cursor->ci_ptr = NULL;
+	cursor->snapshot = NULL;
+	cursor->fingerprints = NULL;
+	cursor->delta = 0;
+	cursor->reset = 0;
+	cursor->hits = 0;
+	cursor->kv_part = 0;
+	cursor->kv_left = 0;
+	cursor->kvp = NULL;
+	cursor->choices = NULL;
+	cursor->choices_bits = 0;
+	cursor->choices_made = 0;
+	cursor->choice_idx = 0;
+	cursor->sized = 0;
+}
+
+/**
+ * gcov_fingerprints_count - number of fingerprints for a profiling data set
+ * @info: profiling data set
+ *
+ * A delta dump keeps one fingerprint per function, see gcov_gcda_fill().
+ */
+size_t gcov_fingerprints_count(struct gcov_info *gi_ptr)
+{
+	return gi_ptr->n_functions;
+}
+
+/**
+ * gcov_hash_word - add one word to a hash
+ * @hash: hash so far, 2166136261 to start
+ * @v: word to be added
+ *
+ * FNV-1a, but a word at a time instead of a byte at a time.
+ */
+static gcov_unsigned_t gcov_hash_word(gcov_unsigned_t hash, gcov_unsigned_t v)
+{
+	return (gcov_unsigned_t)((hash ^ v) * 16777619UL);
+}
+
+/**
+ * gcov_fn_fingerprint - hash the counter values of one function
+ * @info: profiling data set
+ * @fn: function information, selected in @info
+ * @snapshot: the function's first value in a snapshot, or NULL for live counters
+ * @count: set to the number of values of the function
+ *
+ * A delta dump leaves a function out when this is unchanged
+ * since the function was last dumped.
+ */
+static gcov_unsigned_t gcov_fn_fingerprint(const struct gcov_info *gi_ptr,
+					   const struct gcov_fn_info *fi_ptr,
+					   const gcov_type *snapshot, size_t *count)
+{
+	const struct gcov_ctr_info *ci_ptr = fi_ptr->ctrs;
+	gcov_unsigned_t hash = 2166136261UL;
+	unsigned int ct_idx;
+	unsigned int cv_idx;
 
-	if (buffer) {
-		data = buffer + off;
+	*count = 0;
+	for (ct_idx = 0; ct_idx < GCOV_COUNTERS; ct_idx++) {
+		const gcov_type *values;
 
-		data[0] = (v & 0xffffffffUL);
-		data[1] = (v >> 32);
+		if (!gi_ptr->merge[ct_idx]) {
+			/* Unused counter */
+			continue;
+		}
+		values = snapshot ? snapshot + *count : ci_ptr->values;
+		for (cv_idx = 0; cv_idx < ci_ptr->num; cv_idx++) {
+			hash = gcov_hash_word(hash, (gcov_unsigned_t)(values[cv_idx] & 0xffffffffUL));
+			hash = gcov_hash_word(hash, (gcov_unsigned_t)(values[cv_idx] >> 32));
+		}
+		*count += ci_ptr->num;
+		ci_ptr++;
 	}
 
-	/* return count of buffer data type units */
-	return sizeof(*data)/sizeof(*buffer) * 2;
+	return hash;
 }
 
+/* Widths of the choices the size of a file depends on, in bits */
+#define GCOV_CHOICE_BITS_ZERO	1	/* counter array all zero */
+#define GCOV_CHOICE_BITS_SEND	1	/* function changed since the last dump */
+#define GCOV_CHOICE_BITS_PAIRS	6	/* pairs of a top N group, 32 at most */
+
 /**
- * gcov_convert_to_gcda - convert profiling data set to gcda file format
- * @buffer: the buffer to store file data or %NULL if no data should be stored
- * @info: profiling data set to be converted
+ * gcov_choice - make or repeat a choice the size of the file depends on
+ * @cursor: encoder position
+ * @pos: position of the choice in the cursor's choices, in bits, moved past it
+ * @bits: width of the choice, 32 at most
+ * @value: the choice as the counter values are now
+ * @fallback: the choice when there was no room to remember it
+ * @make: make the choice, rather than repeat one made before
  *
- * Returns the number of bytes that were/would have been stored into the buffer.
+ * Live counters can change between gcov_gcda_size() and gcov_gcda_fill(),
+ * so the size pass makes each choice once and remembers it, and the fill
+ * (or another size pass) repeats it instead of looking at the values
+ * again. Past the room the cursor has, the choice is @fallback.
+ * From a snapshot the values cannot change, so @value is used as it is.
+ * Returns the choice to go by.
  */
-/* Our own creation, but compare to libgcc/libgcov-driver.c function write_one_data() */
-/* Need buffer to be 32-bit-aligned for type-safe internal usage */
-size_t gcov_convert_to_gcda(gcov_unsigned_t *buffer, struct gcov_info *gi_ptr)
+static unsigned int gcov_choice(struct gcov_cursor *cursor, unsigned int *pos, unsigned int bits,
+				unsigned int value, unsigned int fallback, int make)
+{
+	gcov_unsigned_t *word;
+	unsigned int shift;
+	unsigned int mask = (bits < 32) ? (1U << bits) - 1 : 0xffffffffU;
+	unsigned int at = *pos;
+
+	if (cursor->snapshot) {
+		return value;
+	}
+
+	*pos += bits;
+	if (make) {
+		if (!cursor->choices || *pos > cursor->choices_bits) {
+			return fallback;
+		}
+		cursor->choices_made = *pos;
+	} else if (*pos > cursor->choices_made) {
+		return fallback;
+	}
+
+	/* Bit at of the choices is bit 0 of the choice; a choice
+	 * may run over into the next word */
+	word = cursor->choices + at / 32;
+	shift = at % 32;
+	if (make) {
+		word[0] = (word[0] & ~(mask << shift)) | ((value & mask) << shift);
+		if (shift + bits > 32) {
+			word[1] = (word[1] & ~(mask >> (32 - shift))) | ((value & mask) >> (32 - shift));
+		}
+		return value & mask;
+	}
+	value = word[0] >> shift;
+	if (shift + bits > 32) {
+		value |= word[1] << (32 - shift);
+	}
+	return value & mask;
+}
+
+#if GCOV_COMPACT_ZERO_COUNTERS
+/**
+ * gcov_values_zero - test whether counter values are all zero
+ * @values: counter values
+ * @num: number of values
+ *
+ * Such an array is written as a counter record with negated length
+ * and no values, see gcov_gcda_fill().
+ */
+/* Compare to libgcc/libgcov-driver.c function are_all_counters_zero() */
+static int gcov_values_zero(const gcov_type *values, gcov_unsigned_t num)
+{
+	gcov_unsigned_t i;
+
+	for (i = 0; i < num; i++) {
+		if (values[i]) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+#endif
+
+#if GCOV_SUMMARY_WORDS
+/**
+ * gcov_run_max - find the largest arc count of a profiling data set
+ * @cursor: encoder position, fresh from gcov_gcda_start()
+ *
+ * Reads the snapshot if the cursor has one, as the encoder does.
+ * The object summary holds this, as sum_max.
+ */
+/* Compare to libgcc/libgcov-driver.c function dump_one_gcov() */
+static gcov_type gcov_run_max(const struct gcov_cursor *cursor)
 {
+	const struct gcov_info *gi_ptr = cursor->info;
 	const struct gcov_fn_info *fi_ptr;
 	const struct gcov_ctr_info *ci_ptr;
+	const gcov_type *snapshot = cursor->snapshot;
 	unsigned int fi_idx;
 	unsigned int ct_idx;
 	unsigned int cv_idx;
-	size_t pos = 0; /* offset in buffer, in buffer data type units */
+	gcov_type run_max = 0;
 
-	/* File header. */
-	pos += store_gcov_tag_length(buffer, pos, GCOV_DATA_MAGIC, gi_ptr->version);
-	pos += store_gcov_unsigned(buffer, pos, gi_ptr->stamp);
+	for (fi_idx = 0; fi_idx < gi_ptr->n_functions; fi_idx++) {
+		fi_ptr = gi_ptr->functions[fi_idx];
+		if (!gcov_fn_selected(gi_ptr, fi_ptr)) {
+			continue;
+		}
+		ci_ptr = fi_ptr->ctrs;
+
+		for (ct_idx = 0; ct_idx < GCOV_COUNTERS; ct_idx++) {
+			if (!gi_ptr->merge[ct_idx]) {
+				/* Unused counter */
+				continue;
+			}
+			if (ct_idx == GCOV_COUNTER_ARCS) {
+				const gcov_type *values = snapshot ? snapshot : ci_ptr->values;
+
+				for (cv_idx = 0; cv_idx < ci_ptr->num; cv_idx++) {
+					if (run_max < values[cv_idx]) {
+						run_max = values[cv_idx];
+					}
+				}
+			}
+			if (snapshot) {
+				snapshot += ci_ptr->num;
+			}
+			ci_ptr++;
+		}
+	}
+
+	return run_max;
+}
+#endif
+
+#if GCOV_TOPN_LISTS
+/**
+ * gcov_topn_pairs - number of pairs a top N group has in the file
+ * @group: the group's counters: total, number of pairs, list
+ *
+ * Pairs are only added at the end of the list, and the number
+ * counted after, so that many pairs can always be followed.
+ */
+static gcov_unsigned_t gcov_topn_pairs(const gcov_type *group)
+{
+	if (group[1] <= 0 || !group[2]) {
+		return 0;
+	}
+	if (group[1] > GCOV_TOPN_MAXIMUM_TRACKED_VALUES) {
+		return GCOV_TOPN_MAXIMUM_TRACKED_VALUES;
+	}
+	return (gcov_unsigned_t)group[1];
+}
+
+/**
+ * gcov_topn_counters - number of counters a top N array has in the file
+ * @cursor: encoder position
+ * @pos: position of the array's choices, moved past them
+ * @values: counters of the array, in groups of GCOV_TOPN_MEM_COUNTERS
+ * @num: number of counters
+ * @make: make the choices, rather than repeat them, see gcov_choice()
+ *
+ * The pair count of each group is a choice, which gcov_fill_topn()
+ * repeats when it writes the group, so the record keeps to its length.
+ * Without room to remember it, a group is written with no pairs.
+ */
+/* Compare to libgcc/libgcov-driver.c function write_topn_counters() */
+static gcov_unsigned_t gcov_topn_counters(struct gcov_cursor *cursor, unsigned int *pos,
+					  const gcov_type *values, gcov_unsigned_t num, int make)
+{
+	gcov_unsigned_t count = 0;
+	gcov_unsigned_t i;
+
+	for (i = 0; i + GCOV_TOPN_MEM_COUNTERS <= num; i += GCOV_TOPN_MEM_COUNTERS) {
+		count += GCOV_TOPN_DISK_COUNTERS +
+			 2 * gcov_choice(cursor, pos, GCOV_CHOICE_BITS_PAIRS,
+					 gcov_topn_pairs(values + i), 0, make);
+	}
+
+	return count;
+}
+#endif
+
+/**
+ * gcov_gcda_size - compute size of profiling data set in gcda file format
+ * @cursor: encoder position, fresh from gcov_gcda_start()
+ *
+ * Returns the number of bytes that gcov_gcda_fill() will produce
+ * (so fewer with hits set in the cursor). Call it before the fill.
+ * Only the record lengths are visited, not the counter values, except
+ * to find all-zero counter arrays for gcc 12 and later, functions
+ * changed since the last dump with delta set, and the number
+ * of pairs of top N value profiles. There the size depends on the
+ * values, so with live counters these choices are made here once and
+ * remembered in the cursor's choices, for the fill (and any later
+ * call of this, such as with hits set) to repeat, see gcov_choice().
+ */
+size_t gcov_gcda_size(struct gcov_cursor *cursor)
+{
+	const struct gcov_info *gi_ptr = cursor->info;
+	const struct gcov_fn_info *fi_ptr;
+	const struct gcov_ctr_info *ci_ptr;
+	const gcov_type *snapshot = cursor->snapshot;
+	unsigned int fi_idx;
+	unsigned int ct_idx;
+	unsigned int choice_idx = 0;
+	int make = !cursor->sized;
+	size_t words;
+
+	/* File header and object summary. */
+	words = GCOV_HEADER_WORDS + GCOV_SUMMARY_WORDS;
 
-	/* Write execution counts for each function.  */
 	for (fi_idx = 0; fi_idx < gi_ptr->n_functions; fi_idx++) {
 		fi_ptr = gi_ptr->functions[fi_idx];
 
-#ifdef GCOV_OPT_RESET_WATCHDOG
-		/* In an embedded system, you might want to reset any watchdog timer here, */
-		/* depending on your timeout versus gcov tree size */
-		SP_WDG = WATCHDOG_RESET;
-#endif // GCOV_OPT_RESET_WATCHDOG
+		if (!gcov_fn_selected(gi_ptr, fi_ptr)) {
+			/* Empty function record: tag and zero length. */
+			if (!cursor->delta) {
+				words += 2;
+			}
+			continue;
+		}
+
+		if (cursor->delta) {
+			size_t count;
+			gcov_unsigned_t hash = gcov_fn_fingerprint(gi_ptr, fi_ptr, snapshot, &count);
 
-		/* Function record. */
-		pos += store_gcov_tag_length(buffer, pos, GCOV_TAG_FUNCTION, GCOV_TAG_FUNCTION_LENGTH);
+			if (!gcov_choice(cursor, &choice_idx, GCOV_CHOICE_BITS_SEND,
+					 hash != cursor->fingerprints[fi_idx], 1, make)) {
+				/* Unchanged since the last dump, left out. */
+				if (snapshot) {
+					snapshot += count;
+				}
+				continue;
+			}
+		}
 
-		pos += store_gcov_unsigned(buffer, pos, fi_ptr->ident);
-		pos += store_gcov_unsigned(buffer, pos, fi_ptr->lineno_checksum);
-		pos += store_gcov_unsigned(buffer, pos, fi_ptr->cfg_checksum);
+		/* Function record: tag, length, ident and checksums. */
+		words += 2 + GCOV_TAG_FUNCTION_WORDS;
 
 		ci_ptr = fi_ptr->ctrs;
 
@@ -255,27 +594,683 @@ size_t gcov_convert_to_gcda(gcov_unsigned_t *buffer, struct gcov_info *gi_ptr)
 				continue;
 			}
 
+#if GCOV_TOPN_LISTS
+			if (GCOV_COUNTER_IS_TOPN(ct_idx)) {
+				/* Never as hit bitmaps either */
+				words += 2 + GCOV_TAG_COUNTER_WORDS(gcov_topn_counters(cursor, &choice_idx,
+					snapshot ? snapshot : ci_ptr->values, ci_ptr->num, make));
+				if (snapshot) {
+					snapshot += ci_ptr->num;
+				}
+				ci_ptr++;
+				continue;
+			}
+#endif
+
+			/* Counter record: tag, length, values. */
+			words += 2;
+#if GCOV_COMPACT_ZERO_COUNTERS
+			if (!gcov_choice(cursor, &choice_idx, GCOV_CHOICE_BITS_ZERO,
+					 gcov_values_zero(snapshot ? snapshot : ci_ptr->values, ci_ptr->num),
+					 0, make))
+#endif
+			{
+				words += cursor->hits ? GCOV_TRANSFER_HIT_WORDS(ci_ptr->num) :
+							GCOV_TAG_COUNTER_WORDS(ci_ptr->num);
+			}
+			if (snapshot) {
+				snapshot += ci_ptr->num;
+			}
+			ci_ptr++;
+		}
+	}
+
+	cursor->sized = 1;
+	return words * sizeof(gcov_unsigned_t);
+}
+
+/**
+ * gcov_fill_hits - store hit bitmap words of the current counter record
+ * @cursor: encoder position, in the values of a counter record
+ * @buffer: where to store the words
+ * @max_words: room in @buffer, in words
+ *
+ * Each word holds one bit for each of up to 32 values, set if the value
+ * is nonzero. Values come from the snapshot if the cursor has one,
+ * else from the live counters, which are zeroed if the cursor resets.
+ * Returns the number of words stored.
+ */
+static size_t gcov_fill_hits(struct gcov_cursor *cursor, gcov_unsigned_t *buffer, size_t max_words)
+{
+	const struct gcov_ctr_info *ci_ptr = cursor->ci_ptr;
+	size_t pos = 0;
+
+	while (cursor->cv_idx < ci_ptr->num && pos < max_words) {
+		gcov_type *values = ci_ptr->values + cursor->cv_idx;
+		gcov_unsigned_t word = 0;
+		unsigned int n = ci_ptr->num - cursor->cv_idx;
+		unsigned int i;
+
+		if (n > 32) {
+			n = 32;
+		}
+		if (cursor->snapshot) {
+			for (i = 0; i < n; i++) {
+				word |= (gcov_unsigned_t)(cursor->snapshot[i] != 0) << i;
+			}
+			cursor->snapshot += n;
+		} else {
+			for (i = 0; i < n; i++) {
+				gcov_type v = values[i];
+
+				if (cursor->reset) {
+					values[i] = 0;
+				}
+				word |= (gcov_unsigned_t)(v != 0) << i;
+			}
+		}
+		buffer[pos++] = word;
+		cursor->cv_idx += n;
+	}
+
+	return pos;
+}
+
+#if GCOV_TOPN_LISTS
+/**
+ * gcov_fill_topn - store counters of the current top N counter record
+ * @cursor: encoder position, in the values of a top N counter record
+ * @buffer: where to store the counters
+ * @max_words: room in @buffer, in words
+ *
+ * Each group of counters in memory (total, number of pairs, list)
+ * is stored as the total, the number of pairs, then each pair's
+ * value and count, one counter at a time, so any buffer of
+ * GCOV_CURSOR_MIN_WORDS makes progress. The group comes from the
+ * snapshot if the cursor has one, else from the live counters,
+ * which are zeroed once read if the cursor resets. The pairs
+ * themselves are always live.
+ * Returns the number of words stored.
+ */
+/* Compare to libgcc/libgcov-driver.c function write_topn_counters() */
+static size_t gcov_fill_topn(struct gcov_cursor *cursor, gcov_unsigned_t *buffer, size_t max_words)
+{
+	const struct gcov_ctr_info *ci_ptr = cursor->ci_ptr;
+	size_t pos = 0;
+
+	while (cursor->cv_idx < ci_ptr->num && max_words - pos >= 2) {
+		gcov_type *values = ci_ptr->values + cursor->cv_idx;
+		const gcov_type *group = cursor->snapshot ? cursor->snapshot : values;
+		const struct gcov_kvp *node = cursor->kvp;
+
+		switch (cursor->kv_part) {
+		case 0:
+			pos += store_gcov_counter(buffer, pos, group[0]);
+			cursor->kv_left = gcov_choice(cursor, &cursor->choice_idx, GCOV_CHOICE_BITS_PAIRS,
+						      gcov_topn_pairs(group), 0, 0);
+			cursor->kvp = (const struct gcov_kvp *)(__INTPTR_TYPE__)group[2];
+			cursor->kv_part = 1;
+			break;
+		case 1:
+			pos += store_gcov_counter(buffer, pos, cursor->kv_left);
+			cursor->kv_part = 2;
+			break;
+		case 2:
+			if (cursor->kv_left) {
+				pos += store_gcov_counter(buffer, pos, node ? node->value : 0);
+				cursor->kv_part = 3;
+				break;
+			}
+			/* Group done */
+			if (cursor->snapshot) {
+				cursor->snapshot += GCOV_TOPN_MEM_COUNTERS;
+			} else if (cursor->reset) {
+				/* The pairs stay in the pool, as with libgcov */
+				memset(values, 0, GCOV_TOPN_MEM_COUNTERS * sizeof(gcov_type));
+			}
+			cursor->cv_idx += GCOV_TOPN_MEM_COUNTERS;
+			cursor->kv_part = 0;
+			break;
+		default:
+			pos += store_gcov_counter(buffer, pos, node ? node->count : 0);
+			cursor->kvp = node ? node->next : NULL;
+			cursor->kv_left--;
+			cursor->kv_part = 2;
+			break;
+		}
+	}
+
+	return pos;
+}
+#endif
+
+/**
+ * gcov_gcda_fill - convert the next part of a profiling data set to gcda format
+ * @cursor: encoder position, from gcov_gcda_start() or an earlier call
+ * @buffer: buffer to store file data
+ * @max_words: size of @buffer in words, at least GCOV_CURSOR_MIN_WORDS
+ *
+ * Converts as much as fits in @buffer and advances @cursor past it, so the
+ * data set can be emitted in pieces of any size, at any later time.
+ * If the cursor has fingerprints, each function's fingerprint is updated
+ * as it is emitted; with delta set as well, functions whose fingerprint
+ * has not changed (and empty function records) are left out.
+ * With reset set, each live counter is zeroed as soon as it is read.
+ * With hits set, each counter record holds a hit bitmap instead of
+ * the values, see gcov_format.h.
+ * Where the size depends on the values, it goes by the choices
+ * gcov_gcda_size() made, so the data set comes out at that size.
+ * Returns the number of words stored, 0 once the whole data set is done.
+ */
+/* Our own creation, but compare to libgcc/libgcov-driver.c function write_one_data() */
+size_t gcov_gcda_fill(struct gcov_cursor *cursor, gcov_unsigned_t *buffer, size_t max_words)
+{
+	struct gcov_info *gi_ptr = cursor->info;
+	const struct gcov_fn_info *fi_ptr;
+	const struct gcov_ctr_info *ci_ptr;
+	size_t pos = 0; /* offset in buffer, in buffer data type units */
+	size_t n;
+
+	while (cursor->state != GCOV_CURSOR_DONE) {
+		switch (cursor->state) {
+		case GCOV_CURSOR_HEADER:
+			if (max_words - pos < GCOV_HEADER_WORDS) {
+				return pos;
+			}
+
+			/* File header. */
+			pos += store_gcov_tag_length(buffer, pos, GCOV_DATA_MAGIC, gi_ptr->version);
+			pos += store_gcov_unsigned(buffer, pos, gi_ptr->stamp);
+#if GCOV_HEADER_CHECKSUM
+			pos += store_gcov_unsigned(buffer, pos, gi_ptr->checksum);
+#endif
+
+			cursor->fi_idx = 0;
+			cursor->state = GCOV_CURSOR_SUMMARY;
+			break;
+
+		case GCOV_CURSOR_SUMMARY:
+#if GCOV_SUMMARY_WORDS
+			if (max_words - pos < GCOV_SUMMARY_WORDS) {
+				return pos;
+			}
+
+			/* Object summary: one run, and the largest arc count. */
+			pos += store_gcov_tag_length(buffer, pos, GCOV_TAG_OBJECT_SUMMARY, GCOV_TAG_SUMMARY_LENGTH);
+			pos += store_gcov_unsigned(buffer, pos, 1);
+			pos += store_gcov_unsigned(buffer, pos, (gcov_unsigned_t)gcov_run_max(cursor));
+#endif
+
+			cursor->state = GCOV_CURSOR_FUNCTION;
+			break;
+
+		case GCOV_CURSOR_FUNCTION:
+			if (cursor->fi_idx >= gi_ptr->n_functions) {
+				cursor->state = GCOV_CURSOR_DONE;
+				break;
+			}
+			if (max_words - pos < 2 + GCOV_TAG_FUNCTION_WORDS) {
+				return pos;
+			}
+
+			fi_ptr = gi_ptr->functions[cursor->fi_idx];
+
+#ifdef GCOV_OPT_RESET_WATCHDOG
+			/* In an embedded system, you might want to reset any watchdog timer here, */
+			/* depending on your timeout versus gcov tree size */
+			SP_WDG = WATCHDOG_RESET;
+#endif // GCOV_OPT_RESET_WATCHDOG
+
+			if (!gcov_fn_selected(gi_ptr, fi_ptr)) {
+				/* Empty function record, counters are in another file. */
+				if (!cursor->delta) {
+					pos += store_gcov_tag_length(buffer, pos, GCOV_TAG_FUNCTION, 0);
+				}
+				cursor->fi_idx++;
+				break;
+			}
+
+			if (cursor->fingerprints) {
+				size_t count;
+				gcov_unsigned_t hash = gcov_fn_fingerprint(gi_ptr, fi_ptr,
+									   cursor->snapshot, &count);
+
+				if (cursor->delta &&
+				    !gcov_choice(cursor, &cursor->choice_idx, GCOV_CHOICE_BITS_SEND,
+						 hash != cursor->fingerprints[cursor->fi_idx], 1, 0)) {
+					/* Unchanged since the last dump, left out. */
+					if (cursor->snapshot) {
+						cursor->snapshot += count;
+					}
+					cursor->fi_idx++;
+					break;
+				}
+				cursor->fingerprints[cursor->fi_idx] = hash;
+			}
+
+			/* Function record. */
+			pos += store_gcov_tag_length(buffer, pos, GCOV_TAG_FUNCTION, GCOV_TAG_FUNCTION_LENGTH);
+
+			pos += store_gcov_unsigned(buffer, pos, fi_ptr->ident);
+			pos += store_gcov_unsigned(buffer, pos, fi_ptr->lineno_checksum);
+			pos += store_gcov_unsigned(buffer, pos, fi_ptr->cfg_checksum);
+
+			cursor->ci_ptr = fi_ptr->ctrs;
+			cursor->ct_idx = 0;
+			cursor->state = GCOV_CURSOR_COUNTER;
+			break;
+
+		case GCOV_CURSOR_COUNTER:
+			while (cursor->ct_idx < GCOV_COUNTERS && !gi_ptr->merge[cursor->ct_idx]) {
+				/* Unused counter */
+				cursor->ct_idx++;
+			}
+			if (cursor->ct_idx >= GCOV_COUNTERS) {
+				cursor->fi_idx++;
+				cursor->state = GCOV_CURSOR_FUNCTION;
+				break;
+			}
+			if (max_words - pos < 2) {
+				return pos;
+			}
+
+			ci_ptr = cursor->ci_ptr;
+
+#if GCOV_TOPN_LISTS
+			if (GCOV_COUNTER_IS_TOPN(cursor->ct_idx)) {
+				/* Top N counter record: never in the all-zero form,
+				 * nor as a hit bitmap. The pair counts are looked up
+				 * again as each group is written. */
+				unsigned int choice_idx = cursor->choice_idx;
+
+				pos += store_gcov_tag_length(buffer, pos,
+						      GCOV_TAG_FOR_COUNTER(cursor->ct_idx),
+						      GCOV_TAG_COUNTER_LENGTH(gcov_topn_counters(cursor,
+							&choice_idx,
+							cursor->snapshot ? cursor->snapshot : ci_ptr->values,
+							ci_ptr->num, 0)));
+				cursor->cv_idx = 0;
+				cursor->kv_part = 0;
+				cursor->state = GCOV_CURSOR_VALUES;
+				break;
+			}
+#endif
+
+#if GCOV_COMPACT_ZERO_COUNTERS
+			if (gcov_choice(cursor, &cursor->choice_idx, GCOV_CHOICE_BITS_ZERO,
+					gcov_values_zero(cursor->snapshot ? cursor->snapshot : ci_ptr->values,
+							 ci_ptr->num),
+					0, 0)) {
+				/* Counter record of all zeros: negated length, no values. */
+				pos += store_gcov_tag_length(buffer, pos,
+						      GCOV_TAG_FOR_COUNTER(cursor->ct_idx),
+						      -GCOV_TAG_COUNTER_LENGTH(ci_ptr->num));
+				if (cursor->snapshot) {
+					cursor->snapshot += ci_ptr->num;
+				}
+				cursor->ci_ptr++;
+				cursor->ct_idx++;
+				break;
+			}
+#endif
+
 			/* Counter record. */
 			pos += store_gcov_tag_length(buffer, pos,
-					      GCOV_TAG_FOR_COUNTER(ct_idx),
+					      GCOV_TAG_FOR_COUNTER(cursor->ct_idx),
 					      GCOV_TAG_COUNTER_LENGTH(ci_ptr->num));
 
+			cursor->cv_idx = 0;
+			cursor->state = GCOV_CURSOR_VALUES;
+			break;
+
+		case GCOV_CURSOR_VALUES:
+			ci_ptr = cursor->ci_ptr;
+#if GCOV_TOPN_LISTS
+			if (GCOV_COUNTER_IS_TOPN(cursor->ct_idx)) {
+				pos += gcov_fill_topn(cursor, buffer + pos, max_words - pos);
+				if (cursor->cv_idx < ci_ptr->num) {
+					return pos;
+				}
+				cursor->ci_ptr++;
+				cursor->ct_idx++;
+				cursor->state = GCOV_CURSOR_COUNTER;
+				break;
+			}
+#endif
+			if (cursor->hits) {
+				pos += gcov_fill_hits(cursor, buffer + pos, max_words - pos);
+				if (cursor->cv_idx < ci_ptr->num) {
+					return pos;
+				}
+				cursor->ci_ptr++;
+				cursor->ct_idx++;
+				cursor->state = GCOV_CURSOR_COUNTER;
+				break;
+			}
+			n = ci_ptr->num - cursor->cv_idx;
+			if (n > (max_words - pos) / 2) {
+				n = (max_words - pos) / 2;
+				if (n == 0) {
+					return pos;
+				}
+			}
+
+			cursor->cv_idx += n;
+			if (cursor->snapshot) {
+				/* Values copied earlier by gcov_snapshot_counters() */
+				while (n--) {
+					pos += store_gcov_counter(buffer, pos, *cursor->snapshot++);
+				}
+			} else if (cursor->reset) {
+				/* Zero each counter right after reading it, so only a count
+				 * made between the two can be lost, not one made anywhere
+				 * else while the dump goes on */
+				gcov_type *values = ci_ptr->values + cursor->cv_idx - n;
+
+				while (n--) {
+					gcov_type v = *values;
+
+					*values++ = 0;
+					pos += store_gcov_counter(buffer, pos, v);
+				}
+			} else {
+				const gcov_type *values = ci_ptr->values + cursor->cv_idx - n;
+
+				while (n--) {
+					pos += store_gcov_counter(buffer, pos, *values++);
+				}
+			}
+
+			if (cursor->cv_idx >= ci_ptr->num) {
+				cursor->ci_ptr++;
+				cursor->ct_idx++;
+				cursor->state = GCOV_CURSOR_COUNTER;
+			}
+			break;
+
+		default:
+			cursor->state = GCOV_CURSOR_DONE;
+			break;
+		}
+	}
+
+	return pos;
+}
+
+/**
+ * gcov_counters_count - count the counter values of a profiling data set
+ * @info: profiling data set to be measured
+ *
+ * Returns the number of values gcov_snapshot_counters() will copy.
+ */
+size_t gcov_counters_count(struct gcov_info *gi_ptr)
+{
+	const struct gcov_fn_info *fi_ptr;
+	const struct gcov_ctr_info *ci_ptr;
+	unsigned int fi_idx;
+	unsigned int ct_idx;
+	size_t count = 0;
+
+	for (fi_idx = 0; fi_idx < gi_ptr->n_functions; fi_idx++) {
+		fi_ptr = gi_ptr->functions[fi_idx];
+		if (!gcov_fn_selected(gi_ptr, fi_ptr)) {
+			continue;
+		}
+		ci_ptr = fi_ptr->ctrs;
+
+		for (ct_idx = 0; ct_idx < GCOV_COUNTERS; ct_idx++) {
+			if (!gi_ptr->merge[ct_idx]) {
+				/* Unused counter */
+				continue;
+			}
+			count += ci_ptr->num;
+			ci_ptr++;
+		}
+	}
+
+	return count;
+}
+
+/**
+ * gcov_snapshot_counters - copy the counter values of a profiling data set
+ * @info: profiling data set to be copied
+ * @dest: where to copy to, room for gcov_counters_count() values
+ *
+ * Copies each counter array as one block, in the order the encoder
+ * emits them, so a cursor with its snapshot pointer set to @dest
+ * encodes the copy instead of the live counters.
+ * Returns the number of values copied.
+ */
+size_t gcov_snapshot_counters(struct gcov_info *gi_ptr, gcov_type *dest)
+{
+	const struct gcov_fn_info *fi_ptr;
+	const struct gcov_ctr_info *ci_ptr;
+	unsigned int fi_idx;
+	unsigned int ct_idx;
+	size_t count = 0;
+
+	for (fi_idx = 0; fi_idx < gi_ptr->n_functions; fi_idx++) {
+		fi_ptr = gi_ptr->functions[fi_idx];
+		if (!gcov_fn_selected(gi_ptr, fi_ptr)) {
+			continue;
+		}
+		ci_ptr = fi_ptr->ctrs;
+
+		for (ct_idx = 0; ct_idx < GCOV_COUNTERS; ct_idx++) {
+			if (!gi_ptr->merge[ct_idx]) {
+				/* Unused counter */
+				continue;
+			}
+			memcpy(dest + count, ci_ptr->values, ci_ptr->num * sizeof(gcov_type));
+			count += ci_ptr->num;
+			ci_ptr++;
+		}
+	}
+
+	return count;
+}
+
+/**
+ * gcov_counters_touched - test whether any counter of a profiling data set is set
+ * @info: profiling data set to be tested
+ *
+ * Each counter array is or'ed together before testing, so there
+ * is one branch per array rather than one per value.
+ * Returns 1 if any counter is nonzero, so code of the file ran.
+ */
+int gcov_counters_touched(struct gcov_info *gi_ptr)
+{
+	const struct gcov_fn_info *fi_ptr;
+	const struct gcov_ctr_info *ci_ptr;
+	unsigned int fi_idx;
+	unsigned int ct_idx;
+	unsigned int cv_idx;
+
+	for (fi_idx = 0; fi_idx < gi_ptr->n_functions; fi_idx++) {
+		fi_ptr = gi_ptr->functions[fi_idx];
+		if (!gcov_fn_selected(gi_ptr, fi_ptr)) {
+			continue;
+		}
+		ci_ptr = fi_ptr->ctrs;
+
+		for (ct_idx = 0; ct_idx < GCOV_COUNTERS; ct_idx++) {
+			gcov_type any = 0;
+
+			if (!gi_ptr->merge[ct_idx]) {
+				/* Unused counter */
+				continue;
+			}
 			for (cv_idx = 0; cv_idx < ci_ptr->num; cv_idx++) {
-				pos += store_gcov_counter(buffer, pos,
-						      ci_ptr->values[cv_idx]);
+				any |= ci_ptr->values[cv_idx];
+			}
+			if (any) {
+				return 1;
 			}
 			ci_ptr++;
 		}
 	}
 
-	/* return count of bytes (convert from count of buffer data type units) */
-	return pos * sizeof(*buffer);
+	return 0;
+}
+
+/**
+ * gcov_functions_count - number of functions listed in a profiling data set
+ * @info: profiling data set
+ *
+ * Includes functions whose counters are in another data set,
+ * for which gcov_fn_arcs() finds no counters.
+ */
+size_t gcov_functions_count(struct gcov_info *gi_ptr)
+{
+	return gi_ptr->n_functions;
+}
+
+/**
+ * gcov_fn_arcs - count the arc counters of a function, and those set
+ * @info: profiling data set
+ * @fn: index of the function, below gcov_functions_count()
+ * @ident: where to store the function's ident
+ * @hit: where to store the number of nonzero arc counters
+ *
+ * Four values are or'ed together and tested at once, so counters
+ * that were never hit cost one branch per four.
+ * Returns the number of arc counters, 0 (with @ident and @hit
+ * left alone) for a function whose counters are in another
+ * data set, or a file built without arc counters.
+ */
+unsigned int gcov_fn_arcs(struct gcov_info *gi_ptr, size_t fn, gcov_unsigned_t *ident, unsigned int *hit)
+{
+	const struct gcov_fn_info *fi_ptr = gi_ptr->functions[fn];
+	const gcov_type *values;
+	unsigned int num;
+	unsigned int count = 0;
+	unsigned int cv_idx;
+
+	if (!gcov_fn_selected(gi_ptr, fi_ptr) || !gi_ptr->merge[GCOV_COUNTER_ARCS]) {
+		return 0;
+	}
+	/* Arc counters are always the first array there is */
+	values = fi_ptr->ctrs[0].values;
+	num = fi_ptr->ctrs[0].num;
+
+	for (cv_idx = 0; cv_idx + 4 <= num; cv_idx += 4) {
+		if (values[cv_idx] | values[cv_idx + 1] | values[cv_idx + 2] | values[cv_idx + 3]) {
+			count += (values[cv_idx] != 0) + (values[cv_idx + 1] != 0) +
+				 (values[cv_idx + 2] != 0) + (values[cv_idx + 3] != 0);
+		}
+	}
+	for (; cv_idx < num; cv_idx++) {
+		count += (values[cv_idx] != 0);
+	}
+
+	*ident = fi_ptr->ident;
+	*hit = count;
+	return num;
+}
+
+/**
+ * gcov_info_stamp - return the time stamp of a profiling data set
+ * @info: profiling data set
+ */
+gcov_unsigned_t gcov_info_stamp(struct gcov_info *gi_ptr)
+{
+	return gi_ptr->stamp;
+}
+
+/**
+ * gcov_info_signature - hash what makes saved counters fit a data set
+ * @info: profiling data set
+ *
+ * Covers the gcov version, time stamp, object checksum, filename,
+ * and each function's ident, checksums and number of counters,
+ * so counters saved from another build of the file do not match.
+ */
+gcov_unsigned_t gcov_info_signature(struct gcov_info *gi_ptr)
+{
+	const struct gcov_fn_info *fi_ptr;
+	const struct gcov_ctr_info *ci_ptr;
+	const char *name;
+	gcov_unsigned_t hash = 2166136261UL;
+	unsigned int fi_idx;
+	unsigned int ct_idx;
+
+	hash = gcov_hash_word(hash, gi_ptr->version);
+	hash = gcov_hash_word(hash, gi_ptr->stamp);
+#if GCOV_HEADER_CHECKSUM
+	hash = gcov_hash_word(hash, gi_ptr->checksum);
+#endif
+	for (name = gi_ptr->filename; *name; name++) {
+		hash = gcov_hash_word(hash, (unsigned char)*name);
+	}
+
+	for (fi_idx = 0; fi_idx < gi_ptr->n_functions; fi_idx++) {
+		fi_ptr = gi_ptr->functions[fi_idx];
+		if (!gcov_fn_selected(gi_ptr, fi_ptr)) {
+			continue;
+		}
+		hash = gcov_hash_word(hash, fi_ptr->ident);
+		hash = gcov_hash_word(hash, fi_ptr->lineno_checksum);
+		hash = gcov_hash_word(hash, fi_ptr->cfg_checksum);
+
+		ci_ptr = fi_ptr->ctrs;
+		for (ct_idx = 0; ct_idx < GCOV_COUNTERS; ct_idx++) {
+			if (!gi_ptr->merge[ct_idx]) {
+				/* Unused counter */
+				continue;
+			}
+			hash = gcov_hash_word(hash, ct_idx);
+			hash = gcov_hash_word(hash, ci_ptr->num);
+			ci_ptr++;
+		}
+	}
+
+	return hash;
+}
+
+/**
+ * gcov_merge_counters - add saved counter values into a profiling data set
+ * @info: profiling data set
+ *
+ * Calls the merge function gcc gave for each counter array
+ * (__gcov_merge_add for the arc counters), in the order
+ * gcov_snapshot_counters() copies them, as libgcov does when it
+ * merges a .gcda file. The merge functions read the saved values.
+ * Returns the number of values merged.
+ */
+size_t gcov_merge_counters(struct gcov_info *gi_ptr)
+{
+	const struct gcov_fn_info *fi_ptr;
+	const struct gcov_ctr_info *ci_ptr;
+	unsigned int fi_idx;
+	unsigned int ct_idx;
+	size_t count = 0;
+
+	for (fi_idx = 0; fi_idx < gi_ptr->n_functions; fi_idx++) {
+		fi_ptr = gi_ptr->functions[fi_idx];
+		if (!gcov_fn_selected(gi_ptr, fi_ptr)) {
+			continue;
+		}
+		ci_ptr = fi_ptr->ctrs;
+
+		for (ct_idx = 0; ct_idx < GCOV_COUNTERS; ct_idx++) {
+			if (!gi_ptr->merge[ct_idx]) {
+				/* Unused counter */
+				continue;
+			}
+			gi_ptr->merge[ct_idx](ci_ptr->values, ci_ptr->num);
+			count += ci_ptr->num;
+			ci_ptr++;
+		}
+	}
+
+	return count;
 }
 
 /**
  * gcov_clear_counters - set profiling counters to zero
  * @info: profiling data set to be cleared
  *
+ * Each counter array is zeroed as one block.
  */
 /* Our own creation, but compare to libgcc/libgcov-driver.c function write_one_data() */
 void gcov_clear_counters(struct gcov_info *gi_ptr)
@@ -284,12 +1279,16 @@ void gcov_clear_counters(struct gcov_info *gi_ptr)
 	const struct gcov_ctr_info *ci_ptr;
 	unsigned int fi_idx;
 	unsigned int ct_idx;
-	unsigned int cv_idx;
 
 	/* Clear execution counts for each function.  */
 	for (fi_idx = 0; fi_idx < gi_ptr->n_functions; fi_idx++) {
 		fi_ptr = gi_ptr->functions[fi_idx];
 
+		if (!gcov_fn_selected(gi_ptr, fi_ptr)) {
+			/* Counters belong to the selected copy in another file */
+			continue;
+		}
+
 		ci_ptr = fi_ptr->ctrs;
 
 		for (ct_idx = 0; ct_idx < GCOV_COUNTERS; ct_idx++) {
@@ -298,10 +1297,7 @@ void gcov_clear_counters(struct gcov_info *gi_ptr)
 				continue;
 			}
 
-			/* Counter record. */
-			for (cv_idx = 0; cv_idx < ci_ptr->num; cv_idx++) {
-			      ci_ptr->values[cv_idx] = 0;
-			}
+			memset(ci_ptr->values, 0, ci_ptr->num * sizeof(gcov_type));
 			ci_ptr++;
 		}
 	}
@@ -309,6 +1305,263 @@ void gcov_clear_counters(struct gcov_info *gi_ptr)
 	return;
 }
 
+#ifdef GCOV_OPT_PROFILE_VALUES
+#if !GCOV_TOPN_LISTS
+#error "GCOV_OPT_PROFILE_VALUES needs gcc 11 or later"
+#endif
+
+/*
+ * Value profilers, called by code compiled with -fprofile-generate,
+ * in place of those of libgcov (whose top N profiler would pull in
+ * the rest of libgcov). Each has an _atomic twin, called instead
+ * with -fprofile-update=atomic.
+ */
+
+/* Where the instrumented code keeps the order of first calls */
+/* Compare to libgcc/libgcov-profiler.c */
+gcov_type __gcov_time_profiler_counter;
+
+/* Callee and counters of the indirect call being made, set by the caller */
+/* Compare to libgcc/libgcov.h */
+struct indirect_call_tuple {
+	void *callee;
+	gcov_type *counters;
+};
+GCOV_INDIRECT_CALL_TLS struct indirect_call_tuple __gcov_indirect_call;
+
+/* (value, count) pairs of all the top N profiles, never given back */
+static struct gcov_kvp gcov_kvpPool[GCOV_TOPN_NODES];
+static unsigned int gcov_kvpUsed;
+
+/**
+ * gcov_counter_add - add to a counter
+ * @counter: counter to be added to
+ * @value: amount to add
+ * @use_atomic: add atomically
+ */
+/* Compare to libgcc/libgcov.h function gcov_counter_add() */
+static void gcov_counter_add(gcov_type *counter, gcov_type value, int use_atomic)
+{
+	if (use_atomic) {
+		__atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+	} else {
+		*counter += value;
+	}
+}
+
+/**
+ * gcov_kvp_allocate - take a pair from the pool
+ * @use_atomic: take it atomically
+ *
+ * Returns the pair, or NULL once all GCOV_TOPN_NODES are taken,
+ * and then new values are not tracked.
+ */
+/* Compare to libgcc/libgcov.h function allocate_gcov_kvp() */
+static struct gcov_kvp *gcov_kvp_allocate(int use_atomic)
+{
+	unsigned int index;
+
+	if (use_atomic) {
+		index = __atomic_fetch_add(&gcov_kvpUsed, 1, __ATOMIC_RELAXED);
+	} else {
+		index = gcov_kvpUsed++;
+	}
+	if (index >= GCOV_TOPN_NODES) {
+		/* Keep the count from wrapping round to pairs in use */
+		if (use_atomic) {
+			__atomic_store_n(&gcov_kvpUsed, GCOV_TOPN_NODES, __ATOMIC_RELAXED);
+		} else {
+			gcov_kvpUsed = GCOV_TOPN_NODES;
+		}
+		return NULL;
+	}
+
+	return &gcov_kvpPool[index];
+}
+
+/**
+ * gcov_topn_add_value - count a value in a top N group
+ * @counters: the group: total, number of pairs, list
+ * @value: value seen
+ * @count: times seen
+ * @use_atomic: update atomically
+ * @increment_total: count it in the total as well
+ *
+ * Pairs are added at the end of the list, up to
+ * GCOV_TOPN_MAXIMUM_TRACKED_VALUES; after that, the least
+ * counted pair gives way to a value seen often enough.
+ */
+/* Compare to libgcc/libgcov.h function gcov_topn_add_value() */
+static void gcov_topn_add_value(gcov_type *counters, gcov_type value, gcov_type count,
+				int use_atomic, int increment_total)
+{
+	struct gcov_kvp *prev_node = NULL;
+	struct gcov_kvp *minimal_node = NULL;
+	struct gcov_kvp *current_node = (struct gcov_kvp *)(__INTPTR_TYPE__)counters[2];
+	struct gcov_kvp *new_node;
+	int success = 0;
+
+	if (increment_total) {
+		/* A negative total marks a profile no longer to be trusted */
+		if (counters[0] < 0) {
+			return;
+		}
+		gcov_counter_add(&counters[0], 1, use_atomic);
+	}
+
+	while (current_node) {
+		if (current_node->value == value) {
+			gcov_counter_add(&current_node->count, count, use_atomic);
+			return;
+		}
+		if (!minimal_node || current_node->count < minimal_node->count) {
+			minimal_node = current_node;
+		}
+		prev_node = current_node;
+		current_node = current_node->next;
+	}
+
+	if (counters[1] == GCOV_TOPN_MAXIMUM_TRACKED_VALUES) {
+		if (--minimal_node->count < count) {
+			minimal_node->value = value;
+			minimal_node->count = count;
+		}
+		return;
+	}
+
+	new_node = gcov_kvp_allocate(use_atomic);
+	if (!new_node) {
+		return;
+	}
+	new_node->value = value;
+	new_node->count = count;
+	new_node->next = NULL;
+
+	if (!counters[2]) {
+		if (use_atomic) {
+			gcov_type expected = 0;
+
+			success = __atomic_compare_exchange_n(&counters[2], &expected,
+							      (gcov_type)(__INTPTR_TYPE__)new_node, 0,
+							      __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+		} else {
+			counters[2] = (gcov_type)(__INTPTR_TYPE__)new_node;
+			success = 1;
+		}
+	} else if (prev_node && !prev_node->next) {
+		if (use_atomic) {
+			struct gcov_kvp *expected = NULL;
+
+			success = __atomic_compare_exchange_n(&prev_node->next, &expected, new_node, 0,
+							      __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+		} else {
+			prev_node->next = new_node;
+			success = 1;
+		}
+	}
+
+	/* Count the pair only once it can be reached from the list */
+	if (success) {
+		gcov_counter_add(&counters[1], 1, use_atomic);
+	}
+}
+
+/* Compare to libgcc/libgcov-profiler.c function __gcov_interval_profiler() */
+static void gcov_interval_profile(gcov_type *counters, gcov_type value, int start,
+				  unsigned int steps, int use_atomic)
+{
+	gcov_type delta = value - start;
+
+	if (delta < 0) {
+		gcov_counter_add(&counters[steps + 1], 1, use_atomic);
+	} else if (delta >= steps) {
+		gcov_counter_add(&counters[steps], 1, use_atomic);
+	} else {
+		gcov_counter_add(&counters[delta], 1, use_atomic);
+	}
+}
+
+void __gcov_interval_profiler(gcov_type *counters, gcov_type value, int start, unsigned int steps)
+{
+	gcov_interval_profile(counters, value, start, steps, 0);
+}
+
+void __gcov_interval_profiler_atomic(gcov_type *counters, gcov_type value, int start, unsigned int steps)
+{
+	gcov_interval_profile(counters, value, start, steps, 1);
+}
+
+/* Compare to libgcc/libgcov-profiler.c function __gcov_pow2_profiler() */
+void __gcov_pow2_profiler(gcov_type *counters, gcov_type value)
+{
+	gcov_counter_add(&counters[value == 0 || (value & (value - 1)) ? 0 : 1], 1, 0);
+}
+
+void __gcov_pow2_profiler_atomic(gcov_type *counters, gcov_type value)
+{
+	gcov_counter_add(&counters[value == 0 || (value & (value - 1)) ? 0 : 1], 1, 1);
+}
+
+/* Compare to libgcc/libgcov-profiler.c function __gcov_topn_values_profiler() */
+void __gcov_topn_values_profiler(gcov_type *counters, gcov_type value)
+{
+	gcov_topn_add_value(counters, value, 1, 0, 1);
+}
+
+void __gcov_topn_values_profiler_atomic(gcov_type *counters, gcov_type value)
+{
+	gcov_topn_add_value(counters, value, 1, 1, 1);
+}
+
+/*
+ * The caller set __gcov_indirect_call just before the call, so the
+ * callee counts itself (value is its profile id) in the caller's
+ * indirect call profile, unless something else was called first.
+ */
+/* Compare to libgcc/libgcov-profiler.c function __gcov_indirect_call_profiler_v4() */
+static void gcov_indirect_call_profile(gcov_type value, void *cur_func, int use_atomic)
+{
+	if (cur_func == __gcov_indirect_call.callee) {
+		gcov_topn_add_value(__gcov_indirect_call.counters, value, 1, use_atomic, 1);
+	}
+	__gcov_indirect_call.callee = NULL;
+}
+
+void __gcov_indirect_call_profiler_v4(gcov_type value, void *cur_func)
+{
+	gcov_indirect_call_profile(value, cur_func, 0);
+}
+
+void __gcov_indirect_call_profiler_v4_atomic(gcov_type value, void *cur_func)
+{
+	gcov_indirect_call_profile(value, cur_func, 1);
+}
+
+/* Compare to libgcc/libgcov-profiler.c function __gcov_average_profiler() */
+void __gcov_average_profiler(gcov_type *counters, gcov_type value)
+{
+	gcov_counter_add(&counters[0], value, 0);
+	gcov_counter_add(&counters[1], 1, 0);
+}
+
+void __gcov_average_profiler_atomic(gcov_type *counters, gcov_type value)
+{
+	gcov_counter_add(&counters[0], value, 1);
+	gcov_counter_add(&counters[1], 1, 1);
+}
+
+/* Compare to libgcc/libgcov-profiler.c function __gcov_ior_profiler() */
+void __gcov_ior_profiler(gcov_type *counters, gcov_type value)
+{
+	*counters |= value;
+}
+
+void __gcov_ior_profiler_atomic(gcov_type *counters, gcov_type value)
+{
+	__atomic_fetch_or(counters, value, __ATOMIC_RELAXED);
+}
+#endif // GCOV_OPT_PROFILE_VALUES
+
 /** @}
  */
 /*
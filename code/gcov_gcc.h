@@ -60,8 +60,11 @@
 
 /* Compare to gcc/gcov-counter.def and gcc/gcov-io.h */
 /* GCC has changed this back and forth over time, do not know exact GCC versions */
-/* This has been used with GCC 7.5.0 and GCC 11.1.0 */
-#if (__GNUC__ >= 10)
+/* This has been used with GCC 7.5.0, GCC 11.1.0 and GCC 12.2.0 */
+/* (GCC 14 added the condition coverage counter) */
+#if (__GNUC__ >= 14)
+#define GCOV_COUNTERS			9
+#elif (__GNUC__ >= 10)
 #define GCOV_COUNTERS			8
 #elif (__GNUC__ >= 5) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
 #define GCOV_COUNTERS			9
@@ -69,6 +72,29 @@
 #define GCOV_COUNTERS			8
 #endif
 
+/* Arc counters come first, in every gcc version */
+#define GCOV_COUNTER_ARCS		0
+
+/*
+ * From gcc 11 on, the top N value and indirect call profiles keep,
+ * for each profiled place, a total, a number of pairs, and a list
+ * of (value, count) pairs. The file gets the total, the number of
+ * pairs, then the pairs, so these counter records have their own size.
+ * Compare to gcc/gcov-counter.def and gcc/gcov-io.h
+ */
+#if (__GNUC__ >= 11)
+#define GCOV_TOPN_LISTS			1
+#define GCOV_COUNTER_V_TOPN		3
+#define GCOV_COUNTER_V_INDIR		4
+#define GCOV_TOPN_MEM_COUNTERS		3
+#define GCOV_TOPN_DISK_COUNTERS		2
+#define GCOV_TOPN_MAXIMUM_TRACKED_VALUES	32
+#define GCOV_COUNTER_IS_TOPN(ct) ((ct) == GCOV_COUNTER_V_TOPN || (ct) == GCOV_COUNTER_V_INDIR)
+#else
+#define GCOV_TOPN_LISTS			0
+#define GCOV_COUNTER_IS_TOPN(ct) 0
+#endif
+
 /* Compare to gcc/gcov-io.h */
 
 /*
@@ -81,19 +107,133 @@
  */
 #define GCOV_DATA_MAGIC		((gcov_unsigned_t) 0x67636461)
 #define GCOV_TAG_FUNCTION	((gcov_unsigned_t) 0x01000000)
-#define GCOV_TAG_FUNCTION_LENGTH	(3)
 #define GCOV_TAG_COUNTER_BASE	((gcov_unsigned_t) 0x01a10000)
-#define GCOV_TAG_COUNTER_LENGTH(NUM) ((NUM) * 2)
 #define GCOV_TAG_FOR_COUNTER(count) (GCOV_TAG_COUNTER_BASE + ((gcov_unsigned_t) (count) << 17))
+#define GCOV_TAG_OBJECT_SUMMARY	((gcov_unsigned_t) 0xa1000000)
+
+/* Sizes of the records, in words */
+#define GCOV_TAG_FUNCTION_WORDS	(3)
+#define GCOV_TAG_COUNTER_WORDS(NUM) ((NUM) * 2)
+
+/*
+ * GCC 12 changed the gcda format:
+ * record lengths are in bytes instead of words,
+ * the file header has a checksum word after the stamp,
+ * and a counter array of all zeros may be written as its
+ * negated length with no values.
+ */
+#if (__GNUC__ >= 12)
+#define GCOV_LENGTH_UNIT	(4)	/* bytes per word */
+#define GCOV_HEADER_CHECKSUM	1
+#define GCOV_COMPACT_ZERO_COUNTERS	1
+#else
+#define GCOV_LENGTH_UNIT	(1)
+#define GCOV_HEADER_CHECKSUM	0
+#define GCOV_COMPACT_ZERO_COUNTERS	0
+#endif
+
+/* File header: magic, version, stamp (and checksum) */
+#define GCOV_HEADER_WORDS	(3 + GCOV_HEADER_CHECKSUM)
+
+/*
+ * From gcc 9 on, the object summary after the file header holds
+ * the number of runs and the largest arc count. It is only written
+ * for -fprofile-use, with GCOV_OPT_PROFILE_VALUES; gcov does not need
+ * it. Older summaries (with histograms) are not written.
+ */
+#if (__GNUC__ >= 9) && defined(GCOV_OPT_PROFILE_VALUES)
+#define GCOV_TAG_SUMMARY_WORDS	(2)
+#define GCOV_SUMMARY_WORDS	(2 + GCOV_TAG_SUMMARY_WORDS)
+#else
+#define GCOV_SUMMARY_WORDS	(0)
+#endif
+
+/* Record lengths, as written in the file */
+#define GCOV_TAG_FUNCTION_LENGTH	(GCOV_TAG_FUNCTION_WORDS * GCOV_LENGTH_UNIT)
+#define GCOV_TAG_COUNTER_LENGTH(NUM) (GCOV_TAG_COUNTER_WORDS(NUM) * GCOV_LENGTH_UNIT)
+#define GCOV_TAG_SUMMARY_LENGTH	(GCOV_TAG_SUMMARY_WORDS * GCOV_LENGTH_UNIT)
 
 /* Interface to access gcov_info data  */
 /* Our own creation */
 const char *gcov_info_filename(struct gcov_info *info);
+struct gcov_info *gcov_info_next(struct gcov_info *info);
+void gcov_info_set_next(struct gcov_info *info, struct gcov_info *next);
 
-/* Convert internal gcov data tree into .gcds output format */
+/* Position of the encoder within one gcov data tree, so the
+ * conversion can be done in pieces, see gcov_gcda_fill() */
+/* Our own creation */
+struct gcov_ctr_info;
+struct gcov_cursor {
+	struct gcov_info *info;
+	unsigned int state;
+	unsigned int fi_idx;	/* function index */
+	unsigned int ct_idx;	/* counter type index */
+	unsigned int cv_idx;	/* counter value index */
+	const struct gcov_ctr_info *ci_ptr;
+	const gcov_type *snapshot;	/* next copied value, or NULL to use live counters */
+	gcov_unsigned_t *fingerprints;	/* per function, from the last dump, or NULL */
+	unsigned int delta;	/* leave out functions whose fingerprint is unchanged */
+	unsigned int reset;	/* zero each live counter once read */
+	unsigned int hits;	/* hit bitmaps instead of counter values */
+	unsigned int kv_part;	/* top N group: total, number of pairs, value or count next */
+	unsigned int kv_left;	/* top N group: pairs still to store */
+	const void *kvp;	/* top N group: next pair */
+	gcov_unsigned_t *choices;	/* room to remember choices made on live counters, or NULL */
+	unsigned int choices_bits;	/* room in choices, in bits */
+	unsigned int choices_made;	/* bits remembered by gcov_gcda_size() */
+	unsigned int choice_idx;	/* next choice for gcov_gcda_fill(), in bits */
+	unsigned int sized;	/* gcov_gcda_size() has made the choices */
+};
+
+/* Smallest buffer, in words, that gcov_gcda_fill() can always make progress with */
+#define GCOV_CURSOR_MIN_WORDS	(2 + GCOV_TAG_FUNCTION_WORDS)
+
+/* Convert internal gcov data tree into .gcda output format, in pieces */
 /* Our own creation (though based on gcc internals, see source code) */
-/* Need buffer to be 32-bit-aligned for type-safe internal usage */
-size_t gcov_convert_to_gcda(gcov_unsigned_t *buffer, struct gcov_info *info);
+void gcov_gcda_start(struct gcov_cursor *cursor, struct gcov_info *info);
+size_t gcov_gcda_size(struct gcov_cursor *cursor);
+size_t gcov_gcda_fill(struct gcov_cursor *cursor, gcov_unsigned_t *buffer, size_t max_words);
+
+/* Number of fingerprints a delta dump keeps for the data tree */
+/* Our own creation */
+size_t gcov_fingerprints_count(struct gcov_info *info);
+
+/* Copy the counters of internal gcov data tree, to convert later */
+/* Our own creation (though based on gcc internals, see source code) */
+size_t gcov_counters_count(struct gcov_info *info);
+size_t gcov_snapshot_counters(struct gcov_info *info, gcov_type *dest);
+
+/* Tell whether any counter of internal gcov data tree is set */
+/* Our own creation */
+int gcov_counters_touched(struct gcov_info *info);
+
+/* Count the arc counters of each function of internal gcov data tree, and those set */
+/* Our own creation */
+size_t gcov_functions_count(struct gcov_info *info);
+unsigned int gcov_fn_arcs(struct gcov_info *info, size_t fn, gcov_unsigned_t *ident, unsigned int *hit);
+
+/* Identify internal gcov data tree, and add saved counters into it */
+/* Our own creation (though based on gcc internals, see source code) */
+gcov_unsigned_t gcov_info_stamp(struct gcov_info *info);
+gcov_unsigned_t gcov_info_signature(struct gcov_info *info);
+size_t gcov_merge_counters(struct gcov_info *info);
+
+#ifdef GCOV_OPT_PROFILE_VALUES
+/* Value profilers, called by code compiled with -fprofile-generate */
+/* Compare to libgcc/libgcov-profiler.c */
+void __gcov_interval_profiler(gcov_type *counters, gcov_type value, int start, unsigned int steps);
+void __gcov_interval_profiler_atomic(gcov_type *counters, gcov_type value, int start, unsigned int steps);
+void __gcov_pow2_profiler(gcov_type *counters, gcov_type value);
+void __gcov_pow2_profiler_atomic(gcov_type *counters, gcov_type value);
+void __gcov_topn_values_profiler(gcov_type *counters, gcov_type value);
+void __gcov_topn_values_profiler_atomic(gcov_type *counters, gcov_type value);
+void __gcov_indirect_call_profiler_v4(gcov_type value, void *cur_func);
+void __gcov_indirect_call_profiler_v4_atomic(gcov_type value, void *cur_func);
+void __gcov_average_profiler(gcov_type *counters, gcov_type value);
+void __gcov_average_profiler_atomic(gcov_type *counters, gcov_type value);
+void __gcov_ior_profiler(gcov_type *counters, gcov_type value);
+void __gcov_ior_profiler_atomic(gcov_type *counters, gcov_type value);
+#endif // GCOV_OPT_PROFILE_VALUES
 
 /* Convert internal gcov data tree into .gcds output format */
 /* Our own creation (though based on gcc internals, see source code) */
@@ -37,7 +37,7 @@
  * @return -1 if error, otherwise returns byte count written to UART
  */
 #include <stdio.h>
-#define write_bytes(fd, buf, n) putchar((int)(*(buf)))
+#define write_bytes(fd, buf, n) fwrite((buf), 1, (n), stdout)
 
 /***********************************************************************
  * The following functions support gcov_printf and are not meant to be
@@ -256,6 +256,20 @@ void gcov_printf(const char *fmt, ...)
 	va_end(va);
 }
 
+
+
+/**********************************************************************/
+/** @brief Print a block of characters with a single write_bytes() call
+ *
+ * @param [in]     *buf characters to print, need not be null terminated
+ * @param [in]     len number of characters
+ *
+ **********************************************************************/
+void gcov_print_bytes(const char *buf, unsigned int len)
+{
+	write_bytes(1,buf,len);
+}
+
 #endif // GCOV_OPT_PROVIDE_PRINTF_IMITATION
 
 
@@ -56,14 +56,35 @@
  */
 
 #include "gcov_gcc.h"
+#include "gcov_format.h"
 
 typedef unsigned int u32;
+typedef unsigned short u16;
+
+/* Each file's data starts with a transfer header, see gcov_format.h */
+#if defined(GCOV_OPT_TRANSFER_PACKED) || defined(GCOV_OPT_DELTA_DUMP) || \
+    defined(GCOV_OPT_TRANSFER_LZ) || defined(GCOV_OPT_TEST_CAPTURE) || \
+    defined(GCOV_OPT_TRANSFER_HITS)
+#define GCOV_TRANSFER_HEADER
+#endif
 
 #if defined(GCOV_OPT_USE_MALLOC) || defined(GCOV_OPT_USE_STDLIB)
 #include <stdlib.h>
 #endif
 
-#if defined(GCOV_OPT_PRINT_STATUS) || defined(GCOV_OPT_OUTPUT_SERIAL_HEXDUMP)
+#ifdef GCOV_OPT_PERSIST_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef GCOV_OPT_BACKGROUND_PTHREAD
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(GCOV_OPT_PRINT_STATUS) || defined(GCOV_OPT_OUTPUT_SERIAL_HEXDUMP) || \
+    defined(GCOV_OPT_PROVIDE_SUMMARY)
 /* Include any header files needed for serial port I/O */
 /* Not always stdio.h for highly embedded systems */
 #include <stdio.h>
@@ -78,23 +99,50 @@ static unsigned char *gcov_output_buffer = (unsigned char *)(0x42000000);
 static gcov_unsigned_t gcov_output_index;
 #endif // GCOV_OPT_OUTPUT_BINARY_MEMORY
 
-typedef struct tagGcovInfo {
-    struct gcov_info *info;
-    struct tagGcovInfo *next;
-} GcovInfo;
-static GcovInfo *gcov_headGcov = NULL;
+#if defined(GCOV_OPT_PERSIST) && !defined(GCOV_OPT_PERSIST_MMAP)
+/* You need to set the persistent region pointer to your
+ * battery-backed RAM or NVRAM block, of GCOV_PERSIST_SIZE bytes,
+ * 8-byte aligned, and left alone by your startup code. */
+static unsigned char *gcov_persistRegion = (unsigned char *)(0x43000000);
+#endif // GCOV_OPT_PERSIST and not GCOV_OPT_PERSIST_MMAP
 
-#ifndef GCOV_OPT_USE_MALLOC
-/* Declare space. Need one entry per file compiled for coverage. */
-static GcovInfo gcov_GcovInfo[100];
-static gcov_unsigned_t gcov_GcovIndex = 0;
+/* Registered files, linked through the next field of gcov_info itself,
+ * so registration needs no RAM of its own and has no file limit */
+static struct gcov_info *gcov_headGcov = NULL;
 
-/* Declare space. Needs to be enough for the largest single file coverage data. */
-/* Size used will depend on size and complexity of source code
- * that you have compiled for coverage. */
-/* Need buffer to be 32-bit-aligned for type-safe internal usage */
-gcov_unsigned_t gcov_buf[8192];
-#endif // not GCOV_OPT_USE_MALLOC
+#ifdef GCOV_OPT_ATOMIC_REGISTRATION
+/* Read the list head, seeing complete entries pushed by other cores */
+#define GCOV_LIST_HEAD() __atomic_load_n(&gcov_headGcov, __ATOMIC_ACQUIRE)
+#else
+#define GCOV_LIST_HEAD() (gcov_headGcov)
+#endif // GCOV_OPT_ATOMIC_REGISTRATION else
+
+/* Walking the files: a GcovList is a position in the files,
+ * GCOV_LIST_INFO gives the file there, NULL past the last one */
+#ifdef GCOV_OPT_INFO_SECTION
+/* Pointers gcc placed in the gcov info section, read in place */
+typedef const struct gcov_info *const *GcovList;
+#define GCOV_LIST_FIRST() (__gcov_info_start)
+#define GCOV_LIST_INFO(pos) \
+    ((pos) < __gcov_info_end ? (struct gcov_info *)*(pos) : NULL)
+#define GCOV_LIST_NEXT(pos) ((pos) + 1)
+#else
+/* Files registered by __gcov_init */
+typedef struct gcov_info *GcovList;
+#define GCOV_LIST_FIRST() GCOV_LIST_HEAD()
+#define GCOV_LIST_INFO(pos) (pos)
+#define GCOV_LIST_NEXT(pos) gcov_info_next(pos)
+#endif // GCOV_OPT_INFO_SECTION else
+
+/* Sinks registered at runtime by your code, see __gcov_register_sink */
+static const gcov_sink *gcov_userSinks[GCOV_MAX_SINKS];
+
+/* Sinks taking part in the dump in progress */
+/* (the user sinks plus up to 4 built-in ones) */
+typedef struct tagGcovEmit {
+    const gcov_sink *sinks[GCOV_MAX_SINKS + 4];
+    u32 count;
+} GcovEmit;
 
 /* ----------------------------------------------------------- */
 /*
@@ -109,7 +157,9 @@ gcov_unsigned_t gcov_buf[8192];
 
 void __gcov_init(struct gcov_info *info)
 {
-    GcovInfo *newHead = NULL;
+#ifdef GCOV_OPT_ATOMIC_REGISTRATION
+    struct gcov_info *head;
+#endif // GCOV_OPT_ATOMIC_REGISTRATION
 
 #ifdef GCOV_OPT_PRINT_STATUS
     GCOV_PRINT_STR("__gcov_init called for ");
@@ -120,34 +170,18 @@ void __gcov_init(struct gcov_info *info)
 #endif // GCOV_OPT_USE_STDLIB
 #endif // GCOV_OPT_PRINT_STATUS
 
-#ifdef GCOV_OPT_USE_MALLOC
-    newHead = malloc(sizeof(GcovInfo));
-#else
-    if (gcov_GcovIndex >= sizeof(gcov_GcovInfo)/sizeof(gcov_GcovInfo[0])) {
-        newHead = NULL;
-    } else {
-        newHead = gcov_GcovInfo + gcov_GcovIndex;
-    }
-#endif // GCOV_OPT_USE_MALLOC else
-
-    if (!newHead) {
-#ifdef GCOV_OPT_PRINT_STATUS
-        GCOV_PRINT_STR("Out of memory!"); GCOV_PRINT_STR("\n");
-#endif // GCOV_OPT_PRINT_STATUS
-#ifdef GCOV_OPT_USE_STDLIB
-        exit(1);
+#ifdef GCOV_OPT_ATOMIC_REGISTRATION
+    /* Push onto the list; retry if another caller pushed first.
+     * On failure, the current head is loaded into head. */
+    head = __atomic_load_n(&gcov_headGcov, __ATOMIC_RELAXED);
+    do {
+        gcov_info_set_next(info, head);
+    } while (!__atomic_compare_exchange_n(&gcov_headGcov, &head, info,
+                                          1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
 #else
-        return;
-#endif // GCOV_OPT_USE_STDLIB
-    }
-
-    newHead->info = info;
-    newHead->next = gcov_headGcov;
-    gcov_headGcov = newHead;
-
-#ifndef GCOV_OPT_USE_MALLOC
-    gcov_GcovIndex++;
-#endif // not GCOV_OPT_USE_MALLOC
+    gcov_info_set_next(info, gcov_headGcov);
+    gcov_headGcov = info;
+#endif // GCOV_OPT_ATOMIC_REGISTRATION else
 }
 
 
@@ -189,21 +223,16 @@ void __gcov_call_constructors(void) {
      * remain in such a situation, call __gcov_clear() if
      * you need to clear the counters.
      *
-     * If not actually restarting, and if using malloc,
-     * and if you do not call __gcov_exit between calls
-     * to this function to free the memory,
-     * you will have memory leaks.
+     * Each file must be registered only once between resets,
+     * since the list is linked through the gcov data itself.
      */
     gcov_headGcov = NULL;
-#ifndef GCOV_OPT_USE_MALLOC
-    gcov_GcovIndex = 0;
-#endif
 
     ctor = &__ctor_list;
     while (ctor != &__ctor_end) {
         void (*func)(void);
 
-        func = (void ( *)(void))(*(UINT32 *)ctor);
+        func = *(void (**)(void))ctor;
 
         func();
         ctor++;
@@ -214,249 +243,2028 @@ void __gcov_call_constructors(void) {
 
 /* ----------------------------------------------------------- */
 /*
- * __gcov_exit needs to be called in your code at the point
- * where you want to generate coverage data for extraction.
+ * Built-in output sinks, one per GCOV_OPT_OUTPUT_* option.
+ * They take part in every dump, along with any sinks
+ * your code registers with __gcov_register_sink.
  */
-void __gcov_exit(void)
-{
-    GcovInfo *listptr = gcov_headGcov;
 
 #if defined(GCOV_OPT_OUTPUT_BINARY_FILE) || defined(GCOV_OPT_OUTPUT_BINARY_MEMORY)
-    char const *p;
-#endif
+/* The binary outputs share one layout, see gcov_format.h */
+static const char gcov_endMarker[] = GCOV_BINARY_END_MARKER;
+
+static void gcov_binary_header(int (*write)(void *ctx, const void *data, gcov_unsigned_t length),
+                               const char *filename, gcov_unsigned_t length)
+{
+    unsigned char count[4];
+    u32 n = 0;
+
+    /* write the filename with trailing null char */
+    while (filename[n]) {
+        n++;
+    }
+    (void)write(NULL, filename, n + 1);
+
+    /* write the data byte count */
+    /* we don't know endianness, so use shifts for consistent MSB first */
+    count[0] = (unsigned char)(length >> 24);
+    count[1] = (unsigned char)(length >> 16);
+    count[2] = (unsigned char)(length >> 8);
+    count[3] = (unsigned char)(length);
+    (void)write(NULL, count, sizeof(count));
+}
+#endif // GCOV_OPT_OUTPUT_BINARY_FILE || GCOV_OPT_OUTPUT_BINARY_MEMORY
 
 #ifdef GCOV_OPT_OUTPUT_BINARY_FILE
-    unsigned char bf;
-    GCOV_FILE_TYPE file;
-#endif // GCOV_OPT_OUTPUT_BINARY_FILE
+static GCOV_FILE_TYPE gcov_outputFile;
 
-#ifdef GCOV_OPT_OUTPUT_BINARY_MEMORY
-    gcov_output_index = 0;
-#endif // GCOV_OPT_OUTPUT_BINARY_MEMORY
+/* Output is staged here so the file gets one write per buffer-full */
+static unsigned char gcov_fileBuffer[GCOV_FILE_BUFFER_SIZE];
+static u32 gcov_fileBufferUsed;
+static int gcov_fileError;
+
+/*
+ * gcov_file_put writes all of a block to the file,
+ * going on after short or interrupted writes.
+ * After a failure, the rest of this output is dropped.
+ */
+static int gcov_file_put(const unsigned char *p, u32 length)
+{
+    while (length && !gcov_fileError) {
+        long n = (long)GCOV_WRITE_BLOCK(gcov_outputFile, p, length);
 
+        if (n > 0) {
+            p += n;
+            length -= (u32)n;
+        } else if (!GCOV_WRITE_AGAIN(gcov_outputFile)) {
+            gcov_fileError = 1;
 #ifdef GCOV_OPT_PRINT_STATUS
-    GCOV_PRINT_STR("gcov_exit"); GCOV_PRINT_STR("\n");
+            GCOV_PRINT_STR("Unable to write gcov output file!"); GCOV_PRINT_STR("\n");
 #endif // GCOV_OPT_PRINT_STATUS
+        }
+    }
+    return gcov_fileError ? -1 : 0;
+}
 
-#ifdef GCOV_OPT_OUTPUT_BINARY_FILE
-    file = GCOV_OPEN_FILE(GCOV_OUTPUT_BINARY_FILENAME);
-    if (GCOV_OPEN_ERROR(file)) {
+static int gcov_file_flush(void)
+{
+    u32 used = gcov_fileBufferUsed;
+
+    gcov_fileBufferUsed = 0;
+    return gcov_file_put(gcov_fileBuffer, used);
+}
+
+static int gcov_file_open(void *ctx)
+{
+    (void)ctx; // ignore unused param
+
+    gcov_fileBufferUsed = 0;
+    gcov_fileError = 0;
+    gcov_outputFile = GCOV_OPEN_FILE(GCOV_OUTPUT_BINARY_FILENAME);
+    if (GCOV_OPEN_ERROR(gcov_outputFile)) {
 #ifdef GCOV_OPT_PRINT_STATUS
         GCOV_PRINT_STR("Unable to open gcov output file!"); GCOV_PRINT_STR("\n");
 #endif // GCOV_OPT_PRINT_STATUS
-#ifdef GCOV_OPT_USE_STDLIB
-        exit(1);
-#else
-        return;
-#endif // GCOV_OPT_USE_STDLIB
+        return -1;
     }
-#endif // GCOV_OPT_OUTPUT_BINARY_FILE
+    return 0;
+}
+
+static int gcov_file_write(void *ctx, const void *data, gcov_unsigned_t length)
+{
+    const unsigned char *p = (const unsigned char *)data;
 
-    while (listptr) {
-        gcov_unsigned_t *buffer = NULL; // Need buffer to be 32-bit-aligned for type-safe internal usage
-        u32 bytesNeeded;
+    (void)ctx; // ignore unused param
 
-        /* Do pretend conversion to see how many bytes are needed */
-        bytesNeeded = gcov_convert_to_gcda(NULL, listptr->info);
+    while (length) {
+        u32 n = GCOV_FILE_BUFFER_SIZE - gcov_fileBufferUsed;
 
-#ifdef GCOV_OPT_USE_MALLOC
-        buffer = malloc(bytesNeeded);
-#else
-        if (bytesNeeded > sizeof(gcov_buf)/sizeof(char)) {
-            buffer = (gcov_unsigned_t *)NULL;
-        } else {
-            buffer = gcov_buf;
+        if (n == GCOV_FILE_BUFFER_SIZE && length >= GCOV_FILE_BUFFER_SIZE) {
+            /* nothing staged and at least a buffer-full to go, write directly */
+            return gcov_file_put(p, length);
         }
-#endif // GCOV_OPT_USE_MALLOC else
 
-        if (!buffer) {
-#ifdef GCOV_OPT_PRINT_STATUS
-            GCOV_PRINT_STR("Out of memory!"); GCOV_PRINT_STR("\n");
-#endif // GCOV_OPT_PRINT_STATUS
-#ifdef GCOV_OPT_USE_STDLIB
-            exit(1);
-#else
-            return;
-#endif // GCOV_OPT_USE_STDLIB
+        if (n > length) {
+            n = length;
+        }
+        for (u32 i=0; i<n; i++) {
+            gcov_fileBuffer[gcov_fileBufferUsed++] = p[i];
         }
+        p += n;
+        length -= n;
 
-        /* Do the real conversion into buffer */
-        gcov_convert_to_gcda(buffer, listptr->info);
+        if (gcov_fileBufferUsed == GCOV_FILE_BUFFER_SIZE && gcov_file_flush()) {
+            return -1;
+        }
+    }
+    return gcov_fileError ? -1 : 0;
+}
 
-#if defined(GCOV_OPT_PRINT_STATUS) || defined(GCOV_OPT_OUTPUT_SERIAL_HEXDUMP)
-        GCOV_PRINT_STR("Emitting ");
-        GCOV_PRINT_NUM(bytesNeeded);
-        GCOV_PRINT_STR(" bytes for ");
-        GCOV_PRINT_STR(gcov_info_filename(listptr->info));
-        GCOV_PRINT_STR("\n");
-#endif
+static int gcov_file_begin(void *ctx, const char *filename, gcov_unsigned_t length)
+{
+    (void)ctx; // ignore unused param
 
-#ifdef GCOV_OPT_OUTPUT_BINARY_FILE
-        /* write the filename */
-        p = gcov_info_filename(listptr->info);
-        while (p && (*p)) {
-            bf = (*p++);
-            (void)GCOV_WRITE_BYTE(file, bf);
-        }
-        /* add trailing null char */
-        bf = '\0';
-        (void)GCOV_WRITE_BYTE(file, bf);
-        
-        /* write the data byte count */
-        /* we don't know endianness, so use division for consistent MSB first */
-        bf = (unsigned char)(bytesNeeded / 16777216);
-        (void)GCOV_WRITE_BYTE(file, bf);
-        bf = (unsigned char)(bytesNeeded / 65536);
-        (void)GCOV_WRITE_BYTE(file, bf);
-        bf = (unsigned char)(bytesNeeded / 255);
-        (void)GCOV_WRITE_BYTE(file, bf);
-        bf = (unsigned char)(bytesNeeded);
-        (void)GCOV_WRITE_BYTE(file, bf);
-
-        /* write the data */
-        for (u32 i=0; i<bytesNeeded; i++) {
-            bf = (unsigned char)(((unsigned char *)buffer)[i]);
-            (void)GCOV_WRITE_BYTE(file, bf);
-        }
+    gcov_binary_header(gcov_file_write, filename, length);
+    return 0;
+}
+
+static int gcov_file_close(void *ctx)
+{
+    (void)gcov_file_write(ctx, gcov_endMarker, sizeof(gcov_endMarker));
+    (void)gcov_file_flush();
+    GCOV_CLOSE_FILE(gcov_outputFile);
+    return gcov_fileError ? -1 : 0;
+}
+
+static const gcov_sink gcov_fileSink = {
+    gcov_file_open, gcov_file_begin, gcov_file_write, NULL, gcov_file_close, NULL
+};
 #endif // GCOV_OPT_OUTPUT_BINARY_FILE
 
 #ifdef GCOV_OPT_OUTPUT_BINARY_MEMORY
-        /* copy the filename */
-        p = gcov_info_filename(listptr->info);
-        while (p && (*p)) {
-            gcov_output_buffer[gcov_output_index++] = (*p++);
-        }
-        /* add trailing null char */
-        gcov_output_buffer[gcov_output_index++] = '\0';
+static int gcov_memory_open(void *ctx)
+{
+    (void)ctx; // ignore unused param
+
+    gcov_output_index = 0;
+    return 0;
+}
 
-        /* store the data byte count */
-        /* we don't know endianness, so use division for consistent MSB first */
-        gcov_output_buffer[gcov_output_index++] = (unsigned char)(bytesNeeded / 16777216);
-        gcov_output_buffer[gcov_output_index++] = (unsigned char)(bytesNeeded / 65536);
-        gcov_output_buffer[gcov_output_index++] = (unsigned char)(bytesNeeded / 255);
-        gcov_output_buffer[gcov_output_index++] = (unsigned char)(bytesNeeded);
+static int gcov_memory_write(void *ctx, const void *data, gcov_unsigned_t length)
+{
+    const unsigned char *p = (const unsigned char *)data;
 
-        /* copy the data */
-        for (u32 i=0; i<bytesNeeded; i++) {
-            gcov_output_buffer[gcov_output_index++] = (unsigned char)(((unsigned char *)buffer)[i]);
-        }
+    (void)ctx; // ignore unused param
+
+    for (u32 i=0; i<length; i++) {
+        gcov_output_buffer[gcov_output_index++] = p[i];
+    }
+    return 0;
+}
+
+static int gcov_memory_begin(void *ctx, const char *filename, gcov_unsigned_t length)
+{
+    (void)ctx; // ignore unused param
+
+    gcov_binary_header(gcov_memory_write, filename, length);
+    return 0;
+}
+
+static int gcov_memory_close(void *ctx)
+{
+    return gcov_memory_write(ctx, gcov_endMarker, sizeof(gcov_endMarker));
+}
+
+static const gcov_sink gcov_memorySink = {
+    gcov_memory_open, gcov_memory_begin, gcov_memory_write, NULL, gcov_memory_close, NULL
+};
 #endif // GCOV_OPT_OUTPUT_BINARY_MEMORY
 
 #ifdef GCOV_OPT_OUTPUT_SERIAL_HEXDUMP
-        /* If your embedded system does not support printf or an imitation,
-         * you'll need to change this code.
-         */
-        for (u32 i=0; i<bytesNeeded; i++) {
-            if (i%16 == 0) GCOV_PRINT_HEXDUMP_ADDR(i);
-            GCOV_PRINT_HEXDUMP_DATA((unsigned char)(((unsigned char *)buffer)[i]));
-            if (i%16 == 15) GCOV_PRINT_STR("\n");
-        }
-        GCOV_PRINT_STR("\n");
-        GCOV_PRINT_STR(gcov_info_filename(listptr->info));
-        GCOV_PRINT_STR("\n");
-#endif // GCOV_OPT_OUTPUT_SERIAL_HEXDUMP
-
-/* Other output methods might be imagined,
- * if you have flash that can be written directly,
- * or the luxury of a filesystem, etc.
+/*
+ * The hexdump output matches "xxd -g1" style lines, as read back
+ * by scripts/serial_split.awk and xxd -r:
+ * "%08x: " address, then "%02x " for each of up to 16 bytes,
+ * then a newline (which the last partial line of a file gets
+ * from gcov_hexdump_end).
  */
+static const char gcov_hexDigits[16] = {
+    '0', '1', '2', '3', '4', '5', '6', '7',
+    '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'
+};
 
-#ifdef GCOV_OPT_USE_MALLOC
-        free(buffer);
-#endif // GCOV_OPT_USE_MALLOC
+static u32 gcov_hexdumpOffset; /* bytes of the current file printed so far */
+static unsigned char gcov_hexdumpBytes[16]; /* bytes of the line not yet printed */
 
-        listptr = listptr->next;
-    } /* end while listptr */
+static void gcov_hexdump_line(u32 address, u32 count, int newline)
+{
+    char line[8 + 2 + 16*3 + 1]; /* address, ": ", bytes, newline */
+    u32 n = 0;
 
-    /* Add end marker to output */
-#ifdef GCOV_OPT_OUTPUT_BINARY_FILE
-    bf = 'G';
-    (void)GCOV_WRITE_BYTE(file, bf);
-    bf = 'c';
-    (void)GCOV_WRITE_BYTE(file, bf);
-    bf = 'o';
-    (void)GCOV_WRITE_BYTE(file, bf);
-    bf = 'v';
-    (void)GCOV_WRITE_BYTE(file, bf);
-    bf = ' ';
-    (void)GCOV_WRITE_BYTE(file, bf);
-    bf = 'E';
-    (void)GCOV_WRITE_BYTE(file, bf);
-    bf = 'n';
-    (void)GCOV_WRITE_BYTE(file, bf);
-    bf = 'd';
-    (void)GCOV_WRITE_BYTE(file, bf);
-    bf = '\0';
-    (void)GCOV_WRITE_BYTE(file, bf);
-
-    GCOV_CLOSE_FILE(file);
-#endif // GCOV_OPT_OUTPUT_BINARY_FILE
+    for (int shift = 28; shift >= 0; shift -= 4) {
+        line[n++] = gcov_hexDigits[(address >> shift) & 0xf];
+    }
+    line[n++] = ':';
+    line[n++] = ' ';
+    for (u32 i=0; i<count; i++) {
+        line[n++] = gcov_hexDigits[gcov_hexdumpBytes[i] >> 4];
+        line[n++] = gcov_hexDigits[gcov_hexdumpBytes[i] & 0xf];
+        line[n++] = ' ';
+    }
+    if (newline) {
+        line[n++] = '\n';
+    }
 
-#ifdef GCOV_OPT_OUTPUT_BINARY_MEMORY
-    gcov_output_buffer[gcov_output_index++] = 'G';
-    gcov_output_buffer[gcov_output_index++] = 'c';
-    gcov_output_buffer[gcov_output_index++] = 'o';
-    gcov_output_buffer[gcov_output_index++] = 'v';
-    gcov_output_buffer[gcov_output_index++] = ' ';
-    gcov_output_buffer[gcov_output_index++] = 'E';
-    gcov_output_buffer[gcov_output_index++] = 'n';
-    gcov_output_buffer[gcov_output_index++] = 'd';
-    gcov_output_buffer[gcov_output_index++] = '\0';
-#endif // GCOV_OPT_OUTPUT_BINARY_MEMORY
+    GCOV_PRINT_HEXDUMP_LINE(line, n);
+}
+
+static int gcov_hexdump_begin(void *ctx, const char *filename, gcov_unsigned_t length)
+{
+    (void)ctx; // ignore unused param
+
+    GCOV_PRINT_STR("Emitting ");
+    GCOV_PRINT_NUM(length);
+    GCOV_PRINT_STR(" bytes for ");
+    GCOV_PRINT_STR(filename);
+    GCOV_PRINT_STR("\n");
+
+    gcov_hexdumpOffset = 0;
+    return 0;
+}
+
+static int gcov_hexdump_write(void *ctx, const void *data, gcov_unsigned_t length)
+{
+    const unsigned char *p = (const unsigned char *)data;
+
+    (void)ctx; // ignore unused param
+
+    /* If your embedded system does not support printf or an imitation,
+     * you'll need to change GCOV_PRINT_HEXDUMP_LINE.
+     */
+    for (u32 i=0; i<length; i++) {
+        gcov_hexdumpBytes[gcov_hexdumpOffset % 16] = p[i];
+        gcov_hexdumpOffset++;
+        if (gcov_hexdumpOffset % 16 == 0) {
+            gcov_hexdump_line(gcov_hexdumpOffset - 16, 16, 1);
+        }
+    }
+    return 0;
+}
+
+static int gcov_hexdump_end(void *ctx, const char *filename)
+{
+    u32 partial = gcov_hexdumpOffset % 16;
+
+    (void)ctx; // ignore unused param
+
+    if (partial) {
+        gcov_hexdump_line(gcov_hexdumpOffset - partial, partial, 0);
+    }
+    GCOV_PRINT_STR("\n");
+    GCOV_PRINT_STR(filename);
+    GCOV_PRINT_STR("\n");
+    return 0;
+}
+
+static int gcov_hexdump_close(void *ctx)
+{
+    (void)ctx; // ignore unused param
 
-#if defined(GCOV_OPT_PRINT_STATUS) || defined(GCOV_OPT_OUTPUT_SERIAL_HEXDUMP)
     GCOV_PRINT_STR("Gcov End");
     GCOV_PRINT_STR("\n");
-#endif
+    return 0;
 }
 
-/* ----------------------------------------------------------- */
-#ifdef GCOV_OPT_PROVIDE_CLEAR_COUNTERS
+static const gcov_sink gcov_hexdumpSink = {
+    NULL, gcov_hexdump_begin, gcov_hexdump_write, gcov_hexdump_end, gcov_hexdump_close, NULL
+};
+#endif // GCOV_OPT_OUTPUT_SERIAL_HEXDUMP
+
+#ifdef GCOV_OPT_OUTPUT_SERIAL_FRAMED
 /*
- * __gcov_clear is optional to call if you want to clear the counters,
- * such as after program startup (if you don't want to count the startup)
- * or between test runs.
- * The counters are automatically zero at startup.
+ * Frames are COBS encoded on the fly, one block of up to 254
+ * non-zero bytes at a time, so no frame buffer is needed.
+ * See gcov_format.h for the frame layout.
  */
-void __gcov_clear(void)
+
+/* CRC-32 lookup table, one entry per nibble to keep it small */
+static const u32 gcov_crcTable[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+static u32 gcov_frameSeq;
+static u32 gcov_frameCrc;
+static unsigned char gcov_cobsBlock[255]; /* code byte, then up to 254 non-zero bytes */
+static u32 gcov_cobsUsed;
+
+static void gcov_cobs_flush(void)
 {
-    GcovInfo *listptr = gcov_headGcov;
+    gcov_cobsBlock[0] = (unsigned char)gcov_cobsUsed;
+    GCOV_WRITE_SERIAL_BYTES(gcov_cobsBlock, gcov_cobsUsed);
+    gcov_cobsUsed = 1;
+}
 
-#ifdef GCOV_OPT_PRINT_STATUS
-    GCOV_PRINT_STR("gcov_clear"); GCOV_PRINT_STR("\n");
-#endif // GCOV_OPT_PRINT_STATUS
+static void gcov_cobs_byte(unsigned char b)
+{
+    if (b == 0) {
+        gcov_cobs_flush();
+        return;
+    }
+    gcov_cobsBlock[gcov_cobsUsed++] = b;
+    if (gcov_cobsUsed == sizeof(gcov_cobsBlock)) {
+        gcov_cobs_flush();
+    }
+}
+
+static void gcov_frame_bytes(const unsigned char *p, u32 length)
+{
+    for (u32 i=0; i<length; i++) {
+        gcov_frameCrc ^= p[i];
+        gcov_frameCrc = (gcov_frameCrc >> 4) ^ gcov_crcTable[gcov_frameCrc & 0xf];
+        gcov_frameCrc = (gcov_frameCrc >> 4) ^ gcov_crcTable[gcov_frameCrc & 0xf];
+        gcov_cobs_byte(p[i]);
+    }
+}
+
+static void gcov_frame_start(unsigned char type)
+{
+    static const unsigned char delimiter = GCOV_FRAME_DELIMITER;
+    unsigned char header[GCOV_FRAME_HEADER_SIZE];
+
+    /* delimiter first too, to separate the frame from any console text */
+    GCOV_WRITE_SERIAL_BYTES(&delimiter, 1);
+
+    gcov_cobsUsed = 1;
+    gcov_frameCrc = 0xFFFFFFFFUL;
+
+    header[0] = type;
+    header[1] = (unsigned char)(gcov_frameSeq >> 8);
+    header[2] = (unsigned char)(gcov_frameSeq);
+    gcov_frame_bytes(header, sizeof(header));
+}
+
+static void gcov_frame_finish(void)
+{
+    static const unsigned char delimiter = GCOV_FRAME_DELIMITER;
+    u32 crc = ~gcov_frameCrc;
+
+    gcov_cobs_byte((unsigned char)(crc >> 24));
+    gcov_cobs_byte((unsigned char)(crc >> 16));
+    gcov_cobs_byte((unsigned char)(crc >> 8));
+    gcov_cobs_byte((unsigned char)(crc));
+    gcov_cobs_flush();
+    GCOV_WRITE_SERIAL_BYTES(&delimiter, 1);
+
+    gcov_frameSeq = (gcov_frameSeq + 1) & 0xffff;
+}
+
+static int gcov_framed_open(void *ctx)
+{
+    (void)ctx; // ignore unused param
 
-    while (listptr) {
+    gcov_frameSeq = 0;
+    gcov_frame_start(GCOV_FRAME_OPEN);
+    gcov_frame_finish();
+    return 0;
+}
+
+static int gcov_framed_begin(void *ctx, const char *filename, gcov_unsigned_t length)
+{
+    unsigned char count[4];
+    u32 n = 0;
 
-        gcov_clear_counters(listptr->info);
+    (void)ctx; // ignore unused param
 
-        listptr = listptr->next;
+    while (filename[n]) {
+        n++;
     }
+
+    /* data byte count MSB first, then filename */
+    count[0] = (unsigned char)(length >> 24);
+    count[1] = (unsigned char)(length >> 16);
+    count[2] = (unsigned char)(length >> 8);
+    count[3] = (unsigned char)(length);
+
+    gcov_frame_start(GCOV_FRAME_BEGIN);
+    gcov_frame_bytes(count, sizeof(count));
+    gcov_frame_bytes((const unsigned char *)filename, n);
+    gcov_frame_finish();
+    return 0;
 }
-#endif // GCOV_OPT_PROVIDE_CLEAR_COUNTERS
+
+static int gcov_framed_write(void *ctx, const void *data, gcov_unsigned_t length)
+{
+    const unsigned char *p = (const unsigned char *)data;
+
+    (void)ctx; // ignore unused param
+
+    while (length) {
+        u32 n = (length > GCOV_FRAME_DATA_SIZE) ? GCOV_FRAME_DATA_SIZE : length;
+
+        gcov_frame_start(GCOV_FRAME_DATA);
+        gcov_frame_bytes(p, n);
+        gcov_frame_finish();
+        p += n;
+        length -= n;
+    }
+    return 0;
+}
+
+static int gcov_framed_end(void *ctx, const char *filename)
+{
+    (void)ctx; // ignore unused param
+    (void)filename; // ignore unused param
+
+    gcov_frame_start(GCOV_FRAME_END);
+    gcov_frame_finish();
+    return 0;
+}
+
+static int gcov_framed_close(void *ctx)
+{
+    (void)ctx; // ignore unused param
+
+    gcov_frame_start(GCOV_FRAME_CLOSE);
+    gcov_frame_finish();
+    return 0;
+}
+
+static const gcov_sink gcov_framedSink = {
+    gcov_framed_open, gcov_framed_begin, gcov_framed_write, gcov_framed_end, gcov_framed_close, NULL
+};
+#endif // GCOV_OPT_OUTPUT_SERIAL_FRAMED
+
+/* Other output methods might be imagined,
+ * if you have flash that can be written directly,
+ * or the luxury of a filesystem, etc.
+ * Those can be added without changing this file,
+ * see __gcov_register_sink below.
+ */
+
 
 /* ----------------------------------------------------------- */
 /*
- * This function should never be called. Merging is not supported.
- * Just providing for the interface, and to warn if someone
- * (including gcc internals) tries to use it.
+ * __gcov_register_sink adds an output sink of your own,
+ * such as flash, telemetry packets, or a DMA UART,
+ * to be fed by every following __gcov_exit.
+ * The sink structure must stay valid while registered.
+ * Returns 0 on success, -1 if GCOV_MAX_SINKS are already registered.
  */
-void __gcov_merge_add(gcov_type *counters, gcov_unsigned_t n_counters)
+int __gcov_register_sink(const gcov_sink *sink)
 {
-    (void)counters; // ignore unused param
-    (void)n_counters; // ignore unused param
+    for (u32 i=0; i<GCOV_MAX_SINKS; i++) {
+        if (gcov_userSinks[i] == sink) {
+            return 0; // already there, possibly after a freed slot
+        }
+    }
+
+    for (u32 i=0; i<GCOV_MAX_SINKS; i++) {
+        if (gcov_userSinks[i] == NULL) {
+            gcov_userSinks[i] = sink;
+            return 0;
+        }
+    }
 
 #ifdef GCOV_OPT_PRINT_STATUS
-    GCOV_PRINT_STR("__gcov_merge_add isn't called, right? Right? RIGHT?");
+    GCOV_PRINT_STR("Too many gcov sinks!"); GCOV_PRINT_STR("\n");
 #endif // GCOV_OPT_PRINT_STATUS
+    return -1;
+}
 
-#ifdef GCOV_OPT_USE_STDLIB
-    fflush(stdout);
-    exit(1);
-#else
-    return;
-#endif // GCOV_OPT_USE_STDLIB
+/*
+ * __gcov_unregister_sink removes a sink added by __gcov_register_sink.
+ */
+void __gcov_unregister_sink(const gcov_sink *sink)
+{
+    for (u32 i=0; i<GCOV_MAX_SINKS; i++) {
+        if (gcov_userSinks[i] == sink) {
+            gcov_userSinks[i] = NULL;
+        }
+    }
+}
+
+/* ----------------------------------------------------------- */
+/*
+ * gcov_emit_open collects the sinks for one dump,
+ * built-in ones first, and opens them.
+ * A sink that fails to open is left out of this dump.
+ */
+static void gcov_emit_open(GcovEmit *emit)
+{
+    const gcov_sink *candidates[GCOV_MAX_SINKS + 4];
+    u32 n = 0;
+
+#ifdef GCOV_OPT_OUTPUT_BINARY_FILE
+    candidates[n++] = &gcov_fileSink;
+#endif // GCOV_OPT_OUTPUT_BINARY_FILE
+#ifdef GCOV_OPT_OUTPUT_BINARY_MEMORY
+    candidates[n++] = &gcov_memorySink;
+#endif // GCOV_OPT_OUTPUT_BINARY_MEMORY
+#ifdef GCOV_OPT_OUTPUT_SERIAL_HEXDUMP
+    candidates[n++] = &gcov_hexdumpSink;
+#endif // GCOV_OPT_OUTPUT_SERIAL_HEXDUMP
+#ifdef GCOV_OPT_OUTPUT_SERIAL_FRAMED
+    candidates[n++] = &gcov_framedSink;
+#endif // GCOV_OPT_OUTPUT_SERIAL_FRAMED
+    for (u32 i=0; i<GCOV_MAX_SINKS; i++) {
+        if (gcov_userSinks[i]) {
+            candidates[n++] = gcov_userSinks[i];
+        }
+    }
+
+    emit->count = 0;
+    for (u32 i=0; i<n; i++) {
+        if (candidates[i]->open && candidates[i]->open(candidates[i]->ctx) != 0) {
+            continue;
+        }
+        emit->sinks[emit->count++] = candidates[i];
+    }
+}
+
+/*
+ * gcov_emit_data passes one block of gcda data to every sink.
+ */
+static void gcov_emit_data(GcovEmit *emit, const void *data, gcov_unsigned_t length)
+{
+    for (u32 i=0; i<emit->count; i++) {
+        (void)emit->sinks[i]->write(emit->sinks[i]->ctx, data, length);
+    }
+}
+
+
+/* ----------------------------------------------------------- */
+/*
+ * Dump in progress, see __gcov_dump_begin.
+ * The cursor remembers the position within the current file
+ * (function, counter type, counter index) between steps.
+ */
+typedef struct tagGcovDump {
+    GcovEmit emit;
+    GcovList listptr;           /* file being dumped */
+    struct gcov_cursor cursor;  /* position within that file */
+    int fileStarted;            /* sinks have had begin for listptr */
+    int active;                 /* dump begun and not yet done */
+#ifdef GCOV_OPT_SNAPSHOT
+    const gcov_type *snapshot;  /* next snapshot value, NULL if dumping live counters */
+#endif // GCOV_OPT_SNAPSHOT
+#ifdef GCOV_OPT_DELTA_DUMP
+    gcov_unsigned_t *fingerprints; /* words of the file being dumped, NULL if none */
+    int delta;                  /* send only what changed */
+#endif // GCOV_OPT_DELTA_DUMP
+#ifdef GCOV_OPT_TEST_CAPTURE
+    int test;                   /* send only files touched, tagged with testId */
+    gcov_unsigned_t testId;
+#endif // GCOV_OPT_TEST_CAPTURE
+#ifdef GCOV_OPT_PROVIDE_CLEAR_COUNTERS
+    int reset;                  /* zero the counters as they are read */
+#endif // GCOV_OPT_PROVIDE_CLEAR_COUNTERS
+} GcovDump;
+static GcovDump gcov_dump;
+
+#ifdef GCOV_OPT_BACKGROUND_PTHREAD
+/* Background dump states */
+#define GCOV_BACKGROUND_IDLE     0 /* no thread */
+#define GCOV_BACKGROUND_STARTING 1 /* __gcov_dump_background is starting one */
+#define GCOV_BACKGROUND_RUNNING  2 /* the thread owns gcov_dump */
+#define GCOV_BACKGROUND_JOINING  3 /* __gcov_dump_wait is joining it */
+/* Changed with __atomic builtins */
+static int gcov_backgroundState = GCOV_BACKGROUND_IDLE;
+static pthread_t gcov_dumpThread;
+/* Set in the background thread only */
+static __thread int gcov_inDumpThread;
+#endif // GCOV_OPT_BACKGROUND_PTHREAD
+
+#ifdef GCOV_OPT_SNAPSHOT
+/* Snapshot states */
+#define GCOV_SNAPSHOT_FREE     0 /* no snapshot, the next dump uses live counters */
+#define GCOV_SNAPSHOT_TAKEN    1 /* the next dump uses the snapshot */
+#define GCOV_SNAPSHOT_DUMPING  2 /* a dump is reading the snapshot */
+#define GCOV_SNAPSHOT_COPYING  3 /* __gcov_snapshot is taking it */
+/* Changed with __atomic builtins, as the background thread reads it */
+static int gcov_snapshotState = GCOV_SNAPSHOT_FREE;
+static GcovList gcov_snapshotHead; /* files in the snapshot */
+static gcov_type *gcov_snapshotValues;
+#ifndef GCOV_OPT_USE_MALLOC
+/* Declare space. Needs to be enough for all counters of all files. */
+static gcov_type gcov_snapshotArea[GCOV_SNAPSHOT_COUNTERS];
+#endif // not GCOV_OPT_USE_MALLOC
+
+/*
+ * __gcov_snapshot copies the counters of every file,
+ * one block copy per counter array, for the next dump to use.
+ * Cheap enough to call from a busy thread; leave the dump itself
+ * (__gcov_dump_begin and __gcov_dump_step) to a low-priority task.
+ * Returns 0 on success, -1 if the snapshot area is too small
+ * or the previous snapshot has not been dumped yet.
+ */
+int __gcov_snapshot(void)
+{
+    GcovList listptr;
+    size_t total = 0;
+    size_t pos = 0;
+    int state = GCOV_SNAPSHOT_FREE;
+
+    if (!__atomic_compare_exchange_n(&gcov_snapshotState, &state, GCOV_SNAPSHOT_COPYING,
+                                     0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return -1;
+    }
+
+    /* New files are added at the head of the list,
+     * so the files from here on cannot change under us */
+    gcov_snapshotHead = GCOV_LIST_FIRST();
+
+    for (listptr = gcov_snapshotHead; GCOV_LIST_INFO(listptr); listptr = GCOV_LIST_NEXT(listptr)) {
+        total += gcov_counters_count(GCOV_LIST_INFO(listptr));
+    }
+
+#ifdef GCOV_OPT_USE_MALLOC
+    gcov_snapshotValues = malloc(total ? total * sizeof(gcov_type) : 1);
+#else
+    gcov_snapshotValues = (total <= GCOV_SNAPSHOT_COUNTERS) ? gcov_snapshotArea : NULL;
+#endif // GCOV_OPT_USE_MALLOC else
+
+    if (!gcov_snapshotValues) {
+#ifdef GCOV_OPT_PRINT_STATUS
+        GCOV_PRINT_STR("Out of memory!"); GCOV_PRINT_STR("\n");
+#endif // GCOV_OPT_PRINT_STATUS
+        __atomic_store_n(&gcov_snapshotState, GCOV_SNAPSHOT_FREE, __ATOMIC_RELEASE);
+        return -1;
+    }
+
+    for (listptr = gcov_snapshotHead; GCOV_LIST_INFO(listptr); listptr = GCOV_LIST_NEXT(listptr)) {
+        pos += gcov_snapshot_counters(GCOV_LIST_INFO(listptr), gcov_snapshotValues + pos);
+    }
+
+    __atomic_store_n(&gcov_snapshotState, GCOV_SNAPSHOT_TAKEN, __ATOMIC_RELEASE);
+    return 0;
+}
+#endif // GCOV_OPT_SNAPSHOT
+
+#ifdef GCOV_OPT_DELTA_DUMP
+/* For each file in dump order: the generation it was last sent in,
+ * then the fingerprint of each function when it was last sent */
+static gcov_unsigned_t *gcov_deltaWords;
+static u32 gcov_deltaGeneration;   /* of the latest dump */
+static GcovList gcov_deltaHead;    /* files in the latest dump */
+static int gcov_deltaValid;        /* latest dump done, words match what was sent */
+#ifdef GCOV_OPT_USE_MALLOC
+static size_t gcov_deltaSize;      /* words allocated */
+#else
+/* Declare space. Needs to be enough for all functions and files. */
+static gcov_unsigned_t gcov_deltaArea[GCOV_DELTA_WORDS];
+#endif // GCOV_OPT_USE_MALLOC else
+
+/*
+ * gcov_delta_begin sets up the dump starting at head
+ * as a delta dump if it can, or else as a full dump.
+ */
+static void gcov_delta_begin(GcovList head)
+{
+    GcovList listptr;
+    size_t total = 0;
+
+    for (listptr = head; GCOV_LIST_INFO(listptr); listptr = GCOV_LIST_NEXT(listptr)) {
+        total += 1 + gcov_fingerprints_count(GCOV_LIST_INFO(listptr));
+    }
+
+    /* Words are kept by position, so the files must be the same ones */
+    if (head != gcov_deltaHead) {
+        gcov_deltaValid = 0;
+    }
+
+#ifdef GCOV_OPT_USE_MALLOC
+    if (total > gcov_deltaSize) {
+        free(gcov_deltaWords);
+        gcov_deltaWords = malloc(total * sizeof(gcov_unsigned_t));
+        gcov_deltaSize = gcov_deltaWords ? total : 0;
+        gcov_deltaValid = 0;
+    }
+#else
+    gcov_deltaWords = (total <= GCOV_DELTA_WORDS) ? gcov_deltaArea : NULL;
+#endif // GCOV_OPT_USE_MALLOC else
+
+#ifdef GCOV_OPT_PRINT_STATUS
+    if (!gcov_deltaWords) {
+        GCOV_PRINT_STR("Delta area too small, sending everything"); GCOV_PRINT_STR("\n");
+    }
+#endif // GCOV_OPT_PRINT_STATUS
+
+    gcov_deltaGeneration++;
+    gcov_deltaHead = head;
+    gcov_dump.fingerprints = gcov_deltaWords;
+    gcov_dump.delta = gcov_deltaWords && gcov_deltaValid;
+
+    /* Until this dump is done, the words match neither this dump
+     * nor the last one */
+    gcov_deltaValid = 0;
+}
+
+/*
+ * __gcov_delta_reset makes the next dump send everything,
+ * such as when the host has lost track of the earlier dumps.
+ */
+void __gcov_delta_reset(void)
+{
+    gcov_deltaValid = 0;
+}
+#endif // GCOV_OPT_DELTA_DUMP
+
+/* Need buffer to be 32-bit-aligned for type-safe internal usage */
+static gcov_unsigned_t gcov_dumpBuf[GCOV_STREAM_WORDS];
+
+#if GCOV_COMPACT_ZERO_COUNTERS || GCOV_TOPN_LISTS || defined(GCOV_OPT_DELTA_DUMP)
+#define GCOV_CHOICES
+/* Choices the size of the file being dumped depends on, see gcov_choice() */
+static gcov_unsigned_t gcov_choiceArea[GCOV_CHOICE_WORDS];
+#endif
+
+#ifdef GCOV_OPT_TRANSFER_LZ
+/* LZ compression of the transfer data, see gcov_format.h */
+#define GCOV_LZ_MASK     (GCOV_LZ_WINDOW - 1)
+/* Longest match back, so the window still holds it under the lookahead */
+#define GCOV_LZ_MAX_OFFSET \
+    ((GCOV_LZ_WINDOW - GCOV_TRANSFER_LZ_MAX_MATCH) < GCOV_TRANSFER_LZ_MAX_OFFSET ? \
+     (GCOV_LZ_WINDOW - GCOV_TRANSFER_LZ_MAX_MATCH) : GCOV_TRANSFER_LZ_MAX_OFFSET)
+
+typedef struct tagGcovLz {
+    GcovEmit *emit;             /* where full buffers go */
+    u32 in;                     /* bytes of the file taken in */
+    u32 done;                   /* bytes of the file coded, up to in */
+    u32 used;                   /* bytes in out */
+    u32 flagPos;                /* index in out of the flag byte being filled */
+    u32 flagBit;                /* next bit of that flag byte, 0x100 when full */
+    unsigned char window[GCOV_LZ_WINDOW]; /* recent bytes, by position */
+    u16 head[GCOV_LZ_WINDOW];   /* latest position of each hash */
+    u16 prev[GCOV_LZ_WINDOW];   /* earlier position with the same hash */
+    /* compressed output is sent on when this is full, or at end of file */
+    unsigned char out[GCOV_STREAM_WORDS * sizeof(gcov_unsigned_t)];
+} GcovLz;
+static GcovLz gcov_lz;
+
+/*
+ * gcov_lz_hash hashes the 3 bytes at position pos.
+ */
+static u32 gcov_lz_hash(u32 pos)
+{
+    u32 v = ((u32)gcov_lz.window[pos & GCOV_LZ_MASK] << 16) |
+            ((u32)gcov_lz.window[(pos + 1) & GCOV_LZ_MASK] << 8) |
+            gcov_lz.window[(pos + 2) & GCOV_LZ_MASK];
+
+    return ((v * 2654435761UL) >> 16) & GCOV_LZ_MASK;
+}
+
+/*
+ * gcov_lz_insert enters position pos in the hash chains.
+ */
+static void gcov_lz_insert(u32 pos)
+{
+    u32 h;
+
+    if (pos + GCOV_TRANSFER_LZ_MIN_MATCH > gcov_lz.in) {
+        return;
+    }
+    h = gcov_lz_hash(pos);
+    gcov_lz.prev[pos & GCOV_LZ_MASK] = gcov_lz.head[h];
+    gcov_lz.head[h] = (u16)pos;
+}
+
+/*
+ * gcov_lz_flush sends the buffered compressed bytes to the sinks.
+ * Only called between flag byte groups, so no flag byte is sent
+ * before its bits are all known.
+ */
+static void gcov_lz_flush(void)
+{
+    if (gcov_lz.used) {
+        gcov_emit_data(gcov_lz.emit, gcov_lz.out, gcov_lz.used);
+        gcov_lz.used = 0;
+    }
+}
+
+/*
+ * gcov_lz_code codes the item at the current position:
+ * the longest match found in the hash chain, or a literal byte.
+ */
+static void gcov_lz_code(void)
+{
+    u32 avail = gcov_lz.in - gcov_lz.done;
+    u32 bestLength = 0;
+    u32 bestOffset = 0;
+
+    if (gcov_lz.flagBit == 0x100) {
+        /* Room for a flag byte and 8 matches, else flush first */
+        if (gcov_lz.used + 1 + 8 * 2 > sizeof(gcov_lz.out)) {
+            gcov_lz_flush();
+        }
+        gcov_lz.flagPos = gcov_lz.used++;
+        gcov_lz.out[gcov_lz.flagPos] = 0;
+        gcov_lz.flagBit = 1;
+    }
+
+    if (avail > GCOV_TRANSFER_LZ_MAX_MATCH) {
+        avail = GCOV_TRANSFER_LZ_MAX_MATCH;
+    }
+    if (avail >= GCOV_TRANSFER_LZ_MIN_MATCH) {
+        u32 cand = gcov_lz.head[gcov_lz_hash(gcov_lz.done)];
+        u32 lastOffset = 0;
+
+        for (u32 depth = 0; depth < GCOV_LZ_CHAIN; depth++) {
+            /* Positions are kept in 16 bits, the offset is what counts */
+            u32 offset = (u16)(gcov_lz.done - cand);
+            u32 length = 0;
+
+            /* Stop at stale entries (of earlier data or another file) */
+            if (offset <= lastOffset || offset > GCOV_LZ_MAX_OFFSET || offset > gcov_lz.done) {
+                break;
+            }
+            while (length < avail &&
+                   gcov_lz.window[(gcov_lz.done - offset + length) & GCOV_LZ_MASK] ==
+                   gcov_lz.window[(gcov_lz.done + length) & GCOV_LZ_MASK]) {
+                length++;
+            }
+            if (length > bestLength) {
+                bestLength = length;
+                bestOffset = offset;
+                if (length == avail) {
+                    break;
+                }
+            }
+            lastOffset = offset;
+            cand = gcov_lz.prev[cand & GCOV_LZ_MASK];
+        }
+    }
+
+    if (bestLength >= GCOV_TRANSFER_LZ_MIN_MATCH) {
+        u32 v = ((bestLength - GCOV_TRANSFER_LZ_MIN_MATCH) << 12) | (bestOffset - 1);
+
+        gcov_lz.out[gcov_lz.flagPos] |= (unsigned char)gcov_lz.flagBit;
+        gcov_lz.out[gcov_lz.used++] = (unsigned char)(v >> 8);
+        gcov_lz.out[gcov_lz.used++] = (unsigned char)v;
+    } else {
+        bestLength = 1;
+        gcov_lz.out[gcov_lz.used++] = gcov_lz.window[gcov_lz.done & GCOV_LZ_MASK];
+    }
+    gcov_lz.flagBit <<= 1;
+
+    while (bestLength--) {
+        gcov_lz_insert(gcov_lz.done++);
+    }
+}
+
+/*
+ * gcov_lz_begin starts the compressed data of a file.
+ * The hash chains are not cleared; entries from before are
+ * recognized by their offset, or just fail to match.
+ */
+static void gcov_lz_begin(GcovEmit *emit)
+{
+    gcov_lz.emit = emit;
+    gcov_lz.in = 0;
+    gcov_lz.done = 0;
+    gcov_lz.used = 0;
+    gcov_lz.flagBit = 0x100;
+}
+
+/*
+ * gcov_lz_raw adds bytes to the output as they are,
+ * before any compressed data (for the transfer header).
+ */
+static void gcov_lz_raw(const unsigned char *data, u32 length)
+{
+    for (u32 i = 0; i < length; i++) {
+        if (gcov_lz.used == sizeof(gcov_lz.out)) {
+            gcov_lz_flush();
+        }
+        gcov_lz.out[gcov_lz.used++] = data[i];
+    }
+}
+
+/*
+ * gcov_lz_write compresses bytes, coding each position once
+ * the longest possible match is in the window after it.
+ */
+static void gcov_lz_write(const void *data, u32 length)
+{
+    const unsigned char *p = data;
+
+    for (u32 i = 0; i < length; i++) {
+        gcov_lz.window[gcov_lz.in & GCOV_LZ_MASK] = p[i];
+        gcov_lz.in++;
+        if (gcov_lz.in - gcov_lz.done >= GCOV_TRANSFER_LZ_MAX_MATCH) {
+            gcov_lz_code();
+        }
+    }
+}
+
+/*
+ * gcov_lz_end codes the rest of the file and sends it on.
+ */
+static void gcov_lz_end(void)
+{
+    while (gcov_lz.done < gcov_lz.in) {
+        gcov_lz_code();
+    }
+    gcov_lz_flush();
+}
+#endif // GCOV_OPT_TRANSFER_LZ
+
+#ifdef GCOV_TRANSFER_HEADER
+/* Transfer encoding, see gcov_format.h */
+typedef struct tagGcovPack {
+    GcovEmit *emit;             /* where full buffers go */
+    u32 zeroRun;                /* zero words not yet emitted */
+    u32 recent[GCOV_TRANSFER_RECENT_WORDS]; /* recent words list */
+    u32 used;                   /* bytes in buffer */
+    /* packed output is sent on when this is full, or at end of file */
+    unsigned char buffer[GCOV_STREAM_WORDS * sizeof(gcov_unsigned_t)];
+} GcovPack;
+static GcovPack gcov_pack;
+
+/*
+ * gcov_pack_flush sends the buffered packed bytes on,
+ * to the compressor or else to the sinks.
+ */
+static void gcov_pack_flush(void)
+{
+    if (gcov_pack.used) {
+#ifdef GCOV_OPT_TRANSFER_LZ
+        gcov_lz_write(gcov_pack.buffer, gcov_pack.used);
+#else
+        gcov_emit_data(gcov_pack.emit, gcov_pack.buffer, gcov_pack.used);
+#endif // GCOV_OPT_TRANSFER_LZ else
+        gcov_pack.used = 0;
+    }
+}
+
+/*
+ * gcov_pack_token adds one token, (value << 2) | kind in LEB128,
+ * to the buffer. Worked in 32 bits, as value can be a full word.
+ */
+static void gcov_pack_token(u32 value, u32 kind)
+{
+    unsigned char *p;
+    unsigned char byte;
+
+    if (gcov_pack.used > sizeof(gcov_pack.buffer) - GCOV_TRANSFER_TOKEN_MAX) {
+        gcov_pack_flush();
+    }
+
+    p = gcov_pack.buffer + gcov_pack.used;
+    byte = (unsigned char)(((value & 0x1F) << GCOV_TRANSFER_KIND_BITS) | kind);
+
+    value >>= 5;
+    while (value) {
+        *p++ = byte | 0x80;
+        byte = (unsigned char)(value & 0x7F);
+        value >>= 7;
+    }
+    *p++ = byte;
+
+    gcov_pack.used = (u32)(p - gcov_pack.buffer);
+}
+
+#ifdef GCOV_OPT_TRANSFER_PACKED
+/*
+ * gcov_pack_word adds the token for one nonzero word.
+ */
+static void gcov_pack_word(u32 word)
+{
+    u32 i;
+
+    for (i = 0; i < GCOV_TRANSFER_RECENT_WORDS; i++) {
+        if (gcov_pack.recent[i] == word) {
+            gcov_pack_token(i, GCOV_TRANSFER_RECENT);
+            break;
+        }
+    }
+
+    if (i == GCOV_TRANSFER_RECENT_WORDS) {
+        if (word > 0x80000000UL) {
+            gcov_pack_token(0 - word, GCOV_TRANSFER_NEGATED);
+            return;
+        }
+        gcov_pack_token(word, GCOV_TRANSFER_WORD);
+        if (word < GCOV_TRANSFER_RECENT_MIN) {
+            return;
+        }
+        i = GCOV_TRANSFER_RECENT_WORDS - 1;
+    }
+
+    /* Move (or put) word first in the list */
+    for (; i > 0; i--) {
+        gcov_pack.recent[i] = gcov_pack.recent[i - 1];
+    }
+    gcov_pack.recent[0] = word;
+}
+
+/*
+ * gcov_pack_words packs gcda words, sending full buffers to the sinks.
+ * A zero run can go on into the next call, so it is kept
+ * from call to call along with the recent words list.
+ */
+static void gcov_pack_words(const gcov_unsigned_t *words, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (words[i] == 0) {
+            gcov_pack.zeroRun++;
+            continue;
+        }
+        if (gcov_pack.zeroRun) {
+            gcov_pack_token(gcov_pack.zeroRun - 1, GCOV_TRANSFER_ZEROS);
+            gcov_pack.zeroRun = 0;
+        }
+        gcov_pack_word(words[i]);
+    }
+}
+#endif // GCOV_OPT_TRANSFER_PACKED
+
+/*
+ * gcov_pack_begin starts the transfer data of a file,
+ * of bytesNeeded bytes as the cursor produces them.
+ * Without GCOV_TRANSFER_PACKED in flags, the header is sent
+ * right away, and the gcda data goes straight to the sinks
+ * (or to the compressor).
+ */
+static void gcov_pack_begin(GcovEmit *emit, u32 bytesNeeded, u32 flags,
+                            u32 generation, u32 base, u32 test)
+{
+    gcov_pack.emit = emit;
+    gcov_pack.buffer[0] = (unsigned char)(GCOV_TRANSFER_MAGIC >> 24);
+    gcov_pack.buffer[1] = (unsigned char)(GCOV_TRANSFER_MAGIC >> 16);
+    gcov_pack.buffer[2] = (unsigned char)(GCOV_TRANSFER_MAGIC >> 8);
+    gcov_pack.buffer[3] = (unsigned char)(GCOV_TRANSFER_MAGIC);
+    gcov_pack.used = 4;
+    gcov_pack.zeroRun = 0;
+    for (u32 i = 0; i < GCOV_TRANSFER_RECENT_WORDS; i++) {
+        gcov_pack.recent[i] = 0;
+    }
+
+    gcov_pack_token(flags, GCOV_TRANSFER_WORD);
+    if (flags & GCOV_TRANSFER_GENERATION) {
+        gcov_pack_token(generation, GCOV_TRANSFER_WORD);
+    }
+    if (flags & GCOV_TRANSFER_DELTA) {
+        gcov_pack_token(base, GCOV_TRANSFER_WORD);
+    }
+    if (flags & GCOV_TRANSFER_TEST) {
+        gcov_pack_token(test, GCOV_TRANSFER_WORD);
+    }
+    gcov_pack_token(bytesNeeded, GCOV_TRANSFER_WORD);
+
+#ifdef GCOV_OPT_TRANSFER_LZ
+    /* The header is not compressed */
+    gcov_lz_begin(emit);
+    gcov_lz_raw(gcov_pack.buffer, gcov_pack.used);
+    gcov_pack.used = 0;
+#else
+    if (!(flags & GCOV_TRANSFER_PACKED)) {
+        gcov_pack_flush();
+    }
+#endif // GCOV_OPT_TRANSFER_LZ else
+}
+
+/*
+ * gcov_pack_end finishes the transfer data of a file.
+ */
+static void gcov_pack_end(void)
+{
+    if (gcov_pack.zeroRun) {
+        gcov_pack_token(gcov_pack.zeroRun - 1, GCOV_TRANSFER_ZEROS);
+        gcov_pack.zeroRun = 0;
+    }
+    gcov_pack_flush();
+#ifdef GCOV_OPT_TRANSFER_LZ
+    gcov_lz_end();
+#endif // GCOV_OPT_TRANSFER_LZ
+}
+#endif // GCOV_TRANSFER_HEADER
+
+/*
+ * gcov_dump_start sets up a dump of the live counters of every file,
+ * in full, for __gcov_dump_step to move along.
+ */
+static void gcov_dump_start(void)
+{
+#ifdef GCOV_OPT_BACKGROUND_PTHREAD
+    /* A background dump is using gcov_dump, let it finish first
+     * (such as for the __gcov_exit of each file at process exit) */
+    if (!gcov_inDumpThread) {
+        __gcov_dump_wait();
+    }
+#endif // GCOV_OPT_BACKGROUND_PTHREAD
+
+    gcov_emit_open(&gcov_dump.emit);
+    gcov_dump.listptr = GCOV_LIST_FIRST();
+    gcov_dump.fileStarted = 0;
+    gcov_dump.active = 1;
+#ifdef GCOV_OPT_SNAPSHOT
+    gcov_dump.snapshot = NULL;
+#endif // GCOV_OPT_SNAPSHOT
+#ifdef GCOV_OPT_DELTA_DUMP
+    gcov_dump.fingerprints = NULL;
+    gcov_dump.delta = 0;
+#endif // GCOV_OPT_DELTA_DUMP
+#ifdef GCOV_OPT_TEST_CAPTURE
+    gcov_dump.test = 0;
+#endif // GCOV_OPT_TEST_CAPTURE
+#ifdef GCOV_OPT_PROVIDE_CLEAR_COUNTERS
+    gcov_dump.reset = 0;
+#endif // GCOV_OPT_PROVIDE_CLEAR_COUNTERS
+}
+
+/*
+ * __gcov_dump_begin starts a dump that your code then moves along
+ * with calls to __gcov_dump_step, such as from a low-rate task,
+ * so the system can keep running while coverage data is streamed out.
+ * Starting a new dump abandons any dump still in progress,
+ * except a background dump, which it waits for.
+ */
+void __gcov_dump_begin(void)
+{
+#ifdef GCOV_OPT_SNAPSHOT
+    int state = GCOV_SNAPSHOT_TAKEN;
+#endif // GCOV_OPT_SNAPSHOT
+
+#ifdef GCOV_OPT_PRINT_STATUS
+    GCOV_PRINT_STR("gcov_exit"); GCOV_PRINT_STR("\n");
+#endif // GCOV_OPT_PRINT_STATUS
+
+    gcov_dump_start();
+
+#ifdef GCOV_OPT_SNAPSHOT
+    if (__atomic_compare_exchange_n(&gcov_snapshotState, &state, GCOV_SNAPSHOT_DUMPING,
+                                    0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        gcov_dump.listptr = gcov_snapshotHead;
+        gcov_dump.snapshot = gcov_snapshotValues;
+    }
+#endif // GCOV_OPT_SNAPSHOT
+
+#ifdef GCOV_OPT_DELTA_DUMP
+    gcov_delta_begin(gcov_dump.listptr);
+#endif // GCOV_OPT_DELTA_DUMP
+}
+
+/*
+ * __gcov_dump_step emits about budget bytes of gcda data
+ * (always at least one record, so at least 20 bytes or so)
+ * and returns. Sink calls at the start and end of each file
+ * are not counted against the budget.
+ * Returns 1 if there is more to do, 0 once the dump is done.
+ */
+int __gcov_dump_step(gcov_unsigned_t budget)
+{
+    GcovEmit *emit = &gcov_dump.emit;
+    gcov_unsigned_t used = 0;
+
+    if (!gcov_dump.active) {
+        return 0;
+    }
+
+    while (GCOV_LIST_INFO(gcov_dump.listptr)) {
+        struct gcov_info *info = GCOV_LIST_INFO(gcov_dump.listptr);
+        const char *filename = gcov_info_filename(info);
+        size_t words;
+        size_t maxWords;
+
+        if (!gcov_dump.fileStarted) {
+            u32 bytesNeeded;
+
+#ifdef GCOV_OPT_TEST_CAPTURE
+            if (gcov_dump.test && !gcov_counters_touched(info)) {
+                /* The test ran no code in this file, leave it out */
+                gcov_dump.listptr = GCOV_LIST_NEXT(gcov_dump.listptr);
+                continue;
+            }
+#endif // GCOV_OPT_TEST_CAPTURE
+
+            gcov_gcda_start(&gcov_dump.cursor, info);
+#ifdef GCOV_CHOICES
+            gcov_dump.cursor.choices = gcov_choiceArea;
+            gcov_dump.cursor.choices_bits = GCOV_CHOICE_WORDS * 32;
+#endif // GCOV_CHOICES
+#ifdef GCOV_OPT_PROVIDE_CLEAR_COUNTERS
+            gcov_dump.cursor.reset = gcov_dump.reset;
+#endif // GCOV_OPT_PROVIDE_CLEAR_COUNTERS
+#ifdef GCOV_OPT_SNAPSHOT
+            gcov_dump.cursor.snapshot = gcov_dump.snapshot;
+#endif // GCOV_OPT_SNAPSHOT
+#ifdef GCOV_OPT_DELTA_DUMP
+            if (gcov_dump.fingerprints) {
+                /* (the first word is the file's generation) */
+                gcov_dump.cursor.fingerprints = gcov_dump.fingerprints + 1;
+                gcov_dump.cursor.delta = gcov_dump.delta;
+            }
+#endif // GCOV_OPT_DELTA_DUMP
+
+            /* Record lengths are known up front, no need to encode to find the size */
+            bytesNeeded = gcov_gcda_size(&gcov_dump.cursor);
+
+#ifdef GCOV_OPT_DELTA_DUMP
+            if (gcov_dump.delta &&
+                bytesNeeded == (GCOV_HEADER_WORDS + GCOV_SUMMARY_WORDS) * sizeof(gcov_unsigned_t)) {
+                /* Nothing changed in this file since it was sent, leave it out */
+#ifdef GCOV_OPT_SNAPSHOT
+                if (gcov_dump.snapshot) {
+                    gcov_dump.snapshot += gcov_counters_count(info);
+                }
+#endif // GCOV_OPT_SNAPSHOT
+                gcov_dump.fingerprints += 1 + gcov_fingerprints_count(info);
+                gcov_dump.listptr = GCOV_LIST_NEXT(gcov_dump.listptr);
+                continue;
+            }
+#endif // GCOV_OPT_DELTA_DUMP
+
+#if defined(GCOV_OPT_PRINT_STATUS) && !defined(GCOV_OPT_OUTPUT_SERIAL_HEXDUMP)
+            /* (the hexdump output prints this line itself) */
+            GCOV_PRINT_STR("Emitting ");
+            GCOV_PRINT_NUM(bytesNeeded);
+            GCOV_PRINT_STR(" bytes for ");
+            GCOV_PRINT_STR(filename);
+            GCOV_PRINT_STR("\n");
+#endif
+
+            for (u32 i=0; i<emit->count; i++) {
+                if (emit->sinks[i]->begin) {
+                    (void)emit->sinks[i]->begin(emit->sinks[i]->ctx, filename, bytesNeeded);
+                }
+            }
+
+#ifdef GCOV_TRANSFER_HEADER
+            {
+                u32 flags = 0;
+                u32 base = 0;
+                u32 test = 0;
+                u32 bytesSent = bytesNeeded;
+
+#ifdef GCOV_OPT_TRANSFER_PACKED
+                flags |= GCOV_TRANSFER_PACKED;
+#endif // GCOV_OPT_TRANSFER_PACKED
+#ifdef GCOV_OPT_TRANSFER_LZ
+                flags |= GCOV_TRANSFER_LZ;
+#endif // GCOV_OPT_TRANSFER_LZ
+#ifdef GCOV_OPT_TEST_CAPTURE
+                if (gcov_dump.test) {
+                    flags |= GCOV_TRANSFER_TEST;
+                    test = gcov_dump.testId;
+                }
+#endif // GCOV_OPT_TEST_CAPTURE
+#ifdef GCOV_OPT_TRANSFER_HITS
+                flags |= GCOV_TRANSFER_HITS;
+                gcov_dump.cursor.hits = 1;
+                bytesSent = gcov_gcda_size(&gcov_dump.cursor);
+#endif // GCOV_OPT_TRANSFER_HITS
+#ifdef GCOV_OPT_DELTA_DUMP
+                flags |= GCOV_TRANSFER_GENERATION;
+                if (gcov_dump.delta) {
+                    flags |= GCOV_TRANSFER_DELTA;
+                    base = gcov_dump.fingerprints[0];
+                }
+                if (gcov_dump.fingerprints) {
+                    gcov_dump.fingerprints[0] = gcov_deltaGeneration;
+                }
+                gcov_pack_begin(emit, bytesSent, flags, gcov_deltaGeneration, base, test);
+#else
+                gcov_pack_begin(emit, bytesSent, flags, 0, base, test);
+#endif // GCOV_OPT_DELTA_DUMP else
+            }
+#endif // GCOV_TRANSFER_HEADER
+            gcov_dump.fileStarted = 1;
+        }
+
+        if (used >= budget) {
+            return 1;
+        }
+
+        /* Convert no more than the rest of the budget */
+        maxWords = (budget - used) / sizeof(gcov_unsigned_t);
+        if (maxWords > GCOV_STREAM_WORDS) {
+            maxWords = GCOV_STREAM_WORDS;
+        }
+        if (maxWords < GCOV_CURSOR_MIN_WORDS) {
+            maxWords = GCOV_CURSOR_MIN_WORDS;
+        }
+
+        words = gcov_gcda_fill(&gcov_dump.cursor, gcov_dumpBuf, maxWords);
+        if (words) {
+#if defined(GCOV_OPT_TRANSFER_PACKED)
+            gcov_pack_words(gcov_dumpBuf, words);
+#elif defined(GCOV_OPT_TRANSFER_LZ)
+            gcov_lz_write(gcov_dumpBuf, words * sizeof(gcov_unsigned_t));
+#else
+            gcov_emit_data(emit, gcov_dumpBuf, words * sizeof(gcov_unsigned_t));
+#endif
+            used += words * sizeof(gcov_unsigned_t);
+            continue;
+        }
+
+        /* This file is done */
+#ifdef GCOV_TRANSFER_HEADER
+        gcov_pack_end();
+#endif // GCOV_TRANSFER_HEADER
+        for (u32 i=0; i<emit->count; i++) {
+            if (emit->sinks[i]->end) {
+                (void)emit->sinks[i]->end(emit->sinks[i]->ctx, filename);
+            }
+        }
+#ifdef GCOV_OPT_SNAPSHOT
+        gcov_dump.snapshot = gcov_dump.cursor.snapshot;
+#endif // GCOV_OPT_SNAPSHOT
+#ifdef GCOV_OPT_DELTA_DUMP
+        if (gcov_dump.fingerprints) {
+            gcov_dump.fingerprints += 1 + gcov_fingerprints_count(info);
+        }
+#endif // GCOV_OPT_DELTA_DUMP
+        gcov_dump.listptr = GCOV_LIST_NEXT(gcov_dump.listptr);
+        gcov_dump.fileStarted = 0;
+    } /* end while listptr */
+
+    /* Add end marker to output */
+    for (u32 i=0; i<emit->count; i++) {
+        if (emit->sinks[i]->close) {
+            (void)emit->sinks[i]->close(emit->sinks[i]->ctx);
+        }
+    }
+
+#if defined(GCOV_OPT_PRINT_STATUS) && !defined(GCOV_OPT_OUTPUT_SERIAL_HEXDUMP)
+    /* (the hexdump output prints this line itself) */
+    GCOV_PRINT_STR("Gcov End");
+    GCOV_PRINT_STR("\n");
+#endif
+
+#ifdef GCOV_OPT_SNAPSHOT
+    if (__atomic_load_n(&gcov_snapshotState, __ATOMIC_RELAXED) == GCOV_SNAPSHOT_DUMPING) {
+#ifdef GCOV_OPT_USE_MALLOC
+        free(gcov_snapshotValues);
+#endif // GCOV_OPT_USE_MALLOC
+        gcov_snapshotValues = NULL;
+        __atomic_store_n(&gcov_snapshotState, GCOV_SNAPSHOT_FREE, __ATOMIC_RELEASE);
+    }
+#endif // GCOV_OPT_SNAPSHOT
+
+#ifdef GCOV_OPT_DELTA_DUMP
+    /* (a dump without fingerprints, such as a test dump, leaves them be) */
+    if (gcov_dump.fingerprints) {
+        gcov_deltaValid = 1;
+    }
+#endif // GCOV_OPT_DELTA_DUMP
+
+    gcov_dump.active = 0;
+    return 0;
+}
+
+/*
+ * __gcov_dump_done returns 1 when no dump is in progress.
+ */
+int __gcov_dump_done(void)
+{
+    return !gcov_dump.active;
+}
+
+
+#ifdef GCOV_OPT_BACKGROUND_PTHREAD
+/* ----------------------------------------------------------- */
+/*
+ * Reference background dump for threaded hosts such as Linux.
+ * The caller only pays for the snapshot copy, the new thread
+ * does the encoding and output, a step at a time.
+ */
+static void *gcov_dump_thread(void *arg)
+{
+    (void)arg; // ignore unused param
+
+    gcov_inDumpThread = 1;
+    __gcov_dump_begin();
+    while (__gcov_dump_step(GCOV_BACKGROUND_STEP)) {
+        sched_yield();
+    }
+    return NULL;
+}
+
+/*
+ * __gcov_dump_background takes a snapshot and starts a thread to dump it.
+ * Returns 0 on success, -1 if the snapshot or the thread failed
+ * (including when the previous background dump is still running).
+ * Until the thread is done, other dumps (__gcov_exit and the like)
+ * wait for it; do not call __gcov_dump_step yourself meanwhile.
+ */
+int __gcov_dump_background(void)
+{
+    int state = GCOV_BACKGROUND_IDLE;
+
+    if (!__atomic_compare_exchange_n(&gcov_backgroundState, &state, GCOV_BACKGROUND_STARTING,
+                                     0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return -1;
+    }
+    if (__gcov_snapshot() != 0 ||
+        pthread_create(&gcov_dumpThread, NULL, gcov_dump_thread, NULL) != 0) {
+        __atomic_store_n(&gcov_backgroundState, GCOV_BACKGROUND_IDLE, __ATOMIC_RELEASE);
+        return -1;
+    }
+    __atomic_store_n(&gcov_backgroundState, GCOV_BACKGROUND_RUNNING, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/*
+ * __gcov_dump_wait waits for the background dump, if any, to finish.
+ * Any number of threads may wait, one of them joins the thread.
+ */
+void __gcov_dump_wait(void)
+{
+    int state;
+
+    while ((state = __atomic_load_n(&gcov_backgroundState, __ATOMIC_ACQUIRE)) != GCOV_BACKGROUND_IDLE) {
+        if (state == GCOV_BACKGROUND_RUNNING &&
+            __atomic_compare_exchange_n(&gcov_backgroundState, &state, GCOV_BACKGROUND_JOINING,
+                                        0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            (void)pthread_join(gcov_dumpThread, NULL);
+            __atomic_store_n(&gcov_backgroundState, GCOV_BACKGROUND_IDLE, __ATOMIC_RELEASE);
+            return;
+        }
+        /* being started, or joined by someone else */
+        sched_yield();
+    }
+}
+#endif // GCOV_OPT_BACKGROUND_PTHREAD
+
+
+/* ----------------------------------------------------------- */
+/*
+ * __gcov_exit needs to be called in your code at the point
+ * where you want to generate coverage data for extraction.
+ * It does the whole dump before returning.
+ */
+void __gcov_exit(void)
+{
+    __gcov_dump_begin();
+    while (__gcov_dump_step(0xFFFFFFFF)) {
+        ;
+    }
+}
+
+#ifdef GCOV_OPT_TEST_CAPTURE
+/* ----------------------------------------------------------- */
+static gcov_unsigned_t gcov_testId;
+static int gcov_testOpen = 0;
+
+/*
+ * __gcov_test_begin marks the start of test id. It clears the
+ * counters, so __gcov_test_end finds only what the test ran.
+ */
+void __gcov_test_begin(gcov_unsigned_t id)
+{
+    GcovList listptr;
+
+#ifdef GCOV_OPT_PRINT_STATUS
+    GCOV_PRINT_STR("gcov_test_begin ");
+    GCOV_PRINT_NUM(id);
+    GCOV_PRINT_STR("\n");
+#endif // GCOV_OPT_PRINT_STATUS
+
+    for (listptr = GCOV_LIST_FIRST(); GCOV_LIST_INFO(listptr); listptr = GCOV_LIST_NEXT(listptr)) {
+        gcov_clear_counters(GCOV_LIST_INFO(listptr));
+    }
+    gcov_testId = id;
+    gcov_testOpen = 1;
+}
+
+/*
+ * __gcov_test_end marks the end of test id, and dumps the files
+ * the test ran code in, tagged with id, before returning.
+ * Files whose counters are all zero are left out.
+ * Starting the dump abandons any dump still in progress.
+ * Returns 0, or -1 (and dumps nothing) if test id was not begun.
+ */
+int __gcov_test_end(gcov_unsigned_t id)
+{
+#ifdef GCOV_OPT_PRINT_STATUS
+    GCOV_PRINT_STR("gcov_test_end ");
+    GCOV_PRINT_NUM(id);
+    GCOV_PRINT_STR("\n");
+#endif // GCOV_OPT_PRINT_STATUS
+
+    if (!gcov_testOpen || id != gcov_testId) {
+#ifdef GCOV_OPT_PRINT_STATUS
+        GCOV_PRINT_STR("No such test begun!"); GCOV_PRINT_STR("\n");
+#endif // GCOV_OPT_PRINT_STATUS
+        return -1;
+    }
+    gcov_testOpen = 0;
+
+    gcov_dump_start();
+    gcov_dump.test = 1;
+    gcov_dump.testId = id;
+    while (__gcov_dump_step(0xFFFFFFFF)) {
+        ;
+    }
+    return 0;
+}
+#endif // GCOV_OPT_TEST_CAPTURE
+
+/* ----------------------------------------------------------- */
+#if defined(GCOV_OPT_PROVIDE_CLEAR_COUNTERS) || defined(GCOV_OPT_PROVIDE_SUMMARY)
+/*
+ * gcov_name_matches tells whether filename is name,
+ * or ends in '/' followed by name.
+ */
+static int gcov_name_matches(const char *filename, const char *name)
+{
+    const char *f = filename;
+    const char *n = name;
+
+    while (*f) {
+        f++;
+    }
+    while (*n) {
+        n++;
+    }
+    while (n > name) {
+        if (f == filename || *--f != *--n) {
+            return 0;
+        }
+    }
+    return f == filename || f[-1] == '/';
+}
+#endif // GCOV_OPT_PROVIDE_CLEAR_COUNTERS || GCOV_OPT_PROVIDE_SUMMARY
+
+/* ----------------------------------------------------------- */
+#ifdef GCOV_OPT_PROVIDE_CLEAR_COUNTERS
+/*
+ * __gcov_clear is optional to call if you want to clear the counters,
+ * such as after program startup (if you don't want to count the startup)
+ * or between test runs.
+ * The counters are automatically zero at startup.
+ */
+void __gcov_clear(void)
+{
+    GcovList listptr = GCOV_LIST_FIRST();
+
+#ifdef GCOV_OPT_PRINT_STATUS
+    GCOV_PRINT_STR("gcov_clear"); GCOV_PRINT_STR("\n");
+#endif // GCOV_OPT_PRINT_STATUS
+
+    while (GCOV_LIST_INFO(listptr)) {
+
+        gcov_clear_counters(GCOV_LIST_INFO(listptr));
+
+        listptr = GCOV_LIST_NEXT(listptr);
+    }
+}
+
+/*
+ * __gcov_clear_file clears the counters of the files whose
+ * .gcda filename is name, or ends in '/' followed by name
+ * (such as "motor_ctl.gcda"), so only the subsystem under test
+ * starts again from zero.
+ * Returns the number of files cleared.
+ */
+int __gcov_clear_file(const char *name)
+{
+    GcovList listptr;
+    int cleared = 0;
+
+    for (listptr = GCOV_LIST_FIRST(); GCOV_LIST_INFO(listptr); listptr = GCOV_LIST_NEXT(listptr)) {
+        struct gcov_info *info = GCOV_LIST_INFO(listptr);
+
+        if (gcov_name_matches(gcov_info_filename(info), name)) {
+            gcov_clear_counters(info);
+            cleared++;
+        }
+    }
+
+#ifdef GCOV_OPT_PRINT_STATUS
+    GCOV_PRINT_STR("gcov_clear_file ");
+    GCOV_PRINT_STR(name);
+    GCOV_PRINT_STR(": ");
+    GCOV_PRINT_NUM(cleared);
+    GCOV_PRINT_STR("\n");
+#endif // GCOV_OPT_PRINT_STATUS
+
+    return cleared;
+}
+
+/*
+ * __gcov_dump_reset dumps the live counters of every file, like
+ * __gcov_exit, and zeroes each counter as soon as it has been read,
+ * so no count is lost between the dump and a clear after it.
+ * Each dump then holds the counts since the one before, so keep
+ * them apart on the host and add them up (scripts/gcda_merge_runs.sh).
+ * Starting the dump abandons any dump still in progress.
+ */
+void __gcov_dump_reset(void)
+{
+#ifdef GCOV_OPT_PRINT_STATUS
+    GCOV_PRINT_STR("gcov_dump_reset"); GCOV_PRINT_STR("\n");
+#endif // GCOV_OPT_PRINT_STATUS
+
+    gcov_dump_start();
+    gcov_dump.reset = 1;
+    while (__gcov_dump_step(0xFFFFFFFF)) {
+        ;
+    }
+
+#ifdef GCOV_OPT_DELTA_DUMP
+    /* The host's files now hold what was read, not what is left,
+     * so the next dump must send everything */
+    __gcov_delta_reset();
+#endif // GCOV_OPT_DELTA_DUMP
+}
+#endif // GCOV_OPT_PROVIDE_CLEAR_COUNTERS
+
+#ifdef GCOV_OPT_PROVIDE_SUMMARY
+/* ----------------------------------------------------------- */
+/*
+ * gcov_summary_num prints num in decimal. GCOV_PRINT_NUM takes an int,
+ * so counts and idents of 2^31 and up would print as negative numbers.
+ */
+static void gcov_summary_num(u32 num)
+{
+    char digits[11]; /* 4294967295 and a terminator */
+    u32 n = sizeof(digits) - 1;
+
+    digits[n] = '\0';
+    do {
+        digits[--n] = (char)('0' + num % 10);
+        num /= 10;
+    } while (num);
+    GCOV_PRINT_STR(&digits[n]);
+}
+
+/*
+ * gcov_summary_line prints hit/total, the percentage, and label.
+ */
+static void gcov_summary_line(const char *indent, u32 hit, u32 total, const char *label)
+{
+    u32 percent = 0;
+
+    if (total) {
+        /* (no 64-bit division, and no overflow) */
+        percent = total > 0xFFFFFFFFUL / 100 ? hit / (total / 100) : hit * 100 / total;
+    }
+    GCOV_PRINT_STR(indent);
+    gcov_summary_num(hit);
+    GCOV_PRINT_STR("/");
+    gcov_summary_num(total);
+    GCOV_PRINT_STR(" ");
+    gcov_summary_num(percent);
+    GCOV_PRINT_STR("% ");
+    GCOV_PRINT_STR(label);
+}
+
+/*
+ * __gcov_summary prints, without a dump, how many arc counters
+ * of each file are nonzero, out of how many, and the percentage:
+ * one line per file, then one for all of them. With name not NULL,
+ * only the files whose .gcda filename is name, or ends in '/'
+ * followed by name, are summarized, each with a line per function
+ * (by ident). Reads the live counters, and can be called at any time.
+ * The table is text, for the console, rather than a binary record
+ * per file: it is read by the operator during the test, with no
+ * host tool, and a line per file is still only a few dozen bytes.
+ * Returns the number of files summarized.
+ */
+int __gcov_summary(const char *name)
+{
+    GcovList listptr;
+    u32 allHit = 0;
+    u32 allTotal = 0;
+    int files = 0;
+
+    GCOV_PRINT_STR("gcov_summary"); GCOV_PRINT_STR("\n");
+
+    for (listptr = GCOV_LIST_FIRST(); GCOV_LIST_INFO(listptr); listptr = GCOV_LIST_NEXT(listptr)) {
+        struct gcov_info *info = GCOV_LIST_INFO(listptr);
+        size_t functions = gcov_functions_count(info);
+        u32 fileHit = 0;
+        u32 fileTotal = 0;
+        size_t fn;
+
+        if (name && !gcov_name_matches(gcov_info_filename(info), name)) {
+            continue;
+        }
+        for (fn = 0; fn < functions; fn++) {
+            gcov_unsigned_t ident;
+            unsigned int hit;
+            unsigned int total = gcov_fn_arcs(info, fn, &ident, &hit);
+
+            fileHit += hit;
+            fileTotal += total;
+        }
+        gcov_summary_line("", fileHit, fileTotal, gcov_info_filename(info));
+        GCOV_PRINT_STR("\n");
+
+        if (name) {
+            for (fn = 0; fn < functions; fn++) {
+                gcov_unsigned_t ident;
+                unsigned int hit;
+                unsigned int total = gcov_fn_arcs(info, fn, &ident, &hit);
+
+                if (total) {
+                    gcov_summary_line("  ", hit, total, "fn ");
+                    gcov_summary_num(ident);
+                    GCOV_PRINT_STR("\n");
+                }
+            }
+        }
+        allHit += fileHit;
+        allTotal += fileTotal;
+        files++;
+    }
+
+    gcov_summary_line("", allHit, allTotal, "in ");
+    GCOV_PRINT_NUM(files);
+    GCOV_PRINT_STR(" files");
+    GCOV_PRINT_STR("\n");
+
+    return files;
+}
+#endif // GCOV_OPT_PROVIDE_SUMMARY
+
+#ifdef GCOV_OPT_PERSIST
+/* ----------------------------------------------------------- */
+/*
+ * Persistent region layout, in target byte order:
+ *   GcovPersistHeader
+ *   for each file: GcovPersistFile, then its counter values
+ * The magic word is written last, so an image only half saved
+ * when the target reset is not used.
+ */
+#define GCOV_PERSIST_MAGIC 0x67637072UL /* "gcpr" */
+
+typedef struct tagGcovPersistHeader {
+    u32 magic;      /* GCOV_PERSIST_MAGIC once the image is complete */
+    u32 files;      /* number of files that follow */
+    u32 bytes;      /* of the whole image */
+    u32 spare;      /* keeps what follows 8-byte aligned */
+} GcovPersistHeader;
+
+typedef struct tagGcovPersistFile {
+    u32 stamp;      /* time stamp of the file's build */
+    u32 signature;  /* see gcov_info_signature */
+    u32 values;     /* counter values that follow */
+    u32 spare;      /* keeps the values 8-byte aligned */
+} GcovPersistFile;
+
+/* Where __gcov_merge_add reads, during __gcov_persist_load */
+static const gcov_type *gcov_mergeValues = NULL;
+static int gcov_persistLoaded = 0;
+
+/*
+ * gcov_persist_region returns the persistent region, or NULL.
+ */
+static unsigned char *gcov_persist_region(void)
+{
+#ifdef GCOV_OPT_PERSIST_MMAP
+    static unsigned char *region = NULL;
+
+    if (!region) {
+        int fd = open(GCOV_PERSIST_FILENAME, O_RDWR | O_CREAT, 0666);
+        void *map;
+
+        if (fd < 0) {
+            return NULL;
+        }
+        /* (a new file reads as zeros, so holds no image) */
+        if (ftruncate(fd, GCOV_PERSIST_SIZE) != 0) {
+            close(fd);
+            return NULL;
+        }
+        map = mmap(NULL, GCOV_PERSIST_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) {
+            return NULL;
+        }
+        region = map;
+    }
+    return region;
+#else
+    return gcov_persistRegion;
+#endif // GCOV_OPT_PERSIST_MMAP else
+}
+
+/*
+ * __gcov_persist_load adds the counters saved in the persistent
+ * region into the live counters. Call it once at startup,
+ * after the constructors and before the counters are cleared
+ * or saved. Saved counters of a file built differently
+ * since they were saved are left out.
+ * Returns the number of files restored, or -1 if there
+ * is no saved image (or it was loaded already).
+ */
+int __gcov_persist_load(void)
+{
+    unsigned char *region = gcov_persist_region();
+    const GcovPersistHeader *header = (const GcovPersistHeader *)region;
+    GcovList listptr;
+    int restored = 0;
+    int stale = 0;
+
+    if (gcov_persistLoaded || !header || header->magic != GCOV_PERSIST_MAGIC ||
+        header->bytes > GCOV_PERSIST_SIZE) {
+#ifdef GCOV_OPT_PRINT_STATUS
+        GCOV_PRINT_STR("No saved counters"); GCOV_PRINT_STR("\n");
+#endif // GCOV_OPT_PRINT_STATUS
+        return -1;
+    }
+    gcov_persistLoaded = 1;
+
+    for (listptr = GCOV_LIST_FIRST(); GCOV_LIST_INFO(listptr); listptr = GCOV_LIST_NEXT(listptr)) {
+        struct gcov_info *info = GCOV_LIST_INFO(listptr);
+        u32 stamp = gcov_info_stamp(info);
+        u32 signature = gcov_info_signature(info);
+        size_t count = gcov_counters_count(info);
+        size_t pos = sizeof(GcovPersistHeader);
+        int found = 0;
+
+        for (u32 i = 0; i < header->files && !found; i++) {
+            const GcovPersistFile *file = (const GcovPersistFile *)(region + pos);
+
+            if (pos + sizeof(GcovPersistFile) > header->bytes ||
+                file->values > (header->bytes - pos - sizeof(GcovPersistFile)) / sizeof(gcov_type)) {
+                break; /* damaged image */
+            }
+            if (file->stamp == stamp && file->signature == signature && file->values == count) {
+                gcov_mergeValues = (const gcov_type *)(file + 1);
+                (void)gcov_merge_counters(info);
+                gcov_mergeValues = NULL;
+                found = 1;
+            }
+            pos += sizeof(GcovPersistFile) + file->values * sizeof(gcov_type);
+        }
+        if (found) {
+            restored++;
+        } else {
+            stale++;
+        }
+    }
+
+#ifdef GCOV_OPT_PRINT_STATUS
+    GCOV_PRINT_STR("Restored saved counters of ");
+    GCOV_PRINT_NUM(restored);
+    GCOV_PRINT_STR(" files, none saved for ");
+    GCOV_PRINT_NUM(stale);
+    GCOV_PRINT_STR("\n");
+#else
+    (void)stale; // ignore unused variable
+#endif // GCOV_OPT_PRINT_STATUS
+
+    return restored;
+}
+
+/*
+ * __gcov_persist_save copies the live counters of every file into
+ * the persistent region, replacing what was saved before.
+ * (After __gcov_persist_load, the live counters include that.)
+ * Returns 0 on success, -1 if the region is too small or missing,
+ * in which case the region is left as it was.
+ */
+int __gcov_persist_save(void)
+{
+    unsigned char *region = gcov_persist_region();
+    GcovPersistHeader *header = (GcovPersistHeader *)region;
+    GcovList listptr;
+    size_t total = sizeof(GcovPersistHeader);
+    u32 files = 0;
+
+    for (listptr = GCOV_LIST_FIRST(); GCOV_LIST_INFO(listptr); listptr = GCOV_LIST_NEXT(listptr)) {
+        total += sizeof(GcovPersistFile) +
+                 gcov_counters_count(GCOV_LIST_INFO(listptr)) * sizeof(gcov_type);
+        files++;
+    }
+
+    if (!header || total > GCOV_PERSIST_SIZE) {
+#ifdef GCOV_OPT_PRINT_STATUS
+        GCOV_PRINT_STR("Persistent region too small!"); GCOV_PRINT_STR("\n");
+#endif // GCOV_OPT_PRINT_STATUS
+        return -1;
+    }
+
+    /* Not a valid image until the magic word is back */
+    __atomic_store_n(&header->magic, 0, __ATOMIC_RELEASE);
+
+    total = sizeof(GcovPersistHeader);
+    for (listptr = GCOV_LIST_FIRST(); GCOV_LIST_INFO(listptr); listptr = GCOV_LIST_NEXT(listptr)) {
+        struct gcov_info *info = GCOV_LIST_INFO(listptr);
+        GcovPersistFile *file = (GcovPersistFile *)(region + total);
+
+        file->stamp = gcov_info_stamp(info);
+        file->signature = gcov_info_signature(info);
+        file->spare = 0;
+        file->values = (u32)gcov_snapshot_counters(info, (gcov_type *)(file + 1));
+        total += sizeof(GcovPersistFile) + file->values * sizeof(gcov_type);
+    }
+
+    header->files = files;
+    header->bytes = (u32)total;
+    header->spare = 0;
+    __atomic_store_n(&header->magic, GCOV_PERSIST_MAGIC, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/*
+ * __gcov_persist_erase throws away the saved image,
+ * such as at the start of a new test campaign.
+ */
+void __gcov_persist_erase(void)
+{
+    GcovPersistHeader *header = (GcovPersistHeader *)gcov_persist_region();
+
+    if (header) {
+        __atomic_store_n(&header->magic, 0, __ATOMIC_RELEASE);
+    }
+}
+#endif // GCOV_OPT_PERSIST
+
+/* ----------------------------------------------------------- */
+/*
+ * gcov_merge_unexpected warns that gcc internals (or someone)
+ * called a merge function other than to add saved counters.
+ */
+static void gcov_merge_unexpected(const char *name)
+{
+#ifdef GCOV_OPT_PRINT_STATUS
+    GCOV_PRINT_STR(name);
+    GCOV_PRINT_STR(" isn't called, right? Right? RIGHT?");
+#else
+    (void)name; // ignore unused param
+#endif // GCOV_OPT_PRINT_STATUS
+
+#ifdef GCOV_OPT_USE_STDLIB
+    fflush(stdout);
+    exit(1);
+#endif // GCOV_OPT_USE_STDLIB
+}
+
+/*
+ * gcc puts this in the gcov data as the merge function of the
+ * arc counters. Only __gcov_persist_load calls it, to add
+ * the saved counters; otherwise merging is not supported,
+ * and this warns if someone (including gcc internals) tries to use it.
+ */
+void __gcov_merge_add(gcov_type *counters, gcov_unsigned_t n_counters)
+{
+#ifdef GCOV_OPT_PERSIST
+    if (gcov_mergeValues) {
+        for (gcov_unsigned_t i = 0; i < n_counters; i++) {
+            counters[i] += gcov_mergeValues[i];
+        }
+        gcov_mergeValues += n_counters;
+        return;
+    }
+#endif // GCOV_OPT_PERSIST
+
+    (void)counters; // ignore unused param
+    (void)n_counters; // ignore unused param
+
+    gcov_merge_unexpected("__gcov_merge_add");
+}
+
+#ifdef GCOV_OPT_PROFILE_VALUES
+/*
+ * The merge functions of the other counter kinds of code compiled
+ * with -fprofile-generate, used the same way as __gcov_merge_add.
+ * __gcov_merge_topn, for the top N value and indirect call profiles,
+ * skips the saved values: their pairs were in the memory of an
+ * earlier boot.
+ */
+void __gcov_merge_topn(gcov_type *counters, gcov_unsigned_t n_counters)
+{
+#ifdef GCOV_OPT_PERSIST
+    if (gcov_mergeValues) {
+        gcov_mergeValues += n_counters;
+        return;
+    }
+#endif // GCOV_OPT_PERSIST
+
+    (void)counters; // ignore unused param
+    (void)n_counters; // ignore unused param
+
+    gcov_merge_unexpected("__gcov_merge_topn");
+}
+
+/* Counters of bits ever set, as from -fprofile-generate's ior profiler */
+void __gcov_merge_ior(gcov_type *counters, gcov_unsigned_t n_counters)
+{
+#ifdef GCOV_OPT_PERSIST
+    if (gcov_mergeValues) {
+        for (gcov_unsigned_t i = 0; i < n_counters; i++) {
+            counters[i] |= gcov_mergeValues[i];
+        }
+        gcov_mergeValues += n_counters;
+        return;
+    }
+#endif // GCOV_OPT_PERSIST
+
+    (void)counters; // ignore unused param
+    (void)n_counters; // ignore unused param
+
+    gcov_merge_unexpected("__gcov_merge_ior");
+}
+
+/* Order of each function's first call: the earliest one is kept, 0 is never */
+void __gcov_merge_time_profile(gcov_type *counters, gcov_unsigned_t n_counters)
+{
+#ifdef GCOV_OPT_PERSIST
+    if (gcov_mergeValues) {
+        for (gcov_unsigned_t i = 0; i < n_counters; i++) {
+            gcov_type value = gcov_mergeValues[i];
+
+            if (value && (!counters[i] || value < counters[i])) {
+                counters[i] = value;
+            }
+        }
+        gcov_mergeValues += n_counters;
+        return;
+    }
+#endif // GCOV_OPT_PERSIST
+
+    (void)counters; // ignore unused param
+    (void)n_counters; // ignore unused param
+
+    gcov_merge_unexpected("__gcov_merge_time_profile");
 }
+#endif // GCOV_OPT_PROFILE_VALUES
 
 /** @}
  */
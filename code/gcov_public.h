@@ -60,6 +60,15 @@
  */
 //#define GCOV_OPT_RESET_WATCHDOG
 
+/* Make __gcov_init safe to call from several threads or cores at once,
+ * such as constructors of dynamically loaded modules on SMP targets.
+ * Each call links its file into the list with an atomic
+ * compare-and-swap, so no lock is taken and interrupts stay enabled.
+ * Uses the gcc __atomic builtins (gcc 4.7 or later); your target
+ * needs compare-and-swap support for pointers.
+ */
+//#define GCOV_OPT_ATOMIC_REGISTRATION
+
 /* Provide function to call constructor list (even in plain C)
  * (to call the gcc-generated code that calls __gcov_init).
  * Might be needed if you are not running a standard
@@ -87,6 +96,38 @@ extern void *__ctor_list;
 extern void *__ctor_end;
 #endif // GCOV_OPT_PROVIDE_CALL_CONSTRUCTORS
 
+/* Find the gcov data through the section that gcc 12 and later
+ * fill with pointers to it when you compile with
+ * -fprofile-info-section, instead of through constructors
+ * calling __gcov_init at startup.
+ * Nothing runs at boot, no constructors or .ctors linker code
+ * are needed, and the section is read in place at dump time.
+ * If defined, requires your custom linker file code as described below.
+ */
+//#define GCOV_OPT_INFO_SECTION
+
+#ifdef GCOV_OPT_INFO_SECTION
+/* start and end of gcov info section defined in link file */
+/* you have to provide appropriate linker file code to define these.
+ * An example linker file segment, for the default section name
+ * of -fprofile-info-section:
+
+.gcov_info : {
+        PROVIDE (__gcov_info_start = .);
+        KEEP (*(.gcov_info))
+        PROVIDE (__gcov_info_end = .);
+} > ram
+
+ * With gnu ld on a hosted system, you can instead compile with
+ * -fprofile-info-section=gcov_info and link with
+ * -Wl,--defsym=__gcov_info_start=__start_gcov_info
+ * -Wl,--defsym=__gcov_info_end=__stop_gcov_info
+ */
+struct gcov_info;
+extern const struct gcov_info *const __gcov_info_start[];
+extern const struct gcov_info *const __gcov_info_end[];
+#endif // GCOV_OPT_INFO_SECTION
+
 /* Provide function to clear the counter data.
  * This is only needed if you want to be able to clear
  * the counter data after startup (the counters start up at zero).
@@ -94,9 +135,61 @@ extern void *__ctor_end;
  * or if you want to clear the counters between tests.
  * You might NOT want this if you are extremely memory constrained
  * (such as in PROM) and do not need this function to take up some bytes.
+ * Also provides __gcov_clear_file, to clear only the files of the
+ * subsystem under test, and __gcov_dump_reset, which dumps and clears
+ * in one pass, zeroing each counter as soon as it has been read,
+ * so counts made while the dump goes on are kept for the next one.
  */
 #define GCOV_OPT_PROVIDE_CLEAR_COUNTERS
 
+/* Provide function __gcov_summary to print, on the console, how many
+ * arc counters of each file are nonzero, out of how many, without
+ * a dump: a quick "how much of module X ran" during a test.
+ * Given a .gcda name such as "motor_ctl.gcda", it prints a line for
+ * each function of that file as well, by function ident
+ * (gcov-dump -l on the .gcno file gives the name of each ident).
+ * This is arc coverage, not the line coverage gcov reports.
+ * The output is text, "hit/total percent% name" a line, rather than
+ * a compact binary record per file, so that it can be read on the
+ * console as it is, with no host tool to decode it.
+ * If defined, you must also provide defs below
+ * for GCOV_PRINT_STR and GCOV_PRINT_NUM.
+ */
+//#define GCOV_OPT_PROVIDE_SUMMARY
+
+/* Provide what code compiled with -fprofile-generate calls besides
+ * __gcov_init: the value profilers (in gcov_gcc.c) and the merge
+ * functions of the other counter kinds, in place of libgcov. Then the
+ * .gcda files from the target can go back to gcc with -fprofile-use,
+ * for branch layout, inlining and value-based optimizations tuned
+ * on the real hardware. Needs gcc 11 or later.
+ * Top N value and indirect call profiles are written out as libgcov
+ * writes them, even with GCOV_OPT_TRANSFER_HITS. Their
+ * (value, count) pairs are always read live, even with
+ * GCOV_OPT_SNAPSHOT, and GCOV_OPT_PERSIST does not keep them.
+ * Each file also gets the object summary (runs and largest arc count),
+ * 16 bytes that coverage dumps leave out.
+ * Not needed for coverage alone (-fprofile-arcs -ftest-coverage).
+ */
+//#define GCOV_OPT_PROFILE_VALUES
+
+/* Number of (value, count) pairs for all the top N value and indirect
+ * call profiles together, at 24 bytes each (on a 64-bit target),
+ * up to 32 for each profiled division, switch, or indirect call.
+ * Pairs are never given back, even by __gcov_clear; once all are
+ * taken, values not seen before are no longer tracked.
+ * Not used if you do not define GCOV_OPT_PROFILE_VALUES
+ */
+#define GCOV_TOPN_NODES 1024
+
+/* How gcc declares __gcov_indirect_call, which the instrumented code
+ * sets before each indirect call: __thread where gcc uses thread-local
+ * storage for it (as on Linux), empty where the target has none.
+ * A mismatch shows as a link error about TLS.
+ * Not used if you do not define GCOV_OPT_PROFILE_VALUES
+ */
+#define GCOV_INDIRECT_CALL_TLS __thread
+
 /* Provide small imitation printf function.
  * This is only needed if you want serial port outputs and
  * do not have already-existing functions to do the printing.
@@ -106,6 +199,175 @@ extern void *__ctor_end;
  */
 #define GCOV_OPT_PROVIDE_PRINTF_IMITATION
 
+/* Size of the staging buffer used while encoding gcda data,
+ * in 32-bit words (so 64 is 256 bytes).
+ * The encoder walks each file's coverage data once and hands
+ * the output this many words at a time, so this is the only
+ * data buffer needed, no matter how large the source files
+ * compiled for coverage are.
+ * Larger values mean fewer and bigger writes to your output.
+ */
+#define GCOV_STREAM_WORDS 64
+
+/* Room, in 32-bit words, to remember the choices the size of a file
+ * depends on while it is dumped from live counters: for gcc 12 and
+ * later, a bit for each counter array, whether it is all zero,
+ * with GCOV_OPT_DELTA_DUMP, a bit for each function, whether it changed,
+ * and with GCOV_OPT_PROFILE_VALUES, 6 bits for each top N value profile,
+ * its number of pairs.
+ * The size is sent before the data, and the counters can change in
+ * between; the data goes by these choices, so it keeps to that size.
+ * Past this room, the rest of a file is written as if its counters
+ * were not zero and every function had changed, and top N value
+ * profiles are written without their pairs.
+ * Not used when dumping from a snapshot.
+ */
+#define GCOV_CHOICE_WORDS 64
+
+/* Pack the gcda data of each file before output, as runs of
+ * zero words and variable-length numbers (see gcov_format.h).
+ * Sparse coverage data shrinks several times over, so dumps
+ * take much less time on a slow output.
+ * Uses another buffer of GCOV_STREAM_WORDS words.
+ * The output needs tools/gcov_decode to expand it into .gcda files
+ * (scripts/gcov_convert.sh and gcov_convert_framed.sh do that).
+ */
+//#define GCOV_OPT_TRANSFER_PACKED
+
+/* Compress the data of each file before output (LZSS, see
+ * gcov_format.h), after packing if GCOV_OPT_TRANSFER_PACKED is
+ * also defined. The gcda data repeats a lot: record tags, lengths,
+ * checksums and counter patterns from function to function.
+ * Static buffers only, about 5 times GCOV_LZ_WINDOW bytes,
+ * plus one more of GCOV_STREAM_WORDS words.
+ * The output needs tools/gcov_decode to expand it into .gcda files
+ * (scripts/gcov_convert.sh and gcov_convert_framed.sh do that).
+ */
+//#define GCOV_OPT_TRANSFER_LZ
+
+/* Bytes of earlier data a match can refer to, a power of 2
+ * from 256 to 4096. More RAM finds more matches.
+ * Not used if you do not define GCOV_OPT_TRANSFER_LZ.
+ */
+#define GCOV_LZ_WINDOW 1024
+
+/* Earlier places with the same 3 bytes to try, per match.
+ * More takes longer, and finds longer matches.
+ * Not used if you do not define GCOV_OPT_TRANSFER_LZ.
+ */
+#define GCOV_LZ_CHAIN 8
+
+/* Send only whether each counter is nonzero, one bit per counter
+ * instead of 64 (see gcov_format.h), for campaigns that only need
+ * to know which arcs ran, not how many times. Counter data shrinks
+ * about 64 times, before any packing or compression.
+ * tools/gcov_decode writes .gcda files with counts of 0 or 1.
+ * Whether each counted arc ran is kept exactly, but gcov works
+ * out the counts of the other arcs from these, so a line reached
+ * only through arcs gcc does not count can show as not run
+ * (never the other way). Leave this out if you need exact line
+ * coverage, execution counts, or profile feedback.
+ * The output needs tools/gcov_decode to expand it into .gcda files
+ * (scripts/gcov_convert.sh and gcov_convert_framed.sh do that).
+ */
+//#define GCOV_OPT_TRANSFER_HITS
+
+/* Send only the functions whose counters changed since the last dump.
+ * A fingerprint of each function's counters is kept from dump to dump
+ * (one 32-bit word per function, plus one per file), and a function,
+ * or a whole file, whose fingerprint is unchanged is left out.
+ * Each file's data is tagged with the dump generation number,
+ * and tools/gcov_decode applies the deltas in order to the .gcda
+ * files it wrote before, so use the framed output (or other output
+ * through gcov_decode) for this.
+ * The first dump after startup, after new files are registered,
+ * or after __gcov_delta_reset, sends everything.
+ * Needs RAM for the fingerprints, see GCOV_DELTA_WORDS.
+ */
+//#define GCOV_OPT_DELTA_DUMP
+
+/* Room for this many fingerprint words (4 bytes each), enough
+ * for all instrumented functions, plus one word for each file.
+ * If there is not enough room, every dump sends everything.
+ * Not used if you do not define GCOV_OPT_DELTA_DUMP,
+ * or if you define GCOV_OPT_USE_MALLOC.
+ */
+#define GCOV_DELTA_WORDS 4096
+
+/* Provide functions __gcov_test_begin and __gcov_test_end to capture
+ * the coverage of each test on its own, instead of __gcov_exit and
+ * __gcov_clear around every test. __gcov_test_begin clears the
+ * counters; __gcov_test_end dumps only the files whose counters
+ * are not all zero (the files the test ran code in), each tagged
+ * with the test id (see gcov_format.h).
+ * tools/gcov_decode writes the files of each test into a directory
+ * of their own, so use the framed output (or other output through
+ * gcov_decode) for this, and tools/gcov_matrix turns them into
+ * a matrix of which tests ran which functions.
+ * Test dumps always send the live counters in full, even with
+ * GCOV_OPT_SNAPSHOT or GCOV_OPT_DELTA_DUMP.
+ */
+//#define GCOV_OPT_TEST_CAPTURE
+
+/* Provide functions to keep the counters in a persistent region
+ * (battery-backed RAM, or a reserved NVRAM block) across resets.
+ * __gcov_persist_save copies the counters there, such as
+ * before a planned reset or from a periodic task;
+ * __gcov_persist_load, called once at startup after the
+ * constructors, adds the saved counters into the live ones.
+ * So the counts add up over a whole test campaign, and one dump
+ * at the end replaces a dump before every reset.
+ * Saved counters are only used for a file built exactly the
+ * same way (same stamp, checksums and counters), so a stale
+ * image from an older build is left out.
+ * Set the region address in gcov_public.c.
+ */
+//#define GCOV_OPT_PERSIST
+
+/* Size in bytes of the persistent region: 16 bytes, plus for each
+ * file 16 bytes and 8 bytes per counter.
+ * Not used if you do not define GCOV_OPT_PERSIST.
+ */
+#define GCOV_PERSIST_SIZE 65536
+
+/* Emulate the persistent region on Linux, with a file-backed mmap
+ * of this file, so the counters outlive the process.
+ * Not used if you do not define GCOV_OPT_PERSIST.
+ */
+//#define GCOV_OPT_PERSIST_MMAP
+#define GCOV_PERSIST_FILENAME "gcov_persist.bin"
+
+/* Provide function __gcov_snapshot to copy the counter data
+ * for the next dump to use, instead of the live counters.
+ * The copy is a quick block copy of each counter array, so
+ * the code that takes the snapshot pays only for the copy,
+ * and a low-priority task can do the slower encoding and output
+ * later, with __gcov_dump_begin and __gcov_dump_step.
+ * Needs RAM for a copy of all counters, see GCOV_SNAPSHOT_COUNTERS.
+ * Uses the gcc __atomic builtins, so the snapshot can be taken
+ * and dumped from different tasks.
+ */
+//#define GCOV_OPT_SNAPSHOT
+
+/* Room for this many counters (8 bytes each) in the snapshot area.
+ * Not used if you do not define GCOV_OPT_SNAPSHOT,
+ * or if you define GCOV_OPT_USE_MALLOC.
+ */
+#define GCOV_SNAPSHOT_COUNTERS 8192
+
+/* Provide function __gcov_dump_background, which takes a snapshot
+ * and dumps it from a new POSIX thread, and __gcov_dump_wait.
+ * This is a reference for threaded hosts such as Linux;
+ * on an RTOS, do the same from a low-priority task of your own.
+ * Requires GCOV_OPT_SNAPSHOT, and linking with -pthread.
+ */
+//#define GCOV_OPT_BACKGROUND_PTHREAD
+
+/* Bytes of data per __gcov_dump_step in the background thread.
+ * Not used if you do not define GCOV_OPT_BACKGROUND_PTHREAD.
+ */
+#define GCOV_BACKGROUND_STEP 1024
+
 /* select data output method(s) ------------------------------------ */
 
 /* Other output methods might be imagined,
@@ -124,20 +386,35 @@ extern void *__ctor_end;
 /* Not used if you do not define GCOV_OPT_OUTPUT_BINARY_FILE */
 #define GCOV_OUTPUT_BINARY_FILENAME "gcov_output.bin"
 
+/* Size in bytes of the staging buffer for the binary file output.
+ * Output is collected here and written to the file
+ * one buffer-full at a time.
+ * Not used if you do not define GCOV_OPT_OUTPUT_BINARY_FILE
+ */
+#define GCOV_FILE_BUFFER_SIZE 4096
+
 /* Modify file headers, data type and functions, if needed */
 /* Not used if you do not define GCOV_OPT_OUTPUT_BINARY_FILE */
+/* The file is truncated when opened, so nothing is left over
+ * from an earlier, longer output.
+ * GCOV_WRITE_BLOCK returns the number of bytes written; the rest is
+ * written again. GCOV_WRITE_AGAIN says whether a write that wrote
+ * nothing should be tried again, such as one interrupted by a signal.
+ */
 #ifdef GCOV_OPT_OUTPUT_BINARY_FILE
 #if 1
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <errno.h>
 
 typedef int GCOV_FILE_TYPE;
-#define GCOV_OPEN_FILE(filename) open((filename), (O_CREAT|O_WRONLY), (S_IRWXU|S_IRWXG|S_IRWXO))
+#define GCOV_OPEN_FILE(filename) open((filename), (O_CREAT|O_WRONLY|O_TRUNC), (S_IRWXU|S_IRWXG|S_IRWXO))
 #define GCOV_OPEN_ERROR(fileref) ((fileref) < 0)
 #define GCOV_CLOSE_FILE(fileref) close((fileref))
-#define GCOV_WRITE_BYTE(fileref, char_var) write((fileref), &(char_var), (1))
+#define GCOV_WRITE_BLOCK(fileref, buf, len) write((fileref), (buf), (len))
+#define GCOV_WRITE_AGAIN(fileref) (errno == EINTR)
 #else
 #include <stdio.h>
 
@@ -145,7 +422,8 @@ typedef FILE * GCOV_FILE_TYPE;
 #define GCOV_OPEN_FILE(filename) fopen((filename), ("wb"))
 #define GCOV_OPEN_ERROR(fileref) ((fileref) == NULL)
 #define GCOV_CLOSE_FILE(fileref) fclose((fileref))
-#define GCOV_WRITE_BYTE(fileref, char_var) fprintf((fileref), "%c", (char_var))
+#define GCOV_WRITE_BLOCK(fileref, buf, len) fwrite((buf), 1, (len), (fileref))
+#define GCOV_WRITE_AGAIN(fileref) (0)
 #endif
 #endif // GCOV_OPT_OUTPUT_BINARY_FILE
 
@@ -166,9 +444,37 @@ typedef FILE * GCOV_FILE_TYPE;
  */
 #define GCOV_OPT_OUTPUT_SERIAL_HEXDUMP
 
+/* Output gcda data as binary frames on serial port.
+ * Each frame is COBS encoded, with a sequence number and CRC-32,
+ * see gcov_format.h. This sends about 1.1 bytes per data byte,
+ * instead of about 3.4 for the hexdump, and the host can tell
+ * when bytes were lost or damaged.
+ * The serial port must pass all 8-bit values unchanged.
+ * On the host, tools/gcov_decode turns the serial log into
+ * .gcda files, see scripts/gcov_convert_framed.sh.
+ * If defined, you must also provide the def below
+ * for GCOV_WRITE_SERIAL_BYTES.
+ * Can be combined with other GCOV_OPT_OUTPUT_* options.
+ */
+//#define GCOV_OPT_OUTPUT_SERIAL_FRAMED
+
+/* Largest gcda data payload per frame, in bytes.
+ * Smaller frames lose less data to one damaged byte,
+ * larger frames have less overhead (9 bytes per frame).
+ * Not used if you do not define GCOV_OPT_OUTPUT_SERIAL_FRAMED
+ */
+#define GCOV_FRAME_DATA_SIZE 128
+
+/* Function to write raw bytes (buf, len) to the serial port.
+ * Not used if you do not define GCOV_OPT_OUTPUT_SERIAL_FRAMED
+ * If you do, you need to set this as appropriate for your system.
+ */
+//#define GCOV_WRITE_SERIAL_BYTES(buf, len) fwrite((buf), 1, (len), stdout)
+#define GCOV_WRITE_SERIAL_BYTES(buf, len) gcov_print_bytes((const char *)(buf), (len))
+
 /* Function to print a string without newline.
- * Not used if you don't define either GCOV_OPT_PRINT_STATUS
- * or GCOV_OPT_OUTPUT_SERIAL_HEXDUMP.
+ * Not used if you don't define GCOV_OPT_PRINT_STATUS,
+ * GCOV_OPT_OUTPUT_SERIAL_HEXDUMP or GCOV_OPT_PROVIDE_SUMMARY.
  * If you do, you need to set this as appropriate for your system.
  * You might need to add header files to gcc_public.c
  */
@@ -178,8 +484,8 @@ typedef FILE * GCOV_FILE_TYPE;
 //#define GCOV_PRINT_STR(str) puts((str))
 
 /* Function to print a number without newline.
- * Not used if you don't define either GCOV_OPT_PRINT_STATUS
- * or GCOV_OPT_OUTPUT_SERIAL_HEXDUMP.
+ * Not used if you don't define GCOV_OPT_PRINT_STATUS,
+ * GCOV_OPT_OUTPUT_SERIAL_HEXDUMP or GCOV_OPT_PROVIDE_SUMMARY.
  * If you do, you need to set this as appropriate for your system.
  * You might need to add header files to gcc_public.c
  */
@@ -187,21 +493,22 @@ typedef FILE * GCOV_FILE_TYPE;
 #define GCOV_PRINT_NUM(num) gcov_printf("%d", (num))
 //#define GCOV_PRINT_NUM(num) print_num((num))
 
-/* Function to print hexdump address.
+/* Function to print one hexdump line, already formatted
+ * (a string of len chars, not null terminated).
+ * The line is built with a lookup table, so no printf
+ * formatting is done per byte.
  * Not used if you don't define GCOV_OPT_OUTPUT_SERIAL_HEXDUMP.
  * If you do, you need to set this as appropriate for your system.
  * You might need to add header files to gcc_public.c
  */
-//#define GCOV_PRINT_HEXDUMP_ADDR(num) printf("%08x: ", (num))
-#define GCOV_PRINT_HEXDUMP_ADDR(num) gcov_printf("%08x: ", (num))
+//#define GCOV_PRINT_HEXDUMP_LINE(str, len) fwrite((str), 1, (len), stdout)
+#define GCOV_PRINT_HEXDUMP_LINE(str, len) gcov_print_bytes((str), (len))
 
-/* Function to print hexdump data value.
- * Not used if you don't define GCOV_OPT_OUTPUT_SERIAL_HEXDUMP.
- * If you do, you need to set this as appropriate for your system.
- * You might need to add header files to gcc_public.c
+/* Maximum number of output sinks your code can register
+ * with __gcov_register_sink, in addition to the built-in
+ * GCOV_OPT_OUTPUT_* methods above.
  */
-//#define GCOV_PRINT_HEXDUMP_DATA(num) printf("%02x ", (num))
-#define GCOV_PRINT_HEXDUMP_DATA(num) gcov_printf("%02x ", (num))
+#define GCOV_MAX_SINKS 4
 
 /* End of user settings ---------------------------------- */
 
@@ -219,10 +526,68 @@ typedef long long gcov_type;
 void __gcov_init(struct gcov_info *info);
 void __gcov_exit(void);
 void __gcov_merge_add(gcov_type *counters, gcov_unsigned_t n_counters);
+#ifdef GCOV_OPT_PROFILE_VALUES
+void __gcov_merge_topn(gcov_type *counters, gcov_unsigned_t n_counters);
+void __gcov_merge_ior(gcov_type *counters, gcov_unsigned_t n_counters);
+void __gcov_merge_time_profile(gcov_type *counters, gcov_unsigned_t n_counters);
+#endif
 
 /* Our own creations */
+
+/* Output sink for gcov data, to plug in your own transport
+ * (flash, telemetry packets, DMA UART, ...) without
+ * changing gcov_public.c.
+ * Each dump calls open once, then for each file begin,
+ * write as many times as needed with blocks of gcda data,
+ * and end, and finally close once.
+ * Any callback except write may be NULL.
+ * Callbacks return 0 on success. If open fails,
+ * the sink is left out of that dump.
+ * ctx is passed back unchanged to every callback.
+ */
+typedef struct gcov_sink {
+    int (*open)(void *ctx);
+    int (*begin)(void *ctx, const char *filename, gcov_unsigned_t length);
+    int (*write)(void *ctx, const void *data, gcov_unsigned_t length);
+    int (*end)(void *ctx, const char *filename);
+    int (*close)(void *ctx);
+    void *ctx;
+} gcov_sink;
+
+int __gcov_register_sink(const gcov_sink *sink);
+void __gcov_unregister_sink(const gcov_sink *sink);
+
+/* Dump in steps, instead of all at once with __gcov_exit */
+void __gcov_dump_begin(void);
+int __gcov_dump_step(gcov_unsigned_t budget);
+int __gcov_dump_done(void);
+#ifdef GCOV_OPT_SNAPSHOT
+int __gcov_snapshot(void);
+#endif
+#ifdef GCOV_OPT_DELTA_DUMP
+void __gcov_delta_reset(void);
+#endif
+#ifdef GCOV_OPT_TEST_CAPTURE
+void __gcov_test_begin(gcov_unsigned_t id);
+int __gcov_test_end(gcov_unsigned_t id);
+#endif
+#ifdef GCOV_OPT_PROVIDE_SUMMARY
+int __gcov_summary(const char *name);
+#endif
+#ifdef GCOV_OPT_PERSIST
+int __gcov_persist_load(void);
+int __gcov_persist_save(void);
+void __gcov_persist_erase(void);
+#endif
+#ifdef GCOV_OPT_BACKGROUND_PTHREAD
+int __gcov_dump_background(void);
+void __gcov_dump_wait(void);
+#endif
+
 #ifdef GCOV_OPT_PROVIDE_CLEAR_COUNTERS
 void __gcov_clear(void);
+int __gcov_clear_file(const char *name);
+void __gcov_dump_reset(void);
 #endif
 #ifdef GCOV_OPT_PROVIDE_CALL_CONSTRUCTORS
 void __gcov_call_constructors(void);
@@ -230,6 +595,7 @@ void __gcov_call_constructors(void);
 
 #ifdef GCOV_OPT_PROVIDE_PRINTF_IMITATION
 void gcov_printf(const char *fmt, ...);
+void gcov_print_bytes(const char *buf, unsigned int len);
 #endif
 
 #endif // __GCOV_PUBLIC_H__
@@ -0,0 +1,94 @@
+/* Times one __gcov_exit to a file, and counts its write() calls,
+ * for make bench_file: once with GCOV_OPT_OUTPUT_BINARY_FILE,
+ * once without it, through a sink that writes a byte at a time,
+ * as the binary file output did before it had a staging buffer.
+ * Linked with -Wl,--wrap=write so the calls land here.
+ */
+#include <stdio.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "gcov_public.h"
+#include "gcov_format.h"
+
+static long writeCalls;
+
+ssize_t __real_write (int fd, const void *buf, size_t count);
+
+ssize_t
+__wrap_write (int fd, const void *buf, size_t count)
+{
+  writeCalls++;
+  return __real_write (fd, buf, count);
+}
+
+#ifndef GCOV_OPT_OUTPUT_BINARY_FILE
+static int byteFile;
+
+static int
+byte_open (void *ctx)
+{
+  (void) ctx;
+  byteFile = open ("gcov_output.bin", O_CREAT | O_WRONLY | O_TRUNC, 0666);
+  return byteFile < 0 ? -1 : 0;
+}
+
+static int
+byte_write (void *ctx, const void *data, gcov_unsigned_t length)
+{
+  const unsigned char *p = data;
+
+  (void) ctx;
+  while (length--)
+    if (write (byteFile, p++, 1) != 1)
+      return -1;
+  return 0;
+}
+
+static int
+byte_begin (void *ctx, const char *filename, gcov_unsigned_t length)
+{
+  unsigned char count[4] = { length >> 24, length >> 16, length >> 8, length };
+  gcov_unsigned_t n = 0;
+
+  while (filename[n])
+    n++;
+  byte_write (ctx, filename, n + 1);
+  return byte_write (ctx, count, sizeof (count));
+}
+
+static int
+byte_close (void *ctx)
+{
+  static const char endMarker[] = GCOV_BINARY_END_MARKER;
+
+  byte_write (ctx, endMarker, sizeof (endMarker));
+  return close (byteFile);
+}
+
+static const gcov_sink byteSink = {
+  byte_open, byte_begin, byte_write, NULL, byte_close, NULL
+};
+#endif
+
+int
+main (void)
+{
+  struct timespec start, end;
+
+#ifndef GCOV_OPT_OUTPUT_BINARY_FILE
+  __gcov_register_sink (&byteSink);
+#endif
+
+  // the generated files hold the code, all that is left is the dump
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  __gcov_exit ();
+  clock_gettime (CLOCK_MONOTONIC, &end);
+
+  printf ("%ld write calls, %.3f ms\n", writeCalls,
+          (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6);
+  fflush (stdout);
+
+  // skip the __gcov_exit of each file's destructor
+  _exit (0);
+}
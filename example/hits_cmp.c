@@ -0,0 +1,98 @@
+/* For make check_hits: compares a .gcda file decoded from a hit
+ * bitmap dump with the same file from a plain dump. Everything
+ * must be the same but the counters, which must be 1 where the
+ * plain count is nonzero and 0 where it is zero (the value
+ * profiles gcov_decode leaves alone aside).
+ *
+ * Typical usage: ./hits_cmp plain/test.gcda hits/test.gcda
+ */
+#include <stdio.h>
+#include "gcda_io.h"
+
+static size_t counted;          // counters sent as hits
+static size_t overOne;          // of those, counts above 1 sent as 1
+
+static int
+hits_sent (const GcdaInfo *info, unsigned long tag)
+{
+  // as gcov_decode's expand_hits: not the top N and indirect call profiles
+  unsigned long type = GCDA_COUNTER_FOR_TAG (tag);
+
+  return info->major < 11 || (type != 3 && type != 4);
+}
+
+static int
+hits_compare (const GcdaInfo *plain, const GcdaInfo *hits)
+{
+  size_t fn;
+  size_t c;
+  size_t v;
+
+  if (plain->version != hits->version || plain->stamp != hits->stamp
+      || plain->checksum != hits->checksum || plain->hasSummary != hits->hasSummary
+      || plain->functionCount != hits->functionCount)
+    return -1;
+  for (fn = 0; fn < plain->functionCount; fn++)
+    {
+      const GcdaFunction *pf = &plain->functions[fn];
+      const GcdaFunction *hf = &hits->functions[fn];
+
+      if (pf->empty != hf->empty || pf->ident != hf->ident
+          || pf->linenoChecksum != hf->linenoChecksum || pf->cfgChecksum != hf->cfgChecksum
+          || pf->counterCount != hf->counterCount)
+        return -1;
+      for (c = 0; c < pf->counterCount; c++)
+        {
+          const GcdaCounters *pc = &pf->counters[c];
+          const GcdaCounters *hc = &hf->counters[c];
+          int sent = hits_sent (plain, pc->tag);
+
+          if (pc->tag != hc->tag || pc->count != hc->count)
+            return -1;
+          for (v = 0; v < pc->count; v++)
+            {
+              long long expected = sent ? pc->values[v] != 0 : pc->values[v];
+
+              if (hc->values[v] != expected)
+                return -1;
+              counted += sent;
+              overOne += sent && pc->values[v] > 1;
+            }
+        }
+    }
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  GcdaInfo plain;
+  GcdaInfo hits;
+  const char *why;
+  int result;
+
+  if (argc != 3)
+    {
+      fprintf (stderr, "usage: hits_cmp plain.gcda hits.gcda\n");
+      return 2;
+    }
+  if (gcda_read (argv[1], &plain, &why) != 0)
+    {
+      fprintf (stderr, "hits_cmp: %s: %s\n", argv[1], why);
+      return 2;
+    }
+  if (gcda_read (argv[2], &hits, &why) != 0)
+    {
+      fprintf (stderr, "hits_cmp: %s: %s\n", argv[2], why);
+      gcda_free (&plain);
+      return 2;
+    }
+  result = hits_compare (&plain, &hits);
+  if (result != 0)
+    fprintf (stderr, "hits_cmp: %s is not the hits of %s\n", argv[2], argv[1]);
+  else
+    printf ("%s: %zu counters, %zu counts above 1 sent as 1\n", argv[2], counted, overOne);
+  gcda_free (&plain);
+  gcda_free (&hits);
+  return result ? 1 : 0;
+}
@@ -0,0 +1,103 @@
+# For make check_lcov: prints the line, branch and function counts of
+# either gcov's text output (.gcov files from gcov -l -b -c) or an lcov
+# tracefile (.info), one per line, added up over all the files given
+# for each source file, as lcov adds them up. Sorted, the two must
+# match. This is how lcov's geninfo reads gcov's output, so lcov is
+# not needed to check tools/gcov_lcov.
+#
+# Typical usage: awk -f lcov_records.awk *.gcov | sort
+
+function basename(path)
+{
+	sub(/.*\//, "", path)
+	return path
+}
+
+function count(text)
+{
+	sub(/\*$/, "", text)
+	if (text == "#####" || text == "=====" || text == "-")
+		return 0
+	return text + 0
+}
+
+FNR == 1 {
+	file = ""
+	section = 0
+	separator = 0
+}
+
+# lcov tracefile
+FILENAME ~ /\.info$/ {
+	if (sub(/^SF:/, "")) {
+		file = basename($0)
+	} else if (sub(/^DA:/, "")) {
+		split($0, f, ",")
+		da[file " DA:" f[1]] += f[2]
+	} else if (sub(/^FNDA:/, "")) {
+		split($0, f, ",")
+		fnda[file " FNDA:" f[2]] += f[1]
+	} else if (sub(/^BRDA:/, "")) {
+		split($0, f, ",")
+		if (f[1] != branchLine) {
+			branchLine = f[1]
+			branchIdx = 0
+		}
+		brda[file " BRDA:" f[1] "," branchIdx++] += count(f[4])
+	} else if ($0 == "end_of_record") {
+		branchLine = ""
+	}
+	next
+}
+
+# gcov text: "count:line:source", with a section of the same lines
+# for each instance of a template, between lines of dashes
+/^-+$/ {
+	separator = 1
+	next
+}
+
+{
+	colon = index($0, ":")
+	head = substr($0, 1, colon - 1)
+	gsub(/ /, "", head)
+	rest = substr($0, colon + 1)
+	isLine = (head ~ /^([-#=]+|[0-9]+\*?)$/ && rest ~ /^ *[0-9]+:/)
+	if (separator) {
+		section = !isLine
+		separator = 0
+	}
+}
+
+/^ *-: *0:Source:/ {
+	file = basename(substr($0, index($0, "Source:") + 7))
+	next
+}
+
+/^function / {
+	fnda[file " FNDA:" $2] += $4
+	next
+}
+
+/^branch / {
+	brda[file " BRDA:" line "," branchIdx++] += ($3 == "taken") ? $4 : 0
+	next
+}
+
+isLine {
+	line = rest
+	sub(/:.*/, "", line)
+	line += 0
+	branchIdx = 0
+	if (!section && head != "-")
+		da[file " DA:" line] += count(head)
+}
+
+END {
+	for (k in da)
+		print k "," da[k]
+	for (k in fnda)
+		print k "," fnda[k]
+	for (k in brda)
+		print k "," brda[k]
+}
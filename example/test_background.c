@@ -0,0 +1,115 @@
+/* For make check_background: runs a workload while
+ * __gcov_dump_background is dumping, then returns from main
+ * with the dump still going, so the __gcov_exit of the
+ * destructors has to wait for it.
+ * A slow sink of its own makes the dump take a while,
+ * and checks each file gets the byte count it was announced.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "gcov_public.h"
+
+#define WORKLOAD_RUNS 1000
+
+static int dumps;               // sink opens
+static int filesSent;           // written in full, in the latest dump
+static int dumpDone;            // closes, read by the workload
+static gcov_unsigned_t announced;
+static gcov_unsigned_t received;
+
+static int
+slow_open (void *ctx)
+{
+  (void) ctx;
+  dumps++;
+  filesSent = 0;
+  return 0;
+}
+
+static int
+slow_begin (void *ctx, const char *filename, gcov_unsigned_t length)
+{
+  (void) ctx;
+  (void) filename;
+  announced = length;
+  received = 0;
+  return 0;
+}
+
+static int
+slow_write (void *ctx, const void *data, gcov_unsigned_t length)
+{
+  (void) ctx;
+  (void) data;
+  received += length;
+  usleep (20000);
+  return 0;
+}
+
+static int
+slow_end (void *ctx, const char *filename)
+{
+  (void) ctx;
+  if (received != announced)
+    {
+      printf ("%s: %u bytes announced, %u sent\n", filename, announced, received);
+      abort ();
+    }
+  filesSent++;
+  return 0;
+}
+
+static int
+slow_close (void *ctx)
+{
+  (void) ctx;
+  printf ("dump %d: %d files\n", dumps, filesSent);
+  fflush (stdout);
+  __atomic_add_fetch (&dumpDone, 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+static const gcov_sink slowSink = {
+  slow_open, slow_begin, slow_write, slow_end, slow_close, NULL
+};
+
+static int
+workload (int i)
+{
+  if (i % 3 == 0)
+    return i / 3;
+  return i + 1;
+}
+
+int
+main (void)
+{
+  int sum = 0;
+  int i;
+
+  for (i = 0; i < WORKLOAD_RUNS; i++)
+    sum += workload (i);
+
+  __gcov_register_sink (&slowSink);
+  if (__gcov_dump_background () != 0)
+    {
+      printf ("background dump did not start\n");
+      return 1;
+    }
+
+  // the counters keep moving while the snapshot is dumped
+  for (i = 0; i < WORKLOAD_RUNS; i++)
+    sum += workload (i);
+  if (__atomic_load_n (&dumpDone, __ATOMIC_ACQUIRE))
+    {
+      printf ("dump finished before the workload, nothing overlapped\n");
+      return 1;
+    }
+
+  printf ("workload ran %d times, sum %d\n", 2 * WORKLOAD_RUNS, sum);
+  fflush (stdout);
+
+  // the __gcov_exit at process exit waits for the background dump
+  return 0;
+}
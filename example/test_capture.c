@@ -0,0 +1,60 @@
+/* For make check_capture: runs tests 1 to 3, each over functions
+ * of its own and one they share, between __gcov_test_begin and
+ * __gcov_test_end, so that tools/gcov_matrix finds which test ran
+ * which function (see test_capture.csv).
+ */
+#include <stdio.h>
+#include "gcov_public.h"
+
+static int
+shared (int x)
+{
+  return x + 1;
+}
+
+static int
+first (int x)
+{
+  return x * 2;
+}
+
+static int
+second (int x)
+{
+  return shared (x) * 3;
+}
+
+static int
+third (int x)
+{
+  return shared (x) - 4;
+}
+
+static int
+unused (int x)
+{
+  return x - 1;
+}
+
+int
+main (int argc, char **argv)
+{
+  int sum = 0;
+
+  (void) argv;
+  __gcov_test_begin (1);
+  sum += first (argc);
+  __gcov_test_end (1);
+
+  __gcov_test_begin (2);
+  sum += second (argc);
+  __gcov_test_end (2);
+
+  __gcov_test_begin (3);
+  sum += third (argc);
+  __gcov_test_end (3);
+
+  if (argc > 5)
+    sum += unused (argc);
+  return sum == 0;
+}
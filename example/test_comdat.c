@@ -0,0 +1,151 @@
+/* For make check_comdat: registers a gcov_info object whose
+ * functions are a selected one, a comdat copy selected in another
+ * object file (its key is the other file's gcov_info), and a NULL
+ * entry, as libgcov may find them. Dumps it to a sink of its own,
+ * checks that only the selected function gets its counters, that
+ * the file keeps to its announced size, and that __gcov_clear
+ * leaves the other file's counters alone, then prints what the
+ * skipped copies would have cost.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "gcov_gcc.h"
+
+#define ARCS 16
+
+/* Laid out as the gcov_info gcc generates (see gcov_gcc.c) */
+struct synth_info;
+
+struct synth_ctr
+{
+  gcov_unsigned_t num;
+  gcov_type *values;
+};
+
+struct synth_fn
+{
+  const struct synth_info *key;
+  gcov_unsigned_t ident;
+  gcov_unsigned_t lineno_checksum;
+  gcov_unsigned_t cfg_checksum;
+  struct synth_ctr ctrs[1];
+};
+
+struct synth_info
+{
+  gcov_unsigned_t version;
+  struct synth_info *next;
+  gcov_unsigned_t stamp;
+#if GCOV_HEADER_CHECKSUM
+  gcov_unsigned_t checksum;
+#endif
+  const char *filename;
+  void (*merge[GCOV_COUNTERS]) (gcov_type *, gcov_unsigned_t);
+  unsigned n_functions;
+  struct synth_fn **functions;
+};
+
+static gcov_type selectedArcs[ARCS];
+static gcov_type copyArcs[ARCS];
+static struct synth_info info;
+static struct synth_info other;
+static struct synth_fn selected = { &info, 1, 0, 0, { { ARCS, selectedArcs } } };
+static struct synth_fn copy = { &other, 2, 0, 0, { { ARCS, copyArcs } } };
+static struct synth_fn *functions[] = { &selected, &copy, NULL };
+
+static gcov_unsigned_t data[1024];
+static gcov_unsigned_t announced;
+static gcov_unsigned_t received;
+
+static int
+keep_begin (void *ctx, const char *filename, gcov_unsigned_t length)
+{
+  (void) ctx;
+  (void) filename;
+  announced = length;
+  received = 0;
+  return 0;
+}
+
+static int
+keep_write (void *ctx, const void *p, gcov_unsigned_t length)
+{
+  (void) ctx;
+  if (received + length <= sizeof (data))
+    memcpy ((char *) data + received, p, length);
+  received += length;
+  return 0;
+}
+
+static const gcov_sink keepSink = {
+  NULL, keep_begin, keep_write, NULL, NULL, NULL
+};
+
+int
+main (void)
+{
+  unsigned words;
+  unsigned pos = GCOV_HEADER_WORDS;
+  int emptyRecords = 0;
+  int fullRecords = 0;
+  int counterRecords = 0;
+  int i;
+
+  info.filename = "comdat.gcda";
+  info.merge[GCOV_COUNTER_ARCS] = __gcov_merge_add;
+  info.n_functions = sizeof (functions) / sizeof (functions[0]);
+  info.functions = functions;
+  for (i = 0; i < ARCS; i++)
+    {
+      selectedArcs[i] = i + 1;
+      copyArcs[i] = i + 1;
+    }
+
+  __gcov_init ((struct gcov_info *) &info);
+  __gcov_register_sink (&keepSink);
+  __gcov_exit ();
+
+  if (received != announced || received > sizeof (data))
+    {
+      printf ("comdat.gcda: %u bytes announced, %u sent\n", announced, received);
+      return 1;
+    }
+
+  // walk the records after the file header
+  words = received / sizeof (gcov_unsigned_t);
+  pos += GCOV_SUMMARY_WORDS;
+  while (pos + 2 <= words)
+    {
+      gcov_unsigned_t tag = data[pos];
+      int length = (int) data[pos + 1];
+
+      if (tag == GCOV_TAG_FUNCTION)
+        {
+          if (length)
+            fullRecords++;
+          else
+            emptyRecords++;
+        }
+      else
+        counterRecords++;
+      pos += 2 + (length > 0 ? length / GCOV_LENGTH_UNIT : 0);
+    }
+
+  __gcov_clear ();
+
+  printf ("comdat: %d function records with counters, %d empty, %d counter records, %u bytes\n",
+          fullRecords, emptyRecords, counterRecords, received);
+  // the copy would have been a function record and an arc record
+  printf ("comdat: the copy in full would have added %u bytes\n",
+          (unsigned) ((2 + GCOV_TAG_FUNCTION_WORDS + 2 + GCOV_TAG_COUNTER_WORDS (ARCS))
+                      * sizeof (gcov_unsigned_t)));
+
+  if (pos != words || fullRecords != 1 || emptyRecords != 2 || counterRecords != 1)
+    return 1;
+  if (selectedArcs[0] != 0 || copyArcs[0] != 1)
+    {
+      printf ("comdat: __gcov_clear cleared the wrong counters\n");
+      return 1;
+    }
+  return 0;
+}
@@ -0,0 +1,28 @@
+/* For make check_info_section: built with -fprofile-info-section,
+ * nothing registers the file at startup, and nothing dumps it at
+ * exit, so this calls __gcov_exit itself; the runtime finds the
+ * file through the linker-made section.
+ */
+#include "gcov_public.h"
+
+#define WORKLOAD_RUNS 7
+
+static int
+workload (int x)
+{
+  if (x & 1)
+    return x * 3;
+  return x / 2;
+}
+
+int
+main (void)
+{
+  int sum = 0;
+  int i;
+
+  for (i = 0; i < WORKLOAD_RUNS; i++)
+    sum += workload (i);
+  __gcov_exit ();
+  return sum == 0;
+}
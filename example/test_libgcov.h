@@ -0,0 +1,56 @@
+/* For make check_libgcov: inline and template functions that
+ * test_libgcov_a.cc and test_libgcov_b.cc both compile (comdat),
+ * some never run, so their counters are all zero.
+ */
+template <typename T>
+class Tally
+{
+public:
+  Tally () : total (0), count (0) {}
+
+  void
+  add (T x)
+  {
+    total += x;
+    count++;
+  }
+
+  T
+  mean () const
+  {
+    if (count == 0)
+      return 0;
+    return total / count;
+  }
+
+private:
+  T total;
+  int count;
+};
+
+template <typename T>
+T
+clamp (T x, T lo, T hi)
+{
+  if (x < lo)
+    return lo;
+  if (x > hi)
+    return hi;
+  return x;
+}
+
+inline int
+twice (int x)
+{
+  return 2 * x;
+}
+
+// never called
+inline int
+unused_inline (int x)
+{
+  return x * x;
+}
+
+int run_a (int n);
+int run_b (int n);
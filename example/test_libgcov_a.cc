@@ -0,0 +1,33 @@
+/* For make check_libgcov, built once with libgcov (--coverage)
+ * and once with this runtime; gcov must read the same counts
+ * from the .gcda files of both.
+ */
+#include <stdio.h>
+#include "test_libgcov.h"
+
+int
+run_a (int n)
+{
+  Tally<int> t;
+
+  for (int i = 0; i < n; i++)
+    t.add (clamp (i - 3, 0, 5));
+  return t.mean () + twice (n);
+}
+
+// never called
+int
+unused_a (int x)
+{
+  for (int i = 0; i < x; i++)
+    if (i % 7 == 0)
+      x += unused_inline (i);
+  return x;
+}
+
+int
+main (void)
+{
+  printf ("%d %d\n", run_a (10), run_b (20));
+  return 0;
+}
@@ -0,0 +1,27 @@
+/* For make check_libgcov, see test_libgcov_a.cc */
+#include "test_libgcov.h"
+
+int
+run_b (int n)
+{
+  Tally<int> t;
+  Tally<double> d;
+
+  for (int i = 0; i < n; i++)
+    {
+      t.add (clamp (i, 2, 12));
+      if (i & 1)
+        d.add (i * 0.5);
+    }
+  return t.mean () + (int) d.mean () + twice (1);
+}
+
+// never called
+double
+unused_b (double x)
+{
+  Tally<double> d;
+
+  d.add (clamp (x, 0.0, 1.0));
+  return d.mean ();
+}
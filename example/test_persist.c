@@ -0,0 +1,38 @@
+/* For make check_persist: adds the counters saved by earlier runs
+ * into the live ones, runs a workload, and saves them again, so
+ * the dump at exit holds the counts of every run so far.
+ * Built with -DCHANGED, the workload has another branch, so
+ * the saved counters are of another build and must be left out.
+ */
+#include <stdio.h>
+#include "gcov_public.h"
+
+#define WORKLOAD_RUNS 10
+
+static int
+workload (int x)
+{
+#ifdef CHANGED
+  if (x > 5)
+    return x - 5;
+#endif
+  return x * 2;
+}
+
+int
+main (void)
+{
+  int restored = __gcov_persist_load ();
+  int sum = 0;
+  int i;
+
+  for (i = 0; i < WORKLOAD_RUNS; i++)
+    sum += workload (i);
+  if (__gcov_persist_save () != 0)
+    {
+      printf ("persist: cannot save the counters\n");
+      return 1;
+    }
+  printf ("persist: %d files restored\n", restored);
+  return sum == 0;
+}
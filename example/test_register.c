@@ -0,0 +1,110 @@
+/* For make check_register: registers thousands of synthetic
+ * gcov_info objects with __gcov_init from many threads at once,
+ * then dumps, and checks that each object was dumped exactly once.
+ * Built with GCOV_OPT_ATOMIC_REGISTRATION; without it,
+ * registrations get lost.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "gcov_gcc.h"
+
+#define THREADS 16
+#define INFOS_PER_THREAD 4096
+#define INFOS (THREADS * INFOS_PER_THREAD)
+
+/* Laid out as the gcov_info gcc generates (see gcov_gcc.c),
+ * with no functions, so each dumps as a bare header */
+struct synth_info
+{
+  gcov_unsigned_t version;
+  struct synth_info *next;
+  gcov_unsigned_t stamp;
+#if GCOV_HEADER_CHECKSUM
+  gcov_unsigned_t checksum;
+#endif
+  const char *filename;
+  void (*merge[GCOV_COUNTERS]) (gcov_type *, gcov_unsigned_t);
+  unsigned n_functions;
+  void **functions;
+};
+
+static struct synth_info infos[INFOS];
+static char names[INFOS][24];
+static int seen[INFOS];
+static int dumped;
+static pthread_barrier_t start;
+
+static void *
+register_slice (void *arg)
+{
+  struct synth_info *slice = arg;
+  int i;
+
+  // all threads call __gcov_init at the same moment
+  pthread_barrier_wait (&start);
+  for (i = 0; i < INFOS_PER_THREAD; i++)
+    __gcov_init ((struct gcov_info *) &slice[i]);
+  return NULL;
+}
+
+static int
+count_begin (void *ctx, const char *filename, gcov_unsigned_t length)
+{
+  int n;
+
+  (void) ctx;
+  (void) length;
+  if (sscanf (filename, "synth%d.gcda", &n) == 1 && n >= 0 && n < INFOS)
+    {
+      seen[n]++;
+      dumped++;
+    }
+  return 0;
+}
+
+static int
+count_write (void *ctx, const void *data, gcov_unsigned_t length)
+{
+  (void) ctx;
+  (void) data;
+  (void) length;
+  return 0;
+}
+
+static const gcov_sink countSink = {
+  NULL, count_begin, count_write, NULL, NULL, NULL
+};
+
+int
+main (void)
+{
+  pthread_t threads[THREADS];
+  int missing = 0;
+  int twice = 0;
+  int i;
+
+  for (i = 0; i < INFOS; i++)
+    {
+      snprintf (names[i], sizeof (names[i]), "synth%d.gcda", i);
+      infos[i].filename = names[i];
+    }
+
+  pthread_barrier_init (&start, NULL, THREADS);
+  for (i = 0; i < THREADS; i++)
+    pthread_create (&threads[i], NULL, register_slice, &infos[i * INFOS_PER_THREAD]);
+  for (i = 0; i < THREADS; i++)
+    pthread_join (threads[i], NULL);
+
+  __gcov_register_sink (&countSink);
+  __gcov_exit ();
+
+  for (i = 0; i < INFOS; i++)
+    {
+      missing += (seen[i] == 0);
+      twice += (seen[i] > 1);
+    }
+  printf ("%d threads registered %d, dumped %d, %d missing, %d twice\n",
+          THREADS, INFOS, dumped, missing, twice);
+  return (missing || twice) ? 1 : 0;
+}
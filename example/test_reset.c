@@ -0,0 +1,62 @@
+/* For make check_reset: dumps with __gcov_dump_reset twice, with
+ * work in between, so the second dump must hold only the counts
+ * made after the first, then clears test_reset_x.gcda alone with
+ * __gcov_clear_file before the dump at exit.
+ * Each dump is kept as dump<n>.bin, as the output file is
+ * written again by the next one.
+ */
+#include <stdio.h>
+#include "gcov_public.h"
+
+int x_work (int x);
+
+static int
+work (int x)
+{
+  return x + 1;
+}
+
+static int
+run (int times)
+{
+  int sum = 0;
+  int i;
+
+  for (i = 0; i < times; i++)
+    sum += work (i) + x_work (i);
+  return sum;
+}
+
+static int
+keep_dump (const char *name)
+{
+  if (rename (GCOV_OUTPUT_BINARY_FILENAME, name) != 0)
+    {
+      perror (name);
+      return 1;
+    }
+  return 0;
+}
+
+int
+main (void)
+{
+  int sum = run (3);
+
+  __gcov_dump_reset ();
+  if (keep_dump ("dump1.bin"))
+    return 1;
+
+  sum += run (5);
+  __gcov_dump_reset ();
+  if (keep_dump ("dump2.bin"))
+    return 1;
+
+  sum += run (2);
+  if (__gcov_clear_file ("test_reset_x.gcda") != 1)
+    {
+      printf ("reset: test_reset_x.gcda not cleared\n");
+      return 1;
+    }
+  return sum == 0;
+}
@@ -0,0 +1,10 @@
+/* For make check_reset: the other file, cleared on its own
+ * by __gcov_clear_file (see test_reset.c).
+ */
+int
+x_work (int x)
+{
+  if (x & 1)
+    return x * 3;
+  return x / 2;
+}
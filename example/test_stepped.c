@@ -0,0 +1,120 @@
+/* For make check_stepped: starts a dump in small steps, runs code
+ * between the steps that changes the size the file would have
+ * (a function called for the first time), and checks with a sink
+ * of its own that each file still gets the byte count it was
+ * announced. The dump also goes to the binary output file,
+ * for the host decoder and gcov to read.
+ * For make check_stepped_delta, built with GCOV_OPT_DELTA_DUMP,
+ * a full dump comes first, kept as gcov_full.bin, and the stepped
+ * dump is a delta, which the late call changes once it has started.
+ * Delta dumps have a transfer header in front of the file data,
+ * written at once, which the check sink does not count.
+ * For make check_stepped_values, built with GCOV_OPT_PROFILE_VALUES
+ * and -fprofile-generate, a division sees new divisors once the dump
+ * has started, which adds pairs to its top N value profile.
+ */
+#include <stdio.h>
+#include <unistd.h>
+#include "gcov_public.h"
+
+static gcov_unsigned_t announced;
+static gcov_unsigned_t received;
+static int header;
+static int wrong;
+
+static int
+check_begin (void *ctx, const char *filename, gcov_unsigned_t length)
+{
+  (void) ctx;
+  (void) filename;
+  announced = length;
+  received = 0;
+#ifdef GCOV_OPT_DELTA_DUMP
+  header = 1;
+#endif
+  return 0;
+}
+
+static int
+check_write (void *ctx, const void *data, gcov_unsigned_t length)
+{
+  (void) ctx;
+  (void) data;
+  if (header)
+    header = 0;
+  else
+    received += length;
+  return 0;
+}
+
+static int
+check_end (void *ctx, const char *filename)
+{
+  (void) ctx;
+  if (received != announced)
+    {
+      printf ("%s: %u bytes announced, %u sent\n", filename, announced, received);
+      wrong++;
+    }
+  return 0;
+}
+
+static const gcov_sink checkSink = {
+  NULL, check_begin, check_write, check_end, NULL, NULL
+};
+
+static int
+early (int x)
+{
+  if (x > 2)
+    return x - 2;
+  return x + 2;
+}
+
+// not called before the dump starts
+static int
+late (int x)
+{
+  if (x & 1)
+    return x * 3;
+  return x / 2;
+}
+
+#ifdef GCOV_OPT_PROFILE_VALUES
+static int
+divide (int x, int d)
+{
+  return x / d;
+}
+#endif
+
+int
+main (void)
+{
+  int sum = early (1);
+
+  __gcov_register_sink (&checkSink);
+#ifdef GCOV_OPT_DELTA_DUMP
+  __gcov_exit ();
+  rename ("gcov_output.bin", "gcov_full.bin");
+  sum += early (3);
+#endif
+#ifdef GCOV_OPT_PROFILE_VALUES
+  sum += divide (100, 3);
+#endif
+
+  __gcov_dump_begin ();
+  __gcov_dump_step (64);
+  sum += late (5);
+#ifdef GCOV_OPT_PROFILE_VALUES
+  sum += divide (100, 5) + divide (100, 7);
+#endif
+  while (__gcov_dump_step (64))
+    ;
+
+  printf ("stepped dump: %d files with the wrong byte count, sum %d\n", wrong, sum);
+  fflush (stdout);
+
+  // keep the stepped dump, skip the __gcov_exit of the destructor
+  _exit (wrong ? 1 : 0);
+}
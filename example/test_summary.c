@@ -0,0 +1,81 @@
+/* For make check_summary: registers two gcov_info objects with known
+ * arc counters, one function's ident above 2^31, and prints
+ * __gcov_summary of all the files and of one of them, to be compared
+ * with test_summary.txt.
+ */
+#include <stdio.h>
+#include "gcov_gcc.h"
+
+/* Laid out as the gcov_info gcc generates (see gcov_gcc.c) */
+struct synth_info;
+
+struct synth_ctr
+{
+  gcov_unsigned_t num;
+  gcov_type *values;
+};
+
+struct synth_fn
+{
+  const struct synth_info *key;
+  gcov_unsigned_t ident;
+  gcov_unsigned_t lineno_checksum;
+  gcov_unsigned_t cfg_checksum;
+  struct synth_ctr ctrs[1];
+};
+
+struct synth_info
+{
+  gcov_unsigned_t version;
+  struct synth_info *next;
+  gcov_unsigned_t stamp;
+#if GCOV_HEADER_CHECKSUM
+  gcov_unsigned_t checksum;
+#endif
+  const char *filename;
+  void (*merge[GCOV_COUNTERS]) (gcov_type *, gcov_unsigned_t);
+  unsigned n_functions;
+  struct synth_fn **functions;
+};
+
+static gcov_type motorRunArcs[] = { 1, 0, 5, 0, 0, 9 };
+static gcov_type motorStopArcs[] = { 0, 0, 0, 0, 0 };
+static gcov_type ioArcs[] = { 0, 1, 1 };
+static struct synth_info motor;
+static struct synth_info io;
+static struct synth_fn motorRun = { &motor, 0x80000001u, 0, 0, { { 6, motorRunArcs } } };
+static struct synth_fn motorStop = { &motor, 3, 0, 0, { { 5, motorStopArcs } } };
+static struct synth_fn ioRead = { &io, 9, 0, 0, { { 3, ioArcs } } };
+static struct synth_fn *motorFunctions[] = { &motorRun, &motorStop };
+static struct synth_fn *ioFunctions[] = { &ioRead };
+
+static void
+synth_register (struct synth_info *info, const char *filename,
+                struct synth_fn **functions, unsigned n_functions)
+{
+  info->filename = filename;
+  info->merge[GCOV_COUNTER_ARCS] = __gcov_merge_add;
+  info->n_functions = n_functions;
+  info->functions = functions;
+  __gcov_init ((struct gcov_info *) info);
+}
+
+int
+main (void)
+{
+  int all;
+  int one;
+
+  synth_register (&motor, "sub/motor.gcda", motorFunctions, 2);
+  synth_register (&io, "io.gcda", ioFunctions, 1);
+
+  all = __gcov_summary (NULL);
+  one = __gcov_summary ("motor.gcda");
+  fflush (stdout);
+  if (all != 2 || one != 1)
+    {
+      fprintf (stderr, "summary: %d and %d files summarized\n", all, one);
+      return 1;
+    }
+  return 0;
+}
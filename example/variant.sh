@@ -0,0 +1,43 @@
+#!/bin/sh
+
+# Typical usage: ./variant.sh build/name GCOV_OPT_OUTPUT_BINARY_FILE -GCOV_OPT_PRINT_STATUS GCOV_FILE_BUFFER_SIZE=1
+
+# Copies ../code to the given directory, with the options of
+# gcov_public.h turned on (NAME), off (-NAME), or set (NAME=VALUE),
+# so the check and bench targets of the Makefile can build
+# the same sources several ways.
+
+set -e
+
+dir=$1
+shift
+
+rm -rf "$dir"
+mkdir -p "$dir"
+cp -r ../code "$dir/"
+header=$dir/code/gcov_public.h
+
+for option in "$@"
+do
+	case $option in
+	-*)
+		name=${option#-}
+		sed -i "s|^#define $name\$|//#define $name|" "$header"
+		line="//#define $name"
+		;;
+	*=*)
+		name=${option%%=*}
+		sed -i "s|^#define $name .*|#define $name ${option#*=}|" "$header"
+		line="#define $name ${option#*=}"
+		;;
+	*)
+		sed -i "s|^//#define $option\$|#define $option|" "$header"
+		line="#define $option"
+		;;
+	esac
+	if ! grep -qxF "$line" "$header"
+	then
+		echo "variant.sh: no option $option in gcov_public.h" >&2
+		exit 1
+	fi
+done
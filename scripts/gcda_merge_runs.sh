@@ -0,0 +1,51 @@
+#!/bin/bash
+
+# Typical usage: ./gcda_merge_runs.sh ../results/gcda_test01 ../results/gcda_test02 ...
+
+# Merges the .gcda files of many test runs in one pass,
+# each run's files saved in its own directory
+# (such as from gcov_decode -d ../results/gcda_test01).
+# Run lcov_newcoverage.sh once on the merged files, instead of
+# combining one .info file per run with lcov_combine_new_total.sh.
+# Files from a different build are reported and left out.
+
+# Build the merge tool if needed
+if [ ! -x ../tools/gcda_merge ]
+then
+	make -C ../tools
+fi
+
+# Write the merged .gcda files to ../objs
+# which is where the object files and .gcno files
+# should already be
+../tools/gcda_merge -o ../objs "$@"
+
+# embedded-gcov gcda_merge_runs.sh script to merge the gcda files of many test runs
+#
+# Copyright (c) 2021 California Institute of Technology (“Caltech”).
+# U.S. Government sponsorship acknowledged.
+#
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification,
+# are permitted provided that the following conditions are met:
+#    Redistributions of source code must retain the above copyright notice,
+#        this list of conditions and the following disclaimer.
+#    Redistributions in binary form must reproduce the above copyright notice,
+#        this list of conditions and the following disclaimer in the documentation
+#        and/or other materials provided with the distribution.
+#    Neither the name of Caltech nor its operating division, the Jet Propulsion Laboratory,
+#        nor the names of its contributors may be used to endorse or promote products
+#        derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+# THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+# (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+# ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+# THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
@@ -29,6 +29,19 @@ for i in `find ../objs -name '*.gcda.xxd'`;do
 	rm "$i"
 done
 
+# Expand any files that were packed on the target
+# (GCOV_OPT_TRANSFER_PACKED), building the decoder if needed
+for i in `find ../objs -name '*.gcda'`;do
+	if [ "`head -c 4 "$i"`" = "gctp" ]
+	then
+		if [ ! -x ../tools/gcov_decode ]
+		then
+			make -C ../tools
+		fi
+		../tools/gcov_decode -u "$i"
+	fi
+done
+
 # embedded-gcov gcov_convert.sh script to split serial output to separate gcda files
 #
 # Copyright (c) 2021 California Institute of Technology (“Caltech”).
@@ -0,0 +1,48 @@
+#!/bin/bash
+
+# Typical usage: ./gcov_convert_binary.sh ../gcov_output.bin
+
+# For the output file of a target built with GCOV_OPT_OUTPUT_BINARY_FILE,
+# or a memory dump of the GCOV_OPT_OUTPUT_BINARY_MEMORY buffer.
+# Give several dumps, in order, for delta dumps.
+
+# Build the decoder if needed
+if [ ! -x ../tools/gcov_decode ]
+then
+	make -C ../tools
+fi
+
+# Write the .gcda files to ../objs
+# which is where the object files and .gcno files
+# should already be
+../tools/gcov_decode -b -d ../objs "$@"
+
+# embedded-gcov gcov_convert_binary.sh script to split binary output to separate gcda files
+#
+# Copyright (c) 2021 California Institute of Technology (“Caltech”).
+# U.S. Government sponsorship acknowledged.
+#
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification,
+# are permitted provided that the following conditions are met:
+#    Redistributions of source code must retain the above copyright notice,
+#        this list of conditions and the following disclaimer.
+#    Redistributions in binary form must reproduce the above copyright notice,
+#        this list of conditions and the following disclaimer in the documentation
+#        and/or other materials provided with the distribution.
+#    Neither the name of Caltech nor its operating division, the Jet Propulsion Laboratory,
+#        nor the names of its contributors may be used to endorse or promote products
+#        derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+# THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+# (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+# ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+# THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
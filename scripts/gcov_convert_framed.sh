@@ -0,0 +1,50 @@
+#!/bin/bash
+
+# Typical usage: ./gcov_convert_framed.sh ../test01_serial_log.txt
+
+# For serial logs from a target built with GCOV_OPT_OUTPUT_SERIAL_FRAMED.
+# Replaces the tr, dos2unix, serial_split.awk and xxd steps
+# of gcov_convert.sh: the frames are found in the raw log,
+# checked, and written straight to .gcda files.
+# Files with lost or damaged frames are reported and not written.
+
+# Build the decoder if needed
+if [ ! -x ../tools/gcov_decode ]
+then
+	make -C ../tools
+fi
+
+# Write the .gcda files to ../objs
+# which is where the object files and .gcno files
+# should already be
+../tools/gcov_decode -d ../objs "$1"
+
+# embedded-gcov gcov_convert_framed.sh script to split framed serial output to separate gcda files
+#
+# Copyright (c) 2021 California Institute of Technology (“Caltech”).
+# U.S. Government sponsorship acknowledged.
+#
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification,
+# are permitted provided that the following conditions are met:
+#    Redistributions of source code must retain the above copyright notice,
+#        this list of conditions and the following disclaimer.
+#    Redistributions in binary form must reproduce the above copyright notice,
+#        this list of conditions and the following disclaimer in the documentation
+#        and/or other materials provided with the distribution.
+#    Neither the name of Caltech nor its operating division, the Jet Propulsion Laboratory,
+#        nor the names of its contributors may be used to endorse or promote products
+#        derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+# THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+# (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+# ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+# THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
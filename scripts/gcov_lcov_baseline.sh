@@ -0,0 +1,50 @@
+#!/bin/bash
+
+# Same as lcov_baseline.sh, but the baseline is written by
+# ../tools/gcov_lcov from the .gcno files alone,
+# instead of running gcov once for each object file.
+
+# Build the tool if needed
+if [ ! -x ../tools/gcov_lcov ]
+then
+	make -C ../tools
+fi
+
+# The record of each .gcno file is kept in ../results/baseline_cache,
+# by a hash of its contents, so only the changed object files
+# are worked out again on the next run.
+# Delete the directory now and then to drop records of old builds.
+../tools/gcov_lcov -i \
+	-c ../results/baseline_cache \
+	-o ../results/baseline.info \
+	../objs/
+
+# embedded-gcov gcov_lcov_baseline.sh script to generate baseline lcov output without gcov
+#
+# Copyright (c) 2021 California Institute of Technology (“Caltech”).
+# U.S. Government sponsorship acknowledged.
+#
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification,
+# are permitted provided that the following conditions are met:
+#    Redistributions of source code must retain the above copyright notice,
+#        this list of conditions and the following disclaimer.
+#    Redistributions in binary form must reproduce the above copyright notice,
+#        this list of conditions and the following disclaimer in the documentation
+#        and/or other materials provided with the distribution.
+#    Neither the name of Caltech nor its operating division, the Jet Propulsion Laboratory,
+#        nor the names of its contributors may be used to endorse or promote products
+#        derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+# THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+# (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+# ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+# THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
@@ -0,0 +1,55 @@
+#!/bin/bash
+
+# Typical usage: ./gcov_test_matrix.sh ../test_campaign_log.txt
+
+# For serial logs from a target built with GCOV_OPT_TEST_CAPTURE
+# and GCOV_OPT_OUTPUT_SERIAL_FRAMED.
+# Writes the .gcda files of each test dump into its own
+# directory, ../results/tests/test_<id>, then the matrix of
+# which tests ran which functions to ../results/test_matrix.csv.
+# To choose the tests to run after a change, take the tests
+# with a 1 on the lines of the functions that changed.
+
+# Build the tools if needed
+if [ ! -x ../tools/gcov_decode ] || [ ! -x ../tools/gcov_matrix ]
+then
+	make -C ../tools
+fi
+
+# Files from dumps outside of tests land in ../results/tests itself,
+# and are not part of the matrix
+rm -rf ../results/tests
+../tools/gcov_decode -d ../results/tests "$@"
+
+# The .gcno files should already be in ../objs
+../tools/gcov_matrix -g ../objs -o ../results/test_matrix.csv ../results/tests/test_*
+
+# embedded-gcov gcov_test_matrix.sh script to build a test by function coverage matrix
+#
+# Copyright (c) 2021 California Institute of Technology (“Caltech”).
+# U.S. Government sponsorship acknowledged.
+#
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification,
+# are permitted provided that the following conditions are met:
+#    Redistributions of source code must retain the above copyright notice,
+#        this list of conditions and the following disclaimer.
+#    Redistributions in binary form must reproduce the above copyright notice,
+#        this list of conditions and the following disclaimer in the documentation
+#        and/or other materials provided with the distribution.
+#    Neither the name of Caltech nor its operating division, the Jet Propulsion Laboratory,
+#        nor the names of its contributors may be used to endorse or promote products
+#        derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+# THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+# (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+# ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+# THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
@@ -0,0 +1,358 @@
+/**********************************************************************/
+/** @addtogroup embedded_gcov
+ * @{
+ * @file
+ * @version $Id: $
+ *
+ * @brief Reading and writing .gcda files, for the host tools.
+ *
+ * See gcda_io.h.
+ *
+ **********************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gcda_io.h"
+
+/* ----------------------------------------------------------- */
+static unsigned long swap_word(unsigned long w)
+{
+    return ((w >> 24) & 0xff) | ((w >> 8) & 0xff00) | ((w << 8) & 0xff0000) | ((w << 24) & 0xff000000);
+}
+
+static unsigned long get_word(const GcdaInfo *info, const unsigned char *p)
+{
+    unsigned int w;
+
+    memcpy(&w, p, 4);
+    return info->swap ? swap_word(w) : w;
+}
+
+/*
+ * gcda_parse fills info from the data of a .gcda file.
+ * Returns 0, or -1 with *why set.
+ */
+static int gcda_parse(GcdaInfo *info, const unsigned char *data, size_t length, const char **why)
+{
+    GcdaFunction *fn = NULL;
+    size_t unit;
+    size_t pos;
+
+    if (length < 12 || length % 4) {
+        *why = "not a gcda file";
+        return -1;
+    }
+    if (get_word(info, data) != GCDA_MAGIC) {
+        info->swap = 1;
+        if (get_word(info, data) != GCDA_MAGIC) {
+            *why = "not a gcda file";
+            return -1;
+        }
+    }
+
+    /* Version is like "B22*" for gcc 12.2, "A93*" for gcc 9.3 */
+    info->version = get_word(info, data + 4);
+    info->major = (int)((info->version >> 24) & 0xff) - 'A';
+    info->major = info->major * 10 + (int)((info->version >> 16) & 0xff) - '0';
+    info->stamp = get_word(info, data + 8);
+    pos = 12;
+    if (info->major >= 12) {
+        if (length < 16) {
+            *why = "not a gcda file";
+            return -1;
+        }
+        info->checksum = get_word(info, data + 12);
+        pos = 16;
+    }
+    /* record lengths are in bytes for gcc 12 and later, else in words */
+    unit = info->major >= 12 ? 1 : 4;
+
+    while (pos < length) {
+        unsigned long tag;
+        long recordLength;
+        size_t bytes;
+
+        if (length - pos == 4 && get_word(info, data + pos) == 0) {
+            info->endWord = 1;
+            break;
+        }
+        if (length - pos < 8) {
+            *why = "truncated record";
+            return -1;
+        }
+        tag = get_word(info, data + pos);
+        recordLength = (long)(int)get_word(info, data + pos + 4);
+        /* (negative is an all-zero counter array, with no values) */
+        bytes = recordLength < 0 ? 0 : (size_t)recordLength * unit;
+        pos += 8;
+        if (bytes > length - pos) {
+            *why = "truncated record";
+            return -1;
+        }
+
+        if (tag == GCDA_TAG_SUMMARY) {
+            /* runs and sum_max since gcc 9, older summaries are dropped */
+            if (info->major >= 9 && bytes >= 8) {
+                info->hasSummary = 1;
+                info->runs = get_word(info, data + pos);
+                info->sumMax = get_word(info, data + pos + 4);
+            }
+        } else if (tag == GCDA_TAG_FUNCTION) {
+            GcdaFunction *functions = realloc(info->functions,
+                                              (info->functionCount + 1) * sizeof(GcdaFunction));
+
+            if (!functions) {
+                *why = "out of memory";
+                return -1;
+            }
+            info->functions = functions;
+            fn = &functions[info->functionCount++];
+            memset(fn, 0, sizeof(*fn));
+            fn->empty = (bytes < 12);
+            if (!fn->empty) {
+                fn->ident = get_word(info, data + pos);
+                fn->linenoChecksum = get_word(info, data + pos + 4);
+                fn->cfgChecksum = get_word(info, data + pos + 8);
+            }
+        } else if (tag >= GCDA_TAG_COUNTER_BASE && tag < GCDA_TAG_FOR_COUNTER(32) &&
+                   ((tag - GCDA_TAG_COUNTER_BASE) & 0x1ffff) == 0) {
+            GcdaCounters *counters;
+            GcdaCounters *c;
+
+            if (!fn) {
+                *why = "counters before the first function";
+                return -1;
+            }
+            counters = realloc(fn->counters, (fn->counterCount + 1) * sizeof(GcdaCounters));
+            if (!counters) {
+                *why = "out of memory";
+                return -1;
+            }
+            fn->counters = counters;
+            c = &counters[fn->counterCount++];
+            c->tag = tag;
+            c->count = recordLength < 0 ? (size_t)-recordLength / 8 : bytes / 8;
+            c->values = calloc(c->count ? c->count : 1, sizeof(long long));
+            if (!c->values) {
+                *why = "out of memory";
+                return -1;
+            }
+            /* each value is two words, low word first */
+            for (size_t i = 0; recordLength > 0 && i < c->count; i++) {
+                unsigned long long lo = get_word(info, data + pos + i * 8);
+                unsigned long long hi = get_word(info, data + pos + i * 8 + 4);
+
+                c->values[i] = (long long)((hi << 32) | lo);
+            }
+        } else {
+            *why = "unknown record";
+            return -1;
+        }
+        pos += bytes;
+    }
+    return 0;
+}
+
+int gcda_read(const char *path, GcdaInfo *info, const char **why)
+{
+    FILE *f = fopen(path, "rb");
+    unsigned char *data = NULL;
+    size_t size = 0;
+    size_t used = 0;
+    int status;
+
+    memset(info, 0, sizeof(*info));
+    if (!f) {
+        *why = strerror(errno);
+        return -1;
+    }
+    for (;;) {
+        if (used == size) {
+            unsigned char *bigger;
+
+            size = size ? size * 2 : 65536;
+            bigger = realloc(data, size);
+            if (!bigger) {
+                *why = "out of memory";
+                free(data);
+                fclose(f);
+                return -1;
+            }
+            data = bigger;
+        }
+        size_t n = fread(data + used, 1, size - used, f);
+        if (n == 0) {
+            break;
+        }
+        used += n;
+    }
+    fclose(f);
+
+    status = gcda_parse(info, data, used, why);
+    free(data);
+    if (status != 0) {
+        gcda_free(info);
+    }
+    return status;
+}
+
+/* ----------------------------------------------------------- */
+/* Output buffer of gcda_write */
+typedef struct {
+    const GcdaInfo *info;
+    unsigned char *data;
+    size_t used;
+    size_t size;
+} GcdaBuffer;
+
+static int put_word(GcdaBuffer *buf, unsigned long w)
+{
+    unsigned int v;
+
+    if (buf->used + 4 > buf->size) {
+        size_t size = buf->size ? buf->size * 2 : 4096;
+        unsigned char *bigger = realloc(buf->data, size);
+
+        if (!bigger) {
+            return -1;
+        }
+        buf->data = bigger;
+        buf->size = size;
+    }
+    v = (unsigned int)(buf->info->swap ? swap_word(w) : w);
+    memcpy(buf->data + buf->used, &v, 4);
+    buf->used += 4;
+    return 0;
+}
+
+int gcda_write(const char *path, const GcdaInfo *info)
+{
+    GcdaBuffer buf;
+    unsigned long unit = info->major >= 12 ? 1 : 4;
+    int status = 0;
+    FILE *f;
+
+    memset(&buf, 0, sizeof(buf));
+    buf.info = info;
+
+    status |= put_word(&buf, GCDA_MAGIC);
+    status |= put_word(&buf, info->version);
+    status |= put_word(&buf, info->stamp);
+    if (info->major >= 12) {
+        status |= put_word(&buf, info->checksum);
+    }
+    if (info->hasSummary) {
+        status |= put_word(&buf, GCDA_TAG_SUMMARY);
+        status |= put_word(&buf, 8 / unit);
+        status |= put_word(&buf, info->runs);
+        status |= put_word(&buf, info->sumMax);
+    }
+
+    for (size_t i = 0; i < info->functionCount; i++) {
+        const GcdaFunction *fn = &info->functions[i];
+
+        status |= put_word(&buf, GCDA_TAG_FUNCTION);
+        if (fn->empty) {
+            status |= put_word(&buf, 0);
+            continue;
+        }
+        status |= put_word(&buf, 12 / unit);
+        status |= put_word(&buf, fn->ident);
+        status |= put_word(&buf, fn->linenoChecksum);
+        status |= put_word(&buf, fn->cfgChecksum);
+
+        for (size_t k = 0; k < fn->counterCount; k++) {
+            const GcdaCounters *c = &fn->counters[k];
+            int allZero = 1;
+
+            for (size_t n = 0; n < c->count && allZero; n++) {
+                allZero = (c->values[n] == 0);
+            }
+            status |= put_word(&buf, c->tag);
+            /* gcc 12 and later leave out all-zero values, with a negative length */
+            if (allZero && info->major >= 12) {
+                status |= put_word(&buf, (unsigned long)(0 - c->count * 8) & 0xFFFFFFFFUL);
+                continue;
+            }
+            status |= put_word(&buf, c->count * 8 / unit);
+            for (size_t n = 0; n < c->count; n++) {
+                unsigned long long v = (unsigned long long)c->values[n];
+
+                status |= put_word(&buf, (unsigned long)(v & 0xFFFFFFFFUL));
+                status |= put_word(&buf, (unsigned long)(v >> 32));
+            }
+        }
+    }
+
+    if (info->endWord) {
+        status |= put_word(&buf, 0);
+    }
+
+    if (status != 0) {
+        free(buf.data);
+        errno = ENOMEM;
+        return -1;
+    }
+    f = fopen(path, "wb");
+    if (!f || fwrite(buf.data, 1, buf.used, f) != buf.used) {
+        int err = errno;
+
+        if (f) {
+            fclose(f);
+        }
+        free(buf.data);
+        errno = err;
+        return -1;
+    }
+    free(buf.data);
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+void gcda_free(GcdaInfo *info)
+{
+    for (size_t i = 0; i < info->functionCount; i++) {
+        for (size_t k = 0; k < info->functions[i].counterCount; k++) {
+            free(info->functions[i].counters[k].values);
+        }
+        free(info->functions[i].counters);
+    }
+    free(info->functions);
+    memset(info, 0, sizeof(*info));
+}
+
+/** @}
+ */
+/*
+ * embedded-gcov gcda_io.c host tools gcda file reading and writing
+ *
+ * Copyright (c) 2021 California Institute of Technology (“Caltech”).
+ * U.S. Government sponsorship acknowledged.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *        this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *        this list of conditions and the following disclaimer in the documentation
+ *        and/or other materials provided with the distribution.
+ *    Neither the name of Caltech nor its operating division, the Jet Propulsion Laboratory,
+ *        nor the names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
@@ -0,0 +1,109 @@
+/**********************************************************************/
+/** @addtogroup embedded_gcov
+ * @{
+ * @file
+ * @version $Id: $
+ *
+ * @brief Reading and writing .gcda files, for the host tools.
+ *
+ * A .gcda file is read whole into a GcdaInfo: its header,
+ * object summary (if any), and each function's counters.
+ * Written back, it is laid out the way libgcov would write it,
+ * including the compact all-zero counters of gcc 12 and later.
+ *
+ **********************************************************************/
+#ifndef GCDA_IO_H
+#define GCDA_IO_H GCDA_IO_H
+
+#include <stddef.h>
+
+/* Compare to gcc/gcov-io.h */
+#define GCDA_MAGIC              0x67636461UL    /* "gcda" */
+#define GCDA_TAG_FUNCTION       0x01000000UL
+#define GCDA_TAG_COUNTER_BASE   0x01a10000UL
+#define GCDA_TAG_SUMMARY        0xa1000000UL
+#define GCDA_TAG_FOR_COUNTER(ct) (GCDA_TAG_COUNTER_BASE + ((unsigned long)(ct) << 17))
+#define GCDA_COUNTER_FOR_TAG(tag) (((tag) - GCDA_TAG_COUNTER_BASE) >> 17)
+
+/* One counter array of a function */
+typedef struct {
+    unsigned long tag;          /* GCDA_TAG_FOR_COUNTER of its type */
+    size_t count;
+    long long *values;
+} GcdaCounters;
+
+typedef struct {
+    int empty;                  /* record without ident (counters in another file) */
+    unsigned long ident;
+    unsigned long linenoChecksum;
+    unsigned long cfgChecksum;
+    GcdaCounters *counters;
+    size_t counterCount;
+} GcdaFunction;
+
+typedef struct {
+    int swap;                   /* file is in the other byte order */
+    int major;                  /* gcc major version that wrote it */
+    unsigned long version;
+    unsigned long stamp;
+    unsigned long checksum;     /* gcc 12 and later */
+    int hasSummary;
+    unsigned long runs;         /* object summary, gcc 9 and later */
+    unsigned long sumMax;
+    GcdaFunction *functions;
+    size_t functionCount;
+    int endWord;                /* ends with a zero word, as libgcov writes */
+} GcdaInfo;
+
+/*
+ * gcda_read reads a .gcda file into info.
+ * Returns 0, or -1 with *why set.
+ */
+int gcda_read(const char *path, GcdaInfo *info, const char **why);
+
+/*
+ * gcda_write writes info as a .gcda file.
+ * Returns 0, or -1 with errno set.
+ */
+int gcda_write(const char *path, const GcdaInfo *info);
+
+/*
+ * gcda_free frees what gcda_read allocated in info.
+ */
+void gcda_free(GcdaInfo *info);
+
+#endif /* GCDA_IO_H */
+
+/** @}
+ */
+/*
+ * embedded-gcov gcda_io.h host tools gcda file reading and writing
+ *
+ * Copyright (c) 2021 California Institute of Technology (“Caltech”).
+ * U.S. Government sponsorship acknowledged.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *        this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *        this list of conditions and the following disclaimer in the documentation
+ *        and/or other materials provided with the distribution.
+ *    Neither the name of Caltech nor its operating division, the Jet Propulsion Laboratory,
+ *        nor the names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
@@ -0,0 +1,444 @@
+/**********************************************************************/
+/** @addtogroup embedded_gcov
+ * @{
+ * @file
+ * @version $Id: $
+ *
+ * @brief Host tool to merge the .gcda files of many test runs.
+ *
+ * Typical usage: ./gcda_merge -o ../objs ../results/gcda_test01 ../results/gcda_test02
+ *
+ * Each input is a directory holding the .gcda files of one run
+ * (or of earlier merges), such as written by gcov_decode -d.
+ * Files are matched by their path under the input directory,
+ * and the counters of each function are added up, as libgcov
+ * does when a program runs again. All the inputs are merged in
+ * one pass, with the files shared out over one thread per core,
+ * so only the merged set needs to go through lcov and genhtml.
+ *
+ * A file from a different build (another stamp or checksum, or other
+ * functions) is not merged, and is reported. So are value profile
+ * counters, which cannot simply be added.
+ *
+ * Options:
+ *   -o dir   write the merged .gcda files into dir (may be an input)
+ *   -j n     merge with up to n threads (default is the number of cores)
+ *
+ * Exit status is 0 if every file of every input was merged, 1 otherwise,
+ * and 1 with nothing merged if an input is not a directory.
+ *
+ **********************************************************************/
+
+#define _XOPEN_SOURCE 700 /* for nftw */
+
+#include <errno.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "gcda_io.h"
+
+/* The .gcda file paths found under the inputs, relative to them */
+static char **names = NULL;
+static size_t nameCount = 0;
+static size_t nameSize = 0;
+static size_t rootLength;           /* of the input being listed, without its '/' */
+
+/* ----------------------------------------------------------- */
+/*
+ * add_name is the nftw callback listing the .gcda files of one input.
+ */
+static int add_name(const char *path, const struct stat *st, int type, struct FTW *ftw)
+{
+    const char *name = path + rootLength;
+    size_t n = strlen(path);
+
+    (void)st; // ignore unused param
+    (void)ftw; // ignore unused param
+
+    if (type != FTW_F || n < 5 || strcmp(path + n - 5, ".gcda") != 0) {
+        return 0;
+    }
+    if (nameCount == nameSize) {
+        size_t size = nameSize ? nameSize * 2 : 256;
+        char **list = realloc(names, size * sizeof(char *));
+
+        if (!list) {
+            return -1;
+        }
+        names = list;
+        nameSize = size;
+    }
+    while (*name == '/') {
+        name++;
+    }
+    names[nameCount] = strdup(name);
+    return names[nameCount++] ? 0 : -1;
+}
+
+static int compare_name(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/*
+ * make_parent_dirs creates the missing directories above path.
+ */
+static void make_parent_dirs(const char *path)
+{
+    char *tmp = strdup(path);
+
+    for (char *p = tmp + 1; p && *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            (void)mkdir(tmp, 0777);
+            *p = '/';
+        }
+    }
+    free(tmp);
+}
+
+/* ----------------------------------------------------------- */
+/* How counters of each type are merged, see gcc/gcov-counter.def */
+typedef enum {
+    MERGE_ADD,
+    MERGE_IOR,
+    MERGE_TIME,     /* earliest first call, 0 for never */
+    MERGE_NONE      /* value profiles, cannot be merged here */
+} MergeKind;
+
+static MergeKind merge_kind(const GcdaInfo *info, unsigned long tag)
+{
+    switch (GCDA_COUNTER_FOR_TAG(tag)) {
+    case 0: /* arcs */
+    case 1: /* interval */
+    case 2: /* pow2 */
+    case 5: /* average */
+        return MERGE_ADD;
+    case 6: /* ior */
+        return MERGE_IOR;
+    case 7: /* time_profiler */
+        return MERGE_TIME;
+    case 8: /* conditions (gcc 14), icall_topn before gcc 10 */
+        return info->major >= 14 ? MERGE_IOR : MERGE_NONE;
+    default: /* single, topn, indirect_call */
+        return MERGE_NONE;
+    }
+}
+
+static int all_zero(const GcdaCounters *c)
+{
+    for (size_t i = 0; i < c->count; i++) {
+        if (c->values[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * merge_info adds the counters of from into total,
+ * which must be from the same build.
+ * Returns 0, or -1 with *why set (and total unchanged).
+ */
+static int merge_info(GcdaInfo *total, const GcdaInfo *from, const char **why)
+{
+    if (from->version != total->version) {
+        *why = "other gcc version";
+        return -1;
+    }
+    if (from->stamp != total->stamp || from->checksum != total->checksum) {
+        *why = "other build (stamp or checksum differs)";
+        return -1;
+    }
+    if (from->functionCount != total->functionCount) {
+        *why = "other functions";
+        return -1;
+    }
+
+    /* Check everything first, so nothing is half merged */
+    for (size_t i = 0; i < total->functionCount; i++) {
+        const GcdaFunction *a = &total->functions[i];
+        const GcdaFunction *b = &from->functions[i];
+
+        if (a->empty != b->empty || a->ident != b->ident ||
+            a->linenoChecksum != b->linenoChecksum || a->cfgChecksum != b->cfgChecksum ||
+            a->counterCount != b->counterCount) {
+            *why = "other functions (ident or checksum differs)";
+            return -1;
+        }
+        for (size_t k = 0; k < a->counterCount; k++) {
+            if (a->counters[k].tag != b->counters[k].tag ||
+                a->counters[k].count != b->counters[k].count) {
+                *why = "other counters";
+                return -1;
+            }
+            if (merge_kind(total, a->counters[k].tag) == MERGE_NONE &&
+                !all_zero(&a->counters[k]) && !all_zero(&b->counters[k])) {
+                *why = "value profile counters cannot be merged";
+                return -1;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < total->functionCount; i++) {
+        GcdaFunction *a = &total->functions[i];
+        const GcdaFunction *b = &from->functions[i];
+
+        for (size_t k = 0; k < a->counterCount; k++) {
+            long long *to = a->counters[k].values;
+            const long long *add = b->counters[k].values;
+            size_t count = a->counters[k].count;
+
+            switch (merge_kind(total, a->counters[k].tag)) {
+            case MERGE_ADD:
+                for (size_t n = 0; n < count; n++) {
+                    to[n] += add[n];
+                }
+                break;
+            case MERGE_IOR:
+                for (size_t n = 0; n < count; n++) {
+                    to[n] |= add[n];
+                }
+                break;
+            case MERGE_TIME:
+                for (size_t n = 0; n < count; n++) {
+                    if (add[n] && (!to[n] || add[n] < to[n])) {
+                        to[n] = add[n];
+                    }
+                }
+                break;
+            default:
+                /* (one side is all zero) */
+                if (all_zero(&a->counters[k])) {
+                    memcpy(to, add, count * sizeof(long long));
+                }
+                break;
+            }
+        }
+    }
+
+    /* As libgcov does for each run */
+    if (from->hasSummary) {
+        total->runs += from->runs;
+        total->sumMax += from->sumMax;
+        total->hasSummary = 1;
+    }
+    return 0;
+}
+
+/* ----------------------------------------------------------- */
+typedef struct {
+    char **inputs;
+    int inputCount;
+    const char *outDir;
+    size_t next;                /* next name to take */
+    unsigned long merged;
+    unsigned long rejected;
+} MergeWork;
+
+static pthread_mutex_t workLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * merge_file merges one .gcda file from every input that has it,
+ * and sets *written if the merged file was written.
+ * Returns the number of input files rejected.
+ */
+static unsigned long merge_file(const MergeWork *work, const char *name, int *written)
+{
+    GcdaInfo total;
+    const char *why = NULL;
+    unsigned long rejected = 0;
+    int have = 0;
+    char path[4096];
+
+    for (int i = 0; i < work->inputCount; i++) {
+        GcdaInfo info;
+
+        snprintf(path, sizeof(path), "%s/%s", work->inputs[i], name);
+        if (access(path, F_OK) != 0) {
+            continue;
+        }
+        if (gcda_read(path, &info, &why) != 0) {
+            fprintf(stderr, "gcda_merge: cannot read %s: %s\n", path, why);
+            rejected++;
+            continue;
+        }
+        if (!have) {
+            total = info;
+            have = 1;
+            continue;
+        }
+        if (merge_info(&total, &info, &why) != 0) {
+            fprintf(stderr, "gcda_merge: not merging %s: %s\n", path, why);
+            rejected++;
+        }
+        gcda_free(&info);
+    }
+
+    if (have) {
+        snprintf(path, sizeof(path), "%s/%s", work->outDir, name);
+        make_parent_dirs(path);
+        if (gcda_write(path, &total) != 0) {
+            fprintf(stderr, "gcda_merge: cannot write %s: %s\n", path, strerror(errno));
+            rejected++;
+        } else {
+            *written = 1;
+        }
+        gcda_free(&total);
+    }
+    return rejected;
+}
+
+static void *merge_files(void *arg)
+{
+    MergeWork *work = arg;
+
+    for (;;) {
+        unsigned long rejected;
+        int written = 0;
+        size_t i;
+
+        pthread_mutex_lock(&workLock);
+        i = work->next++;
+        pthread_mutex_unlock(&workLock);
+        if (i >= nameCount) {
+            break;
+        }
+
+        rejected = merge_file(work, names[i], &written);
+        pthread_mutex_lock(&workLock);
+        work->merged += written;
+        work->rejected += rejected;
+        pthread_mutex_unlock(&workLock);
+    }
+    return NULL;
+}
+
+/* ----------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+    MergeWork work;
+    pthread_t *tids;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int started = 0;
+    int argi = 1;
+    size_t unique = 0;
+
+    memset(&work, 0, sizeof(work));
+    while (argi < argc && argv[argi][0] == '-') {
+        if (strcmp(argv[argi], "-o") == 0 && argi + 1 < argc) {
+            work.outDir = argv[argi + 1];
+            argi += 2;
+        } else if (strcmp(argv[argi], "-j") == 0 && argi + 1 < argc) {
+            threads = atol(argv[argi + 1]);
+            argi += 2;
+        } else {
+            argi = argc;
+        }
+    }
+    if (!work.outDir || argi >= argc) {
+        fprintf(stderr, "usage: gcda_merge -o outdir [-j threads] inputdir ...\n");
+        return 2;
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+    work.inputs = argv + argi;
+    work.inputCount = argc - argi;
+
+    /* Inputs are directories of .gcda files, not the files themselves */
+    for (int i = 0; i < work.inputCount; i++) {
+        struct stat st;
+
+        if (stat(work.inputs[i], &st) != 0) {
+            fprintf(stderr, "gcda_merge: cannot read %s: %s\n", work.inputs[i], strerror(errno));
+            return 1;
+        }
+        if (!S_ISDIR(st.st_mode)) {
+            fprintf(stderr, "gcda_merge: %s is not a directory of .gcda files\n", work.inputs[i]);
+            return 1;
+        }
+    }
+
+    /* Every .gcda path under any input, once */
+    for (int i = 0; i < work.inputCount; i++) {
+        rootLength = strlen(work.inputs[i]);
+        if (nftw(work.inputs[i], add_name, 16, FTW_PHYS) != 0) {
+            fprintf(stderr, "gcda_merge: cannot list %s: %s\n", work.inputs[i], strerror(errno));
+            return 1;
+        }
+    }
+    qsort(names, nameCount, sizeof(char *), compare_name);
+    for (size_t i = 0; i < nameCount; i++) {
+        if (unique && strcmp(names[unique - 1], names[i]) == 0) {
+            free(names[i]);
+        } else {
+            names[unique++] = names[i];
+        }
+    }
+    nameCount = unique;
+
+    (void)mkdir(work.outDir, 0777);
+    tids = malloc((size_t)threads * sizeof(pthread_t));
+    for (; tids && started < threads && (size_t)started < nameCount; started++) {
+        if (pthread_create(&tids[started], NULL, merge_files, &work) != 0) {
+            break;
+        }
+    }
+    if (started == 0) {
+        (void)merge_files(&work);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    free(tids);
+
+    fprintf(stderr, "gcda_merge: %lu files merged from %d inputs, %lu input files rejected\n",
+            work.merged, work.inputCount, work.rejected);
+
+    for (size_t i = 0; i < nameCount; i++) {
+        free(names[i]);
+    }
+    free(names);
+    return work.rejected ? 1 : 0;
+}
+
+/** @}
+ */
+/*
+ * embedded-gcov gcda_merge.c host tool to merge gcda files of many runs
+ *
+ * Copyright (c) 2021 California Institute of Technology (“Caltech”).
+ * U.S. Government sponsorship acknowledged.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *        this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *        this list of conditions and the following disclaimer in the documentation
+ *        and/or other materials provided with the distribution.
+ *    Neither the name of Caltech nor its operating division, the Jet Propulsion Laboratory,
+ *        nor the names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
@@ -0,0 +1,1858 @@
+/**********************************************************************/
+/** @addtogroup embedded_gcov
+ * @{
+ * @file
+ * @version $Id: $
+ *
+ * @brief Host tool to turn embedded gcov output into .gcda files.
+ *
+ * Typical usage: ./gcov_decode -d ../objs ../test01_serial_log.txt
+ *
+ * Reads a serial log captured from a target built with
+ * GCOV_OPT_OUTPUT_SERIAL_FRAMED, finds the COBS frames in it
+ * (any console text around them is skipped), checks each frame's
+ * CRC and sequence number, and writes one .gcda file per file
+ * in the dump. A file with a lost or damaged frame is reported
+ * and not written, rather than written with bad data.
+ *
+ * Files packed or compressed on the target (GCOV_OPT_TRANSFER_PACKED,
+ * GCOV_OPT_TRANSFER_LZ) are expanded back into plain .gcda data.
+ * Files sent as hit bitmaps (GCOV_OPT_TRANSFER_HITS) get a count
+ * of 1 for each counter that was hit, 0 for the rest.
+ *
+ * Files from delta dumps (GCOV_OPT_DELTA_DUMP) hold only the functions
+ * that changed; their records replace those in the .gcda file
+ * written from an earlier dump. Give all the logs since the target
+ * started, in order, so every delta is applied to the right file.
+ *
+ * Typical usage: ./gcov_decode -d ../objs ../soak_log_1.txt ../soak_log_2.txt
+ *
+ * Files from test dumps (GCOV_OPT_TEST_CAPTURE) are written into
+ * a directory for each test, test_<id>, in the -d directory
+ * (or next to the full pathname), for tools/gcov_matrix.
+ *
+ * Typical usage: ./gcov_decode -b -d ../objs ../gcov_output.bin
+ *
+ * Reads the output file of GCOV_OPT_OUTPUT_BINARY_FILE, or a memory
+ * dump of the GCOV_OPT_OUTPUT_BINARY_MEMORY buffer (more memory
+ * around it is skipped), and writes one .gcda file per file in it.
+ * The dumps are mapped rather than read, so they can be larger than
+ * memory, and the files are written by one thread per core.
+ * Byte counts from versions that wrote the third byte as count / 255
+ * are recognized and corrected. Give several dumps in order for
+ * delta dumps, as for serial logs.
+ *
+ * Typical usage: ./gcov_decode -u ../objs/example-example.gcda
+ *
+ * Expands, in place, .gcda files that are still packed,
+ * such as those from the hexdump output after xxd -r.
+ * Files that are not packed are left alone.
+ * (Delta dumps cannot be expanded this way.)
+ *
+ * Options:
+ *   -d dir   write each .gcda file into dir, using only the
+ *            basename of the filename in the dump
+ *            (default is the full pathname in the dump)
+ *   -b       read binary dumps instead of serial logs
+ *   -j n     write with up to n threads (-b only,
+ *            default is the number of cores)
+ *   -u       expand the packed files named on the command line
+ *
+ * Exit status is 0 if every file was written (and no delta
+ * was applied to the wrong base), 1 otherwise.
+ *
+ **********************************************************************/
+
+#define _GNU_SOURCE /* for memmem */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "../code/gcov_format.h"
+
+static const char *outDir = NULL;
+
+/* Output path of each file, and the dump generation it was last written from */
+typedef struct {
+    char *path;
+    int written;                /* by a dump with a generation number */
+    unsigned long generation;
+} FileGeneration;
+static FileGeneration *generations = NULL;
+static size_t generationCount = 0;
+static size_t generationSize = 0;       /* entries allocated */
+
+/* Hash index of generations by path: entry + 1, or 0 for a free slot */
+static size_t *generationIndex = NULL;
+static size_t indexSize = 0;            /* a power of 2 */
+
+/* Deltas applied to a file that missed an earlier update */
+static unsigned long staleFiles = 0;
+
+/* Guards the counts above while binary dumps are written in parallel */
+static pthread_mutex_t countLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* ----------------------------------------------------------- */
+/*
+ * read_file reads a whole file into a malloc'd buffer.
+ */
+static unsigned char *read_file(const char *path, size_t *length)
+{
+    FILE *f = fopen(path, "rb");
+    unsigned char *buf = NULL;
+    size_t size = 0;
+    size_t used = 0;
+
+    if (!f) {
+        fprintf(stderr, "gcov_decode: cannot open %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    for (;;) {
+        if (used == size) {
+            size = size ? size * 2 : 65536;
+            buf = realloc(buf, size);
+            if (!buf) {
+                fprintf(stderr, "gcov_decode: out of memory\n");
+                fclose(f);
+                return NULL;
+            }
+        }
+        size_t n = fread(buf + used, 1, size - used, f);
+        if (n == 0) {
+            break;
+        }
+        used += n;
+    }
+    fclose(f);
+    *length = used;
+    return buf;
+}
+
+/* ----------------------------------------------------------- */
+/*
+ * make_parent_dirs creates the missing directories above path.
+ */
+static void make_parent_dirs(const char *path)
+{
+    char *tmp = strdup(path);
+
+    for (char *p = tmp + 1; p && *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            (void)mkdir(tmp, 0777);
+            *p = '/';
+        }
+    }
+    free(tmp);
+}
+
+/*
+ * output_path gives where a file from the dump is written,
+ * either at its full pathname or by basename into the -d directory.
+ * A file from a test dump goes into a testDir directory there
+ * (or next to its full pathname), testDir NULL for other files.
+ * Returns 0, or -1 if the pathname does not fit in size bytes.
+ */
+static int output_path(const char *filename, const char *testDir, char *path, size_t size)
+{
+    const char *base = strrchr(filename, '/');
+    int n;
+
+    if (outDir && testDir) {
+        n = snprintf(path, size, "%s/%s/%s", outDir, testDir, base ? base + 1 : filename);
+    } else if (outDir) {
+        n = snprintf(path, size, "%s/%s", outDir, base ? base + 1 : filename);
+    } else if (testDir) {
+        n = snprintf(path, size, "%.*s%s/%s", base ? (int)(base + 1 - filename) : 0, filename,
+                     testDir, base ? base + 1 : filename);
+    } else {
+        n = snprintf(path, size, "%s", filename);
+    }
+    if (n < 0 || n >= (int)size) {
+        fprintf(stderr, "gcov_decode: pathname too long for %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * write_gcda writes one .gcda file, see output_path.
+ */
+static int write_gcda(const char *filename, const char *testDir,
+                      const unsigned char *data, size_t length)
+{
+    char path[4096];
+    FILE *f;
+
+    if (output_path(filename, testDir, path, sizeof(path)) != 0) {
+        return -1;
+    }
+
+    make_parent_dirs(path);
+    f = fopen(path, "wb");
+    if (!f || fwrite(data, 1, length, f) != length) {
+        fprintf(stderr, "gcov_decode: cannot write %s: %s\n", path, strerror(errno));
+        if (f) {
+            fclose(f);
+        }
+        return -1;
+    }
+    fclose(f);
+    return 0;
+}
+
+/* ----------------------------------------------------------- */
+/*
+ * crc32 matches the target code in gcov_public.c (and zlib).
+ */
+static unsigned long crc32(const unsigned char *p, size_t length)
+{
+    unsigned long crc = 0xFFFFFFFFUL;
+
+    for (size_t i = 0; i < length; i++) {
+        crc ^= p[i];
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? GCOV_FRAME_CRC_POLY : 0);
+        }
+    }
+    return ~crc & 0xFFFFFFFFUL;
+}
+
+/*
+ * cobs_decode decodes one frame (without delimiters) into out,
+ * which must hold at least length bytes.
+ * Returns the decoded length, or -1 if the frame is not valid COBS.
+ */
+static long cobs_decode(const unsigned char *in, size_t length, unsigned char *out)
+{
+    size_t i = 0;
+    size_t n = 0;
+
+    while (i < length) {
+        unsigned code = in[i++];
+
+        if (code == 0 || i + code - 1 > length) {
+            return -1;
+        }
+        for (unsigned k = 1; k < code; k++) {
+            out[n++] = in[i++];
+        }
+        if (code < 0xFF && i < length) {
+            out[n++] = 0;
+        }
+    }
+    return (long)n;
+}
+
+/* ----------------------------------------------------------- */
+/*
+ * is_transfer tells whether data starts like transfer encoded data.
+ */
+static int is_transfer(const unsigned char *data, size_t length)
+{
+    return length >= 4 &&
+           (((unsigned long)data[0] << 24) | ((unsigned long)data[1] << 16) |
+            ((unsigned long)data[2] << 8) | data[3]) == GCOV_TRANSFER_MAGIC;
+}
+
+/*
+ * read_token reads one packed transfer token at *pos.
+ * Returns 0, or -1 if the data ends inside the token or it is too long.
+ */
+static int read_token(const unsigned char *data, size_t length, size_t *pos,
+                      unsigned long long *token)
+{
+    unsigned long long v = 0;
+
+    for (int shift = 0; shift < 7 * GCOV_TRANSFER_TOKEN_MAX; shift += 7) {
+        if (*pos >= length) {
+            return -1;
+        }
+        unsigned char byte = data[(*pos)++];
+
+        v |= (unsigned long long)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *token = v;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ * read_header_word reads one header token, which must be of kind WORD.
+ */
+static int read_header_word(const unsigned char *data, size_t length, size_t *pos,
+                            unsigned long *value)
+{
+    unsigned long long token;
+
+    if (read_token(data, length, pos, &token) || (token & 3) != GCOV_TRANSFER_WORD) {
+        return -1;
+    }
+    *value = (unsigned long)(token >> GCOV_TRANSFER_KIND_BITS);
+    return 0;
+}
+
+/*
+ * lz_expand expands LZ compressed transfer data into a malloc'd buffer.
+ * Returns the buffer, or NULL with *why set if the data is bad.
+ */
+static unsigned char *lz_expand(const unsigned char *data, size_t length,
+                                size_t *outLength, const char **why)
+{
+    size_t size = length * 4 + 64;
+    unsigned char *out = malloc(size);
+    size_t pos = 0;
+    size_t used = 0;
+
+    while (out && pos < length) {
+        unsigned flags = data[pos++];
+
+        for (int bit = 0; bit < 8 && pos < length; bit++) {
+            /* A match makes at most GCOV_TRANSFER_LZ_MAX_MATCH bytes */
+            if (used + GCOV_TRANSFER_LZ_MAX_MATCH > size) {
+                unsigned char *bigger = realloc(out, size * 2);
+
+                if (!bigger) {
+                    free(out);
+                    out = NULL;
+                    break;
+                }
+                out = bigger;
+                size *= 2;
+            }
+            if (!(flags & (1u << bit))) {
+                out[used++] = data[pos++];
+                continue;
+            }
+            if (length - pos < 2) {
+                *why = "LZ data ends inside a match";
+                free(out);
+                return NULL;
+            }
+
+            unsigned v = ((unsigned)data[pos] << 8) | data[pos + 1];
+            size_t count = (v >> 12) + GCOV_TRANSFER_LZ_MIN_MATCH;
+            size_t offset = (v & 0xFFF) + 1;
+
+            pos += 2;
+            if (offset > used) {
+                *why = "LZ match before the start of the data";
+                free(out);
+                return NULL;
+            }
+            while (count--) {
+                out[used] = out[used - offset];
+                used++;
+            }
+        }
+    }
+    if (!out) {
+        *why = "out of memory";
+        return NULL;
+    }
+
+    *outLength = used;
+    return out;
+}
+
+/* What the transfer header of a file says */
+typedef struct {
+    unsigned long flags;      /* GCOV_TRANSFER_* */
+    unsigned long generation; /* dump generation, with GCOV_TRANSFER_GENERATION */
+    unsigned long base;       /* base generation, with GCOV_TRANSFER_DELTA */
+    unsigned long test;       /* test id, with GCOV_TRANSFER_TEST */
+} TransferHeader;
+
+/*
+ * read_transfer_header reads the header tokens after the magic,
+ * up to and including the gcda data byte count.
+ * Returns 0, or -1 if they are bad.
+ */
+static int read_transfer_header(const unsigned char *data, size_t length, size_t *pos,
+                                TransferHeader *header, unsigned long *total)
+{
+    memset(header, 0, sizeof(*header));
+    if (read_header_word(data, length, pos, &header->flags) ||
+        ((header->flags & GCOV_TRANSFER_GENERATION) &&
+         read_header_word(data, length, pos, &header->generation)) ||
+        ((header->flags & GCOV_TRANSFER_DELTA) &&
+         read_header_word(data, length, pos, &header->base)) ||
+        ((header->flags & GCOV_TRANSFER_TEST) &&
+         read_header_word(data, length, pos, &header->test)) ||
+        read_header_word(data, length, pos, total)) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * unpack_transfer turns transfer encoded data into a malloc'd
+ * buffer of gcda data, still with hit bitmaps if the HITS flag
+ * is set, see gcov_format.h.
+ * Returns the buffer, or NULL with *why set if the data is bad.
+ */
+static unsigned char *unpack_transfer(const unsigned char *data, size_t length,
+                                      TransferHeader *header, size_t *outLength,
+                                      const char **why)
+{
+    unsigned int recent[GCOV_TRANSFER_RECENT_WORDS];
+    unsigned long long token;
+    unsigned long total;
+    unsigned char *out;
+    unsigned char *expanded = NULL;
+    size_t pos = 4;
+    size_t used = 0;
+
+    if (read_transfer_header(data, length, &pos, header, &total)) {
+        *why = "bad transfer header";
+        return NULL;
+    }
+    if ((header->flags & ~(unsigned long)(GCOV_TRANSFER_PACKED | GCOV_TRANSFER_GENERATION |
+                                          GCOV_TRANSFER_DELTA | GCOV_TRANSFER_LZ |
+                                          GCOV_TRANSFER_TEST | GCOV_TRANSFER_HITS)) ||
+        total % 4) {
+        *why = "unknown transfer flags";
+        return NULL;
+    }
+
+    if (header->flags & GCOV_TRANSFER_LZ) {
+        /* Expand the rest, then read on from there */
+        size_t expandedLength = 0;
+
+        expanded = lz_expand(data + pos, length - pos, &expandedLength, why);
+        if (!expanded) {
+            return NULL;
+        }
+        data = expanded;
+        length = expandedLength;
+        pos = 0;
+    }
+
+    out = malloc(total ? total : 1);
+    if (!out) {
+        *why = "out of memory";
+        free(expanded);
+        return NULL;
+    }
+
+    if (!(header->flags & GCOV_TRANSFER_PACKED)) {
+        /* The gcda data follows as is */
+        if (length - pos != total) {
+            *why = "wrong transfer data length";
+            free(out);
+            free(expanded);
+            return NULL;
+        }
+        memcpy(out, data + pos, total);
+        free(expanded);
+        *outLength = total;
+        return out;
+    }
+
+    memset(recent, 0, sizeof(recent));
+
+    while (used < total) {
+        unsigned long long count = 1;
+        unsigned long long value;
+        unsigned int word = 0;
+        unsigned int i;
+
+        if (read_token(data, length, &pos, &token)) {
+            *why = "packed data ends early";
+            free(out);
+            free(expanded);
+            return NULL;
+        }
+        value = token >> GCOV_TRANSFER_KIND_BITS;
+
+        switch (token & 3) {
+        case GCOV_TRANSFER_WORD:
+            word = (unsigned int)value;
+            if (word >= GCOV_TRANSFER_RECENT_MIN) {
+                memmove(recent + 1, recent, sizeof(recent) - sizeof(recent[0]));
+                recent[0] = word;
+            }
+            break;
+        case GCOV_TRANSFER_ZEROS:
+            count = value + 1;
+            break;
+        case GCOV_TRANSFER_NEGATED:
+            word = 0u - (unsigned int)value;
+            break;
+        default: /* GCOV_TRANSFER_RECENT */
+            if (value >= GCOV_TRANSFER_RECENT_WORDS) {
+                *why = "bad recent word";
+                free(out);
+                free(expanded);
+                return NULL;
+            }
+            i = (unsigned int)value;
+            word = recent[i];
+            memmove(recent + 1, recent, i * sizeof(recent[0]));
+            recent[0] = word;
+            break;
+        }
+
+        if (count > (total - used) / 4) {
+            *why = "packed data too long";
+            free(out);
+            free(expanded);
+            return NULL;
+        }
+        while (count--) {
+            memcpy(out + used, &word, 4);
+            used += 4;
+        }
+    }
+    if (pos != length) {
+        *why = "extra bytes after packed data";
+        free(out);
+        free(expanded);
+        return NULL;
+    }
+
+    free(expanded);
+    *outLength = used;
+    return out;
+}
+
+/*
+ * token_words gives the number of gcda words a packed token makes.
+ */
+static unsigned long long token_words(unsigned long long token)
+{
+    return (token & 3) == GCOV_TRANSFER_ZEROS ? (token >> GCOV_TRANSFER_KIND_BITS) + 1 : 1;
+}
+
+/*
+ * transfer_extent finds where transfer encoded data ends, for
+ * the outputs that do not say (the binary outputs only give the
+ * expanded byte count). Packed tokens are counted, and LZ data is
+ * expanded just far enough to hold all the gcda data.
+ * Returns 0 with *extent set, or -1 if the data is bad.
+ */
+static int transfer_extent(const unsigned char *data, size_t length, size_t *extent)
+{
+    TransferHeader header;
+    unsigned long total;
+    unsigned long long token = 0;
+    unsigned long long words = 0;
+    unsigned char *out = NULL;
+    size_t size = 0;
+    size_t used = 0;
+    size_t counted = 0;     /* LZ output bytes already in words */
+    int shift = 0;
+    size_t pos = 4;
+
+    if (read_transfer_header(data, length, &pos, &header, &total) || total % 4) {
+        return -1;
+    }
+
+    if (!(header.flags & GCOV_TRANSFER_LZ)) {
+        if (!(header.flags & GCOV_TRANSFER_PACKED)) {
+            if (length - pos < total) {
+                return -1;
+            }
+            *extent = pos + total;
+            return 0;
+        }
+        while (words * 4 < total) {
+            if (read_token(data, length, &pos, &token)) {
+                return -1;
+            }
+            words += token_words(token);
+        }
+        *extent = pos;
+        return 0;
+    }
+
+    /* LZ: the data ends after the item that completes the gcda data */
+    for (unsigned flags = 0, bit = 8; ; bit++) {
+        if (header.flags & GCOV_TRANSFER_PACKED) {
+            for (; counted < used; counted++) {
+                token |= (unsigned long long)(out[counted] & 0x7F) << shift;
+                if (out[counted] & 0x80) {
+                    shift += 7;
+                    continue;
+                }
+                words += token_words(token);
+                token = 0;
+                shift = 0;
+            }
+        } else {
+            words = used / 4;
+        }
+        if (words * 4 >= total) {
+            free(out);
+            *extent = pos;
+            return 0;
+        }
+
+        if (bit == 8) {
+            if (pos >= length) {
+                break;
+            }
+            flags = data[pos++];
+            bit = 0;
+        }
+        if (pos >= length || shift >= 7 * GCOV_TRANSFER_TOKEN_MAX) {
+            break;
+        }
+        if (used + GCOV_TRANSFER_LZ_MAX_MATCH > size) {
+            unsigned char *bigger = realloc(out, size ? size * 2 : 4096);
+
+            if (!bigger) {
+                break;
+            }
+            out = bigger;
+            size = size ? size * 2 : 4096;
+        }
+
+        if (!(flags & (1u << bit))) {
+            out[used++] = data[pos++];
+        } else {
+            unsigned v;
+            size_t count;
+            size_t offset;
+
+            if (length - pos < 2) {
+                break;
+            }
+            v = ((unsigned)data[pos] << 8) | data[pos + 1];
+            count = (v >> 12) + GCOV_TRANSFER_LZ_MIN_MATCH;
+            offset = (v & 0xFFF) + 1;
+            pos += 2;
+            if (offset > used) {
+                break;
+            }
+            while (count--) {
+                out[used] = out[used - offset];
+                used++;
+            }
+        }
+    }
+    free(out);
+    return -1;
+}
+
+/* ----------------------------------------------------------- */
+/* gcda layout, as much as deltas and hit bitmaps need */
+#define GCDA_MAGIC          0x67636461UL    /* "gcda" */
+#define GCDA_TAG_FUNCTION   0x01000000UL
+#define GCDA_TAG_COUNTER_BASE 0x01a10000UL
+#define GCDA_TAG_IS_COUNTER(tag) ((tag) >= GCDA_TAG_COUNTER_BASE && \
+                                  !(((tag) - GCDA_TAG_COUNTER_BASE) & ~0x1e0000UL))
+
+/* One function's records in gcda data: function record and its counters */
+typedef struct {
+    size_t start;           /* byte offsets in the data */
+    size_t end;
+    int hasIdent;           /* not an empty function record */
+    unsigned long ident;
+    int used;               /* (delta block) already merged */
+} GcdaBlock;
+
+typedef struct {
+    const unsigned char *data;
+    size_t length;
+    int swap;               /* data is in the other byte order */
+    int byteLengths;        /* record lengths in bytes (gcc 12 and later) */
+    size_t prefix;          /* bytes before the first function record */
+    GcdaBlock *blocks;
+    size_t count;
+} GcdaData;
+
+static unsigned long gcda_word(const GcdaData *gcda, size_t pos)
+{
+    unsigned int w;
+
+    memcpy(&w, gcda->data + pos, 4);
+    if (gcda->swap) {
+        w = (w >> 24) | ((w >> 8) & 0xff00) | ((w << 8) & 0xff0000) | (w << 24);
+    }
+    return w;
+}
+
+/*
+ * gcda_parse splits gcda data into its header and function blocks.
+ * Returns 0, or -1 if the data is not gcda data we can follow.
+ */
+static int gcda_parse(GcdaData *gcda, const unsigned char *data, size_t length)
+{
+    unsigned long version;
+    int major;
+    size_t pos;
+
+    memset(gcda, 0, sizeof(*gcda));
+    gcda->data = data;
+    gcda->length = length;
+    if (length < 12 || length % 4) {
+        return -1;
+    }
+    if (gcda_word(gcda, 0) != GCDA_MAGIC) {
+        gcda->swap = 1;
+        if (gcda_word(gcda, 0) != GCDA_MAGIC) {
+            return -1;
+        }
+    }
+
+    /* Version is like "B22*" for gcc 12.2, "A93*" for gcc 9.3 */
+    version = gcda_word(gcda, 4);
+    major = (int)((version >> 24) & 0xff) - 'A';
+    major = major * 10 + (int)((version >> 16) & 0xff) - '0';
+    gcda->byteLengths = (major >= 12);
+
+    /* magic, version, stamp, and checksum for gcc 12 and later */
+    pos = gcda->byteLengths ? 16 : 12;
+    gcda->prefix = pos;
+
+    while (pos < length) {
+        unsigned long tag;
+        long recordLength;
+        size_t dataBytes;
+
+        if (length - pos < 8) {
+            free(gcda->blocks);
+            return -1;
+        }
+        tag = gcda_word(gcda, pos);
+        recordLength = (long)(int)gcda_word(gcda, pos + 4);
+        /* (negative is an all-zero counter array, with no values) */
+        dataBytes = recordLength < 0 ? 0 :
+                    (size_t)recordLength * (gcda->byteLengths ? 1 : 4);
+        if (dataBytes > length - pos - 8) {
+            free(gcda->blocks);
+            return -1;
+        }
+
+        if (tag == GCDA_TAG_FUNCTION) {
+            GcdaBlock *blocks = realloc(gcda->blocks, (gcda->count + 1) * sizeof(GcdaBlock));
+
+            if (!blocks) {
+                free(gcda->blocks);
+                return -1;
+            }
+            gcda->blocks = blocks;
+            memset(&blocks[gcda->count], 0, sizeof(GcdaBlock));
+            blocks[gcda->count].start = pos;
+            blocks[gcda->count].hasIdent = (dataBytes >= 4);
+            blocks[gcda->count].ident = dataBytes >= 4 ? gcda_word(gcda, pos + 8) : 0;
+            gcda->count++;
+        } else if (gcda->count == 0) {
+            /* such as an object summary */
+            gcda->prefix = pos + 8 + dataBytes;
+        }
+        pos += 8 + dataBytes;
+        if (gcda->count) {
+            gcda->blocks[gcda->count - 1].end = pos;
+        }
+    }
+    return 0;
+}
+
+static void gcda_put_word(const GcdaData *gcda, unsigned char *out, unsigned long word)
+{
+    unsigned int w = (unsigned int)word;
+
+    if (gcda->swap) {
+        w = (w >> 24) | ((w >> 8) & 0xff00) | ((w << 8) & 0xff0000) | (w << 24);
+    }
+    memcpy(out, &w, 4);
+}
+
+/*
+ * expand_hits turns gcda data with hit bitmaps (GCOV_TRANSFER_HITS)
+ * into a malloc'd buffer of plain gcda data, each counter value
+ * 1 if its bit is set, else 0.
+ * Returns the buffer, or NULL with *why set if the data is bad.
+ */
+static unsigned char *expand_hits(const unsigned char *data, size_t length,
+                                  size_t *outLength, const char **why)
+{
+    GcdaData gcda;
+    unsigned long version;
+    int major;
+    unsigned char *out;
+    size_t size;
+    size_t used;
+    size_t pos;
+
+    /* Same header checks as gcda_parse(), whose record walk needs plain data */
+    memset(&gcda, 0, sizeof(gcda));
+    gcda.data = data;
+    gcda.length = length;
+    if (length < 12 || length % 4) {
+        *why = "hit data is not gcda data";
+        return NULL;
+    }
+    if (gcda_word(&gcda, 0) != GCDA_MAGIC) {
+        gcda.swap = 1;
+        if (gcda_word(&gcda, 0) != GCDA_MAGIC) {
+            *why = "hit data is not gcda data";
+            return NULL;
+        }
+    }
+    version = gcda_word(&gcda, 4);
+    major = (int)((version >> 24) & 0xff) - 'A';
+    major = major * 10 + (int)((version >> 16) & 0xff) - '0';
+    gcda.byteLengths = (major >= 12);
+
+    pos = gcda.byteLengths ? 16 : 12;
+    if (pos > length) {
+        *why = "hit data is not gcda data";
+        return NULL;
+    }
+
+    /* A bitmap word becomes up to 32 values of 2 words each */
+    size = length * 64;
+    out = malloc(size);
+    if (!out) {
+        *why = "out of memory";
+        return NULL;
+    }
+    memcpy(out, data, pos);
+    used = pos;
+
+    while (pos < length) {
+        unsigned long tag;
+        long recordLength;
+        size_t dataBytes;
+        size_t sentBytes;
+        int hits;
+
+        if (length - pos < 8) {
+            break;
+        }
+        tag = gcda_word(&gcda, pos);
+        recordLength = (long)(int)gcda_word(&gcda, pos + 4);
+        dataBytes = recordLength < 0 ? 0 :
+                    (size_t)recordLength * (gcda.byteLengths ? 1 : 4);
+        hits = GCDA_TAG_IS_COUNTER(tag);
+        if (hits && major >= 11) {
+            /* top N value and indirect call profiles are sent as they are */
+            unsigned long type = (tag - GCDA_TAG_COUNTER_BASE) >> 17;
+
+            hits = (type != 3 && type != 4);
+        }
+        sentBytes = hits ? GCOV_TRANSFER_HIT_WORDS(dataBytes / 8) * 4 : dataBytes;
+        if (sentBytes > length - pos - 8 || dataBytes > size - used - 8) {
+            break;
+        }
+        memcpy(out + used, data + pos, 8);
+        used += 8;
+        pos += 8;
+
+        if (hits) {
+            size_t count = dataBytes / 8;
+            size_t i;
+
+            for (i = 0; i < count; i++) {
+                unsigned long bits = gcda_word(&gcda, pos + i / 32 * 4);
+
+                gcda_put_word(&gcda, out + used, (bits >> (i % 32)) & 1);
+                gcda_put_word(&gcda, out + used + 4, 0);
+                used += 8;
+            }
+        } else {
+            memcpy(out + used, data + pos, dataBytes);
+            used += dataBytes;
+        }
+        pos += sentBytes;
+    }
+    if (pos != length) {
+        *why = "bad hit data record";
+        free(out);
+        return NULL;
+    }
+
+    *outLength = used;
+    return out;
+}
+
+/*
+ * decode_transfer turns transfer encoded data into a malloc'd
+ * buffer of gcda data, see gcov_format.h.
+ * Returns the buffer, or NULL with *why set if the data is bad.
+ */
+static unsigned char *decode_transfer(const unsigned char *data, size_t length,
+                                      TransferHeader *header, size_t *outLength,
+                                      const char **why)
+{
+    unsigned char *gcda = unpack_transfer(data, length, header, outLength, why);
+    unsigned char *expanded;
+
+    if (!gcda || !(header->flags & GCOV_TRANSFER_HITS)) {
+        return gcda;
+    }
+    expanded = expand_hits(gcda, *outLength, outLength, why);
+    free(gcda);
+    return expanded;
+}
+
+/*
+ * apply_delta puts the function blocks of delta in place of
+ * those with the same ident in base, into a malloc'd buffer.
+ * Blocks of functions not in base are added at the end.
+ * Returns the buffer, or NULL with *why set.
+ */
+static unsigned char *apply_delta(const char *path,
+                                  const unsigned char *base, size_t baseLength,
+                                  const unsigned char *delta, size_t deltaLength,
+                                  size_t *outLength, const char **why)
+{
+    GcdaData b;
+    GcdaData d;
+    unsigned char *out;
+    size_t used;
+
+    if (gcda_parse(&b, base, baseLength) != 0) {
+        *why = "earlier file is not gcda data";
+        return NULL;
+    }
+    if (gcda_parse(&d, delta, deltaLength) != 0) {
+        *why = "delta is not gcda data";
+        free(b.blocks);
+        return NULL;
+    }
+    if (b.swap != d.swap || b.byteLengths != d.byteLengths) {
+        *why = "delta does not match the earlier file";
+        free(b.blocks);
+        free(d.blocks);
+        return NULL;
+    }
+
+    out = malloc(baseLength + deltaLength);
+    if (!out) {
+        *why = "out of memory";
+        free(b.blocks);
+        free(d.blocks);
+        return NULL;
+    }
+
+    /* The header (and stamp) of the newer data */
+    memcpy(out, delta, d.prefix);
+    used = d.prefix;
+
+    for (size_t i = 0; i < b.count; i++) {
+        const GcdaBlock *from = &b.blocks[i];
+        const unsigned char *src = base;
+
+        for (size_t k = 0; from->hasIdent && k < d.count; k++) {
+            if (d.blocks[k].hasIdent && !d.blocks[k].used &&
+                d.blocks[k].ident == from->ident) {
+                d.blocks[k].used = 1;
+                from = &d.blocks[k];
+                src = delta;
+                break;
+            }
+        }
+        memcpy(out + used, src + from->start, from->end - from->start);
+        used += from->end - from->start;
+    }
+
+    for (size_t k = 0; k < d.count; k++) {
+        if (!d.blocks[k].used) {
+            fprintf(stderr, "gcov_decode: %s: function %lu not in the earlier file, added\n",
+                    path, d.blocks[k].ident);
+            memcpy(out + used, delta + d.blocks[k].start, d.blocks[k].end - d.blocks[k].start);
+            used += d.blocks[k].end - d.blocks[k].start;
+        }
+    }
+
+    free(b.blocks);
+    free(d.blocks);
+    *outLength = used;
+    return out;
+}
+
+/*
+ * path_slot gives the index slot of path: its entry,
+ * or the free slot where it would go.
+ */
+static size_t path_slot(const char *path)
+{
+    unsigned long hash = 2166136261UL;
+    size_t slot;
+
+    for (const char *p = path; *p; p++) {
+        hash = ((hash ^ (unsigned char)*p) * 16777619UL) & 0xFFFFFFFFUL;
+    }
+    slot = hash & (indexSize - 1);
+    while (generationIndex[slot] &&
+           strcmp(generations[generationIndex[slot] - 1].path, path) != 0) {
+        slot = (slot + 1) & (indexSize - 1);
+    }
+    return slot;
+}
+
+/*
+ * find_generation finds the entry for an output path,
+ * adding one (not yet written) if needed.
+ * Entries are only added from the main thread.
+ */
+static FileGeneration *find_generation(const char *path)
+{
+    size_t slot;
+
+    if (indexSize) {
+        slot = path_slot(path);
+        if (generationIndex[slot]) {
+            return &generations[generationIndex[slot] - 1];
+        }
+    }
+
+    if (generationCount == generationSize) {
+        size_t size = generationSize ? generationSize * 2 : 64;
+        FileGeneration *list = realloc(generations, size * sizeof(FileGeneration));
+
+        if (!list) {
+            return NULL;
+        }
+        generations = list;
+        generationSize = size;
+    }
+    /* Keep the index at most half full */
+    if ((generationCount + 1) * 2 > indexSize) {
+        size_t *old = generationIndex;
+        size_t size = indexSize ? indexSize * 2 : 128;
+
+        generationIndex = calloc(size, sizeof(size_t));
+        if (!generationIndex) {
+            generationIndex = old;
+            return NULL;
+        }
+        indexSize = size;
+        for (size_t i = 0; i < generationCount; i++) {
+            generationIndex[path_slot(generations[i].path)] = i + 1;
+        }
+        free(old);
+    }
+
+    generations[generationCount].path = strdup(path);
+    generations[generationCount].written = 0;
+    generations[generationCount].generation = 0;
+    if (!generations[generationCount].path) {
+        return NULL;
+    }
+    generationIndex[path_slot(path)] = generationCount + 1;
+    return &generations[generationCount++];
+}
+
+/*
+ * write_transfer writes the gcda data of one file that was
+ * transfer encoded, applying it to the earlier file if it is a delta.
+ * Returns 0, or -1 with *why set.
+ */
+static int write_transfer(const char *filename, const unsigned char *gcda, size_t length,
+                          const TransferHeader *header, const char **why)
+{
+    char path[4096];
+    char testName[32];
+    const char *testDir = NULL;
+    FileGeneration *entry;
+    unsigned char *base;
+    unsigned char *merged;
+    size_t baseLength;
+    size_t mergedLength = 0;
+
+    if (header->flags & GCOV_TRANSFER_TEST) {
+        snprintf(testName, sizeof(testName), "test_%lu", header->test);
+        testDir = testName;
+    }
+
+    /* (test dumps are always whole, there is no delta to apply) */
+    if (!(header->flags & GCOV_TRANSFER_GENERATION) || testDir) {
+        if (write_gcda(filename, testDir, gcda, length) != 0) {
+            *why = "cannot write file";
+            return -1;
+        }
+        return 0;
+    }
+
+    if (output_path(filename, testDir, path, sizeof(path)) != 0) {
+        *why = "pathname too long";
+        return -1;
+    }
+    entry = find_generation(path);
+    if (!entry) {
+        *why = "out of memory";
+        return -1;
+    }
+
+    if (!(header->flags & GCOV_TRANSFER_DELTA)) {
+        if (write_gcda(filename, testDir, gcda, length) != 0) {
+            *why = "cannot write file";
+            return -1;
+        }
+        entry->written = 1;
+        entry->generation = header->generation;
+        return 0;
+    }
+
+    if (!entry->written) {
+        fprintf(stderr, "gcov_decode: %s: no full dump in these logs, "
+                        "applying the delta from dump %lu to the file as it is\n",
+                path, header->generation);
+    } else if (entry->generation != header->base) {
+        fprintf(stderr, "gcov_decode: %s: missed the update from dump %lu, "
+                        "counts may be stale\n", path, header->base);
+        pthread_mutex_lock(&countLock);
+        staleFiles++;
+        pthread_mutex_unlock(&countLock);
+    }
+
+    base = read_file(path, &baseLength);
+    if (!base) {
+        *why = "no earlier file to apply the delta to";
+        return -1;
+    }
+    merged = apply_delta(path, base, baseLength, gcda, length, &mergedLength, why);
+    free(base);
+    if (!merged) {
+        return -1;
+    }
+    if (write_gcda(filename, testDir, merged, mergedLength) != 0) {
+        *why = "cannot write file";
+        free(merged);
+        return -1;
+    }
+    free(merged);
+    entry->written = 1;
+    entry->generation = header->generation;
+    return 0;
+}
+
+/*
+ * write_payload writes the data of one file from the dump,
+ * decoding it first if it is transfer encoded.
+ * expected is the gcda byte count the target announced.
+ * Returns 0, or -1 with *why set.
+ */
+static int write_payload(const char *filename, const unsigned char *data, size_t length,
+                         unsigned long expected, const char **why)
+{
+    int status;
+
+    if (is_transfer(data, length)) {
+        TransferHeader header;
+        size_t gcdaLength = 0;
+        unsigned char *gcda = decode_transfer(data, length, &header, &gcdaLength, why);
+
+        if (!gcda) {
+            return -1;
+        }
+        if (gcdaLength != expected) {
+            *why = "wrong data byte count";
+            free(gcda);
+            return -1;
+        }
+        status = write_transfer(filename, gcda, gcdaLength, &header, why);
+        free(gcda);
+        return status;
+    }
+
+    if (length != expected) {
+        *why = "wrong data byte count";
+        return -1;
+    }
+    status = write_gcda(filename, NULL, data, length);
+    if (status) {
+        *why = "cannot write file";
+    }
+    return status;
+}
+
+/*
+ * expand_in_place expands one packed .gcda file (-u),
+ * leaving other files alone.
+ * Returns 0, or -1 if the file is packed but cannot be expanded.
+ */
+static int expand_in_place(const char *path)
+{
+    const char *why = NULL;
+    size_t length;
+    unsigned char *data = read_file(path, &length);
+    int status = 0;
+
+    if (!data) {
+        return -1;
+    }
+    if (is_transfer(data, length)) {
+        TransferHeader header;
+        size_t gcdaLength = 0;
+        unsigned char *gcda = decode_transfer(data, length, &header, &gcdaLength, &why);
+
+        if (gcda && (header.flags & GCOV_TRANSFER_DELTA)) {
+            why = "delta dump, decode all the dumps together instead";
+            free(gcda);
+            gcda = NULL;
+        }
+        if (!gcda || write_gcda(path, NULL, gcda, gcdaLength) != 0) {
+            fprintf(stderr, "gcov_decode: cannot expand %s: %s\n", path,
+                    why ? why : "cannot write file");
+            status = -1;
+        }
+        free(gcda);
+    }
+    free(data);
+    return status;
+}
+
+/* ----------------------------------------------------------- */
+/* State of the file being reassembled from frames */
+typedef struct {
+    int active;             /* BEGIN seen, END not yet */
+    int damaged;            /* a frame of this file was lost */
+    char name[4096];
+    unsigned long expected; /* gcda data byte count from BEGIN */
+    unsigned char *data;
+    size_t size;            /* bytes allocated at data */
+    size_t used;
+} GcdaFile;
+
+typedef struct {
+    unsigned long written;
+    unsigned long dropped;
+    unsigned long frames;
+    unsigned long gaps;
+} DecodeStats;
+
+static void drop_file(GcdaFile *file, DecodeStats *stats, const char *why)
+{
+    if (file->active) {
+        fprintf(stderr, "gcov_decode: dropping %s: %s\n", file->name, why);
+        stats->dropped++;
+    }
+    file->active = 0;
+    file->used = 0;
+}
+
+static void handle_frame(const unsigned char *frame, size_t length,
+                         GcdaFile *file, unsigned *nextSeq, DecodeStats *stats)
+{
+    unsigned type = frame[0];
+    unsigned seq = ((unsigned)frame[1] << 8) | frame[2];
+    const unsigned char *payload = frame + GCOV_FRAME_HEADER_SIZE;
+    size_t payloadLength = length - GCOV_FRAME_HEADER_SIZE - GCOV_FRAME_CRC_SIZE;
+
+    stats->frames++;
+
+    if (type == GCOV_FRAME_OPEN) {
+        drop_file(file, stats, "dump restarted");
+        *nextSeq = (seq + 1) & 0xffff;
+        return;
+    }
+
+    if (seq != *nextSeq) {
+        fprintf(stderr, "gcov_decode: %u frame(s) lost before frame %u\n",
+                (seq - *nextSeq) & 0xffff, seq);
+        stats->gaps++;
+        if (file->active) {
+            file->damaged = 1;
+        }
+    }
+    *nextSeq = (seq + 1) & 0xffff;
+
+    switch (type) {
+    case GCOV_FRAME_BEGIN:
+        drop_file(file, stats, "no end of file seen");
+        if (payloadLength < 4) {
+            return;
+        }
+        file->expected = ((unsigned long)payload[0] << 24) | ((unsigned long)payload[1] << 16) |
+                         ((unsigned long)payload[2] << 8) | payload[3];
+        if (payloadLength - 4 >= sizeof(file->name)) {
+            return;
+        }
+        memcpy(file->name, payload + 4, payloadLength - 4);
+        file->name[payloadLength - 4] = '\0';
+        file->used = 0;
+        file->damaged = 0;
+        file->active = 1;
+        break;
+
+    case GCOV_FRAME_DATA:
+        if (!file->active) {
+            return;
+        }
+        /* (packed data is shorter than expected, but can be longer) */
+        if (file->used + payloadLength > file->size) {
+            size_t size = file->size ? file->size : 4096;
+            unsigned char *data;
+
+            while (size < file->used + payloadLength) {
+                size *= 2;
+            }
+            data = realloc(file->data, size);
+            if (!data) {
+                drop_file(file, stats, "out of memory");
+                return;
+            }
+            file->data = data;
+            file->size = size;
+        }
+        memcpy(file->data + file->used, payload, payloadLength);
+        file->used += payloadLength;
+        break;
+
+    case GCOV_FRAME_END:
+        if (!file->active) {
+            return;
+        }
+        if (file->damaged) {
+            drop_file(file, stats, "lost or damaged frame");
+        } else {
+            const char *why = NULL;
+
+            if (write_payload(file->name, file->data, file->used, file->expected, &why) == 0) {
+                stats->written++;
+                file->active = 0;
+            } else {
+                drop_file(file, stats, why);
+            }
+        }
+        break;
+
+    case GCOV_FRAME_CLOSE:
+        drop_file(file, stats, "no end of file seen");
+        break;
+
+    default:
+        break;
+    }
+}
+
+/*
+ * decode_framed splits the log at the delimiters and handles
+ * every chunk that decodes to a frame with a good CRC.
+ * Chunks that do not are console text (or damaged frames,
+ * which show up as a gap in the sequence numbers).
+ */
+static void decode_framed(const unsigned char *buf, size_t length, DecodeStats *stats)
+{
+    unsigned char *frame = malloc(length ? length : 1);
+    GcdaFile file;
+    unsigned nextSeq = 0;
+    size_t start = 0;
+
+    memset(&file, 0, sizeof(file));
+
+    for (size_t i = 0; i <= length; i++) {
+        if (i < length && buf[i] != GCOV_FRAME_DELIMITER) {
+            continue;
+        }
+        if (i > start) {
+            long n = cobs_decode(buf + start, i - start, frame);
+
+            if (n >= GCOV_FRAME_HEADER_SIZE + GCOV_FRAME_CRC_SIZE) {
+                const unsigned char *c = frame + n - GCOV_FRAME_CRC_SIZE;
+                unsigned long crc = ((unsigned long)c[0] << 24) | ((unsigned long)c[1] << 16) |
+                                    ((unsigned long)c[2] << 8) | c[3];
+
+                if (crc == crc32(frame, n - GCOV_FRAME_CRC_SIZE)) {
+                    handle_frame(frame, n, &file, &nextSeq, stats);
+                }
+            }
+        }
+        start = i + 1;
+    }
+
+    drop_file(&file, stats, "log ended inside the file");
+    free(file.data);
+    free(frame);
+}
+
+/* ----------------------------------------------------------- */
+/* One file in a binary dump, pointing into the mapped dump */
+typedef struct {
+    const char *name;
+    const unsigned char *data;
+    size_t length;              /* bytes of data in the dump */
+    unsigned long expected;     /* gcda data byte count from the header */
+    char *path;                 /* where it is written, malloc'd */
+} BinaryFile;
+
+typedef struct {
+    BinaryFile *files;
+    size_t count;
+    size_t size;                /* entries allocated at files */
+    unsigned long dropped;
+    unsigned long oldCounts;    /* byte counts in the older encoding */
+} BinaryDump;
+
+static const char binaryEndMarker[] = GCOV_BINARY_END_MARKER;
+
+/*
+ * name_length gives the length of the filename at pos
+ * (printable, with trailing null char), or 0 if there is none.
+ */
+static size_t name_length(const unsigned char *buf, size_t length, size_t pos)
+{
+    size_t n = 0;
+
+    while (pos + n < length && n < 4096) {
+        unsigned char c = buf[pos + n];
+
+        if (c == '\0') {
+            return n;
+        }
+        if (c < ' ' || c > '~') {
+            return 0;
+        }
+        n++;
+    }
+    return 0;
+}
+
+/*
+ * starts_file tells whether a file from the dump, or the end marker,
+ * starts at pos: a .gcda filename, the byte count, and data that
+ * starts like gcda or transfer encoded data.
+ */
+static int starts_file(const unsigned char *buf, size_t length, size_t pos)
+{
+    static const unsigned char magic[2][4] = { { 'a', 'd', 'c', 'g' }, { 'g', 'c', 'd', 'a' } };
+    size_t n;
+    const unsigned char *data;
+
+    if (length - pos >= sizeof(binaryEndMarker) &&
+        memcmp(buf + pos, binaryEndMarker, sizeof(binaryEndMarker)) == 0) {
+        return 1;
+    }
+    n = name_length(buf, length, pos);
+    if (n < 5 || memcmp(buf + pos + n - 5, ".gcda", 5) != 0 || length - pos - n - 1 < 4 + 4) {
+        return 0;
+    }
+    data = buf + pos + n + 1 + 4;
+    return memcmp(data, magic[0], 4) == 0 || memcmp(data, magic[1], 4) == 0 ||
+           is_transfer(data, 4);
+}
+
+/*
+ * find_file finds the first file from the dump that starts at or
+ * after from, by its .gcda filename. Returns its position,
+ * or length if none.
+ */
+static size_t find_file(const unsigned char *buf, size_t length, size_t from)
+{
+    size_t pos = from;
+
+    while (pos < length) {
+        const unsigned char *hit = memmem(buf + pos, length - pos, ".gcda", sizeof(".gcda"));
+        size_t end;
+        size_t start;
+
+        if (!hit) {
+            break;
+        }
+        /* back to the start of the filename */
+        end = (size_t)(hit - buf);
+        start = end;
+        while (start > 0 && end - start < 4096 && buf[start - 1] >= ' ' && buf[start - 1] <= '~') {
+            start--;
+        }
+        if (start >= from && starts_file(buf, length, start)) {
+            return start;
+        }
+        pos = end + 1;
+    }
+    return length;
+}
+
+/*
+ * plain_length gives the bytes of plain gcda data at pos,
+ * from the byte count in count, checking that the next file
+ * (or the end marker) follows. If it does not, and the count is
+ * from an older version (third byte count / 255), the count
+ * that gives that byte and fits the dump is used instead.
+ * Returns 0 with *dataLength set, or -1 if no count fits.
+ */
+static int plain_length(const unsigned char *buf, size_t length, size_t pos,
+                        const unsigned char *count, size_t *dataLength, BinaryDump *dump)
+{
+    unsigned long n = ((unsigned long)count[0] << 24) | ((unsigned long)count[1] << 16) |
+                      ((unsigned long)count[2] << 8) | count[3];
+
+    if (n <= length - pos && (pos + n == length || starts_file(buf, length, pos + n))) {
+        *dataLength = n;
+        return 0;
+    }
+    for (unsigned long third = 0; third < 256; third++) {
+        n = ((unsigned long)count[0] << 24) | ((unsigned long)count[1] << 16) |
+            (third << 8) | count[3];
+        if (((n / 255) & 0xFF) == count[2] && n <= length - pos &&
+            (pos + n == length || starts_file(buf, length, pos + n))) {
+            *dataLength = n;
+            dump->oldCounts++;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ * scan_binary lists the files in one binary dump, without copying
+ * their data. A dump that does not start with a file (such as a
+ * memory dump of more than the output buffer) is searched for the
+ * first one. After a damaged file, it carries on from the next
+ * filename it can find.
+ */
+static void scan_binary(const char *dumpName, const unsigned char *buf, size_t length,
+                        BinaryDump *dump)
+{
+    size_t pos = 0;
+    int ended = 0;
+
+    if (!starts_file(buf, length, 0)) {
+        pos = find_file(buf, length, 0);
+        fprintf(stderr, "gcov_decode: %s: skipped %zu bytes before the first file\n",
+                dumpName, pos);
+    }
+
+    while (pos < length) {
+        size_t n = name_length(buf, length, pos);
+        size_t start = pos + n + 1 + 4;
+        const unsigned char *count = buf + pos + n + 1;
+        size_t dataLength = 0;
+        char path[4096];
+        BinaryFile *file;
+        int status;
+
+        if (length - pos >= sizeof(binaryEndMarker) &&
+            memcmp(buf + pos, binaryEndMarker, sizeof(binaryEndMarker)) == 0) {
+            ended = 1;
+            break;
+        }
+        if (n == 0 || start > length) {
+            status = -1;
+        } else if (is_transfer(buf + start, length - start)) {
+            status = transfer_extent(buf + start, length - start, &dataLength);
+        } else {
+            status = plain_length(buf, length, start, count, &dataLength, dump);
+        }
+        if (status != 0) {
+            fprintf(stderr, "gcov_decode: %s: damaged file at offset %zu, dropped\n",
+                    dumpName, pos);
+            dump->dropped++;
+            pos = find_file(buf, length, pos + 1);
+            continue;
+        }
+
+        if (dump->count == dump->size) {
+            size_t size = dump->size ? dump->size * 2 : 64;
+            BinaryFile *files = realloc(dump->files, size * sizeof(BinaryFile));
+
+            if (!files) {
+                fprintf(stderr, "gcov_decode: out of memory\n");
+                dump->dropped++;
+                return;
+            }
+            dump->files = files;
+            dump->size = size;
+        }
+        file = &dump->files[dump->count];
+        file->name = (const char *)buf + pos;
+        file->data = buf + start;
+        file->length = dataLength;
+        /* (the count in the header, unless it was in the older encoding) */
+        file->expected = dataLength;
+        if (is_transfer(file->data, dataLength)) {
+            file->expected = ((unsigned long)count[0] << 24) | ((unsigned long)count[1] << 16) |
+                             ((unsigned long)count[2] << 8) | count[3];
+        }
+        file->path = NULL;
+        if (output_path(file->name, NULL, path, sizeof(path)) == 0) {
+            file->path = strdup(path);
+        }
+        if (file->path) {
+            dump->count++;
+        } else {
+            dump->dropped++;
+        }
+        pos = start + dataLength;
+    }
+
+    if (!ended) {
+        fprintf(stderr, "gcov_decode: %s: no end marker, dump incomplete\n", dumpName);
+        dump->dropped++;
+    }
+}
+
+/* Work shared by the threads writing the files of binary dumps */
+typedef struct {
+    BinaryDump *dump;
+    size_t *order;              /* file indexes, grouped by path */
+    size_t *groups;             /* start of each group in order, and the end */
+    size_t groupCount;
+    size_t next;                /* next group to take */
+    unsigned long written;
+    unsigned long dropped;
+} BinaryWork;
+
+/*
+ * write_group writes the files of binary dumps, one group at a time.
+ * All the files for one path are in one group, in dump order,
+ * so deltas are applied in order.
+ */
+static void *write_group(void *arg)
+{
+    BinaryWork *work = arg;
+
+    for (;;) {
+        size_t g;
+
+        pthread_mutex_lock(&countLock);
+        g = work->next++;
+        pthread_mutex_unlock(&countLock);
+        if (g >= work->groupCount) {
+            break;
+        }
+
+        for (size_t i = work->groups[g]; i < work->groups[g + 1]; i++) {
+            BinaryFile *file = &work->dump->files[work->order[i]];
+            const char *why = NULL;
+            int status;
+
+            status = write_payload(file->name, file->data, file->length, file->expected, &why);
+            pthread_mutex_lock(&countLock);
+            if (status == 0) {
+                work->written++;
+            } else {
+                fprintf(stderr, "gcov_decode: dropping %s: %s\n", file->name, why);
+                work->dropped++;
+            }
+            pthread_mutex_unlock(&countLock);
+        }
+    }
+    return NULL;
+}
+
+static BinaryDump *sortDump;
+
+static int compare_path(const void *a, const void *b)
+{
+    size_t i = *(const size_t *)a;
+    size_t k = *(const size_t *)b;
+    int c = strcmp(sortDump->files[i].path, sortDump->files[k].path);
+
+    /* (same path: keep dump order) */
+    return c ? c : (i > k) - (i < k);
+}
+
+/*
+ * decode_binary writes the files of binary dumps (-b), given in order:
+ * output files of GCOV_OPT_OUTPUT_BINARY_FILE, or memory dumps of
+ * the GCOV_OPT_OUTPUT_BINARY_MEMORY buffer. The dumps are mapped,
+ * not read, and the files are written straight from there,
+ * by up to threads threads.
+ * Returns 0 if every file was written, 1 otherwise.
+ */
+static int decode_binary(char **names, int count, int threads)
+{
+    BinaryDump dump;
+    BinaryWork work;
+    pthread_t *tids;
+    int started = 0;
+
+    memset(&dump, 0, sizeof(dump));
+    memset(&work, 0, sizeof(work));
+
+    for (int i = 0; i < count; i++) {
+        int fd = open(names[i], O_RDONLY);
+        struct stat st;
+        void *map;
+
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            fprintf(stderr, "gcov_decode: cannot open %s: %s\n", names[i], strerror(errno));
+            return 1;
+        }
+        if (st.st_size == 0) {
+            fprintf(stderr, "gcov_decode: %s: empty\n", names[i]);
+            close(fd);
+            dump.dropped++;
+            continue;
+        }
+        /* (left mapped until the files are written) */
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) {
+            fprintf(stderr, "gcov_decode: cannot map %s: %s\n", names[i], strerror(errno));
+            return 1;
+        }
+        (void)madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+        scan_binary(names[i], map, (size_t)st.st_size, &dump);
+    }
+
+    /* Group the files by path, each group in dump order */
+    work.dump = &dump;
+    work.order = malloc((dump.count + 1) * sizeof(size_t));
+    work.groups = malloc((dump.count + 1) * sizeof(size_t));
+    tids = malloc((size_t)threads * sizeof(pthread_t));
+    if (!work.order || !work.groups || !tids) {
+        fprintf(stderr, "gcov_decode: out of memory\n");
+        return 1;
+    }
+    for (size_t i = 0; i < dump.count; i++) {
+        work.order[i] = i;
+    }
+    sortDump = &dump;
+    qsort(work.order, dump.count, sizeof(size_t), compare_path);
+    for (size_t i = 0; i < dump.count; i++) {
+        if (i == 0 || strcmp(dump.files[work.order[i]].path, dump.files[work.order[i - 1]].path)) {
+            work.groups[work.groupCount++] = i;
+            /* (entries for deltas are added now, not from the threads) */
+            if (!find_generation(dump.files[work.order[i]].path)) {
+                fprintf(stderr, "gcov_decode: out of memory\n");
+                return 1;
+            }
+        }
+    }
+    work.groups[work.groupCount] = dump.count;
+
+    for (; started < threads && (size_t)started < work.groupCount; started++) {
+        if (pthread_create(&tids[started], NULL, write_group, &work) != 0) {
+            break;
+        }
+    }
+    if (started == 0) {
+        (void)write_group(&work);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+
+    fprintf(stderr, "gcov_decode: %lu files written, %lu dropped", work.written,
+            work.dropped + dump.dropped);
+    if (dump.oldCounts) {
+        fprintf(stderr, ", %lu byte counts in the older encoding", dump.oldCounts);
+    }
+    fprintf(stderr, "\n");
+    if (staleFiles) {
+        fprintf(stderr, "gcov_decode: %lu deltas applied after a missed update\n", staleFiles);
+    }
+
+    for (size_t i = 0; i < dump.count; i++) {
+        free(dump.files[i].path);
+    }
+    free(tids);
+    free(work.order);
+    free(work.groups);
+    free(dump.files);
+    return (work.dropped || dump.dropped || staleFiles) ? 1 : 0;
+}
+
+/* ----------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+    DecodeStats stats;
+    unsigned char *buf;
+    size_t length;
+    int argi = 1;
+    int expand = 0;
+    int binary = 0;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+    while (argi < argc && argv[argi][0] == '-') {
+        if (strcmp(argv[argi], "-d") == 0 && argi + 1 < argc) {
+            outDir = argv[argi + 1];
+            argi += 2;
+        } else if (strcmp(argv[argi], "-u") == 0) {
+            expand = 1;
+            argi++;
+        } else if (strcmp(argv[argi], "-b") == 0) {
+            binary = 1;
+            argi++;
+        } else if (strcmp(argv[argi], "-j") == 0 && argi + 1 < argc) {
+            threads = atol(argv[argi + 1]);
+            argi += 2;
+        } else {
+            argi = argc;
+        }
+    }
+
+    if (expand) {
+        int status = 0;
+
+        outDir = NULL;
+        while (argi < argc) {
+            if (expand_in_place(argv[argi++]) != 0) {
+                status = 1;
+            }
+        }
+        return status;
+    }
+
+    if (argi >= argc) {
+        fprintf(stderr, "usage: gcov_decode [-d outdir] serial_log ...\n"
+                        "       gcov_decode -b [-d outdir] [-j threads] binary_dump ...\n"
+                        "       gcov_decode -u file.gcda ...\n");
+        return 2;
+    }
+
+    if (binary) {
+        return decode_binary(argv + argi, argc - argi, threads > 0 ? (int)threads : 1);
+    }
+
+    /* Logs in order, so deltas are applied in order */
+    memset(&stats, 0, sizeof(stats));
+    for (; argi < argc; argi++) {
+        buf = read_file(argv[argi], &length);
+        if (!buf) {
+            return 1;
+        }
+        decode_framed(buf, length, &stats);
+        free(buf);
+    }
+
+    fprintf(stderr, "gcov_decode: %lu frames, %lu files written, %lu dropped, %lu sequence gaps\n",
+            stats.frames, stats.written, stats.dropped, stats.gaps);
+    if (staleFiles) {
+        fprintf(stderr, "gcov_decode: %lu deltas applied after a missed update\n", staleFiles);
+    }
+
+    return (stats.dropped || stats.gaps || staleFiles) ? 1 : 0;
+}
+
+/** @}
+ */
+/*
+ * embedded-gcov gcov_decode.c host tool to turn gcov output into gcda files
+ *
+ * Copyright (c) 2021 California Institute of Technology (“Caltech”).
+ * U.S. Government sponsorship acknowledged.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *        this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *        this list of conditions and the following disclaimer in the documentation
+ *        and/or other materials provided with the distribution.
+ *    Neither the name of Caltech nor its operating division, the Jet Propulsion Laboratory,
+ *        nor the names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
@@ -0,0 +1,1851 @@
+/**********************************************************************/
+/** @addtogroup embedded_gcov
+ * @{
+ * @file
+ * @version $Id: $
+ *
+ * @brief Host tool to write lcov tracefiles straight from .gcno and .gcda files.
+ *
+ * Typical usage: ./gcov_lcov -o ../results/newcov.info ../objs
+ *
+ * This does what "lcov --capture" does, without running gcov for
+ * each object file: the .gcno (graph) and .gcda (counters) files are
+ * read here, and the line, branch and function counts are worked out
+ * the way gcov does, then written as one lcov .info tracefile.
+ * Object files are shared out over one thread per core.
+ *
+ * With -i, the baseline ("lcov --capture --initial") is written instead,
+ * from the .gcno files alone, with every count zero.
+ * Add -c to cache the record of each .gcno file between runs.
+ *
+ * Branch data is always written, as lcov does with
+ * "--rc lcov_branch_coverage=1"; genhtml leaves it out unless asked.
+ * Records for a source file seen from several objects (such as a
+ * header with inline functions) are added up, as lcov does.
+ *
+ * Options:
+ *   -o file  write the tracefile to file (default is standard output)
+ *   -i       baseline: every .gcno, with zero counts
+ *   -c dir   with -i, keep the record of each .gcno in dir, by a hash
+ *            of its contents, and only work out the changed ones again
+ *   -t name  test name for the TN: lines
+ *   -j n     read with up to n threads (default is the number of cores)
+ *
+ * Only the graph files of gcc 8 and later are understood.
+ * Exit status is 0 if every object file was read, 1 otherwise.
+ *
+ **********************************************************************/
+
+#define _XOPEN_SOURCE 700 /* for nftw */
+
+#include <errno.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "gcda_io.h"
+
+/* Compare to gcc/gcov-io.h */
+#define GCNO_MAGIC              0x67636e6fUL    /* "gcno" */
+#define GCNO_TAG_FUNCTION       0x01000000UL
+#define GCNO_TAG_BLOCKS         0x01410000UL
+#define GCNO_TAG_ARCS           0x01430000UL
+#define GCNO_TAG_LINES          0x01450000UL
+
+#define GCNO_ARC_ON_TREE        1
+#define GCNO_ARC_FAKE           2
+#define GCNO_ARC_FALLTHROUGH    4
+
+/* Since gcc 8, the exit block is block 1, not the last one */
+#define ENTRY_BLOCK             0
+#define EXIT_BLOCK              1
+
+/* ----------------------------------------------------------- */
+/* The flow graph of an object file, as read from its .gcno file */
+typedef struct {
+    size_t src;                 /* block indexes, in the whole file */
+    size_t dst;
+    unsigned flags;             /* GCNO_ARC_... */
+    int known;                  /* count is measured or worked out */
+    int unconditional;          /* only non-fake arc out of its block */
+    int callNonReturn;          /* fake arc out of a call */
+    long long count;
+    long long cycleCount;       /* count left, while finding loops on a line */
+} Arc;
+
+typedef struct {
+    size_t *succ;               /* arc indexes, in order of destination */
+    size_t succCount;
+    size_t *pred;
+    size_t predCount;
+    size_t succUnknown;         /* arcs with no count yet */
+    size_t predUnknown;
+    int known;
+    long long count;
+    int artificial;             /* of an artificial function, not counted */
+    size_t function;
+} Block;
+
+typedef struct {
+    unsigned long ident;
+    unsigned long linenoChecksum;
+    unsigned long cfgChecksum;
+    const char *name;
+    int artificial;
+    size_t source;
+    unsigned startLine;
+    unsigned endLine;
+    int group;                  /* shares its first line with others (templates) */
+    size_t firstBlock;
+    size_t blockCount;
+    size_t firstArc;
+    size_t arcCount;
+} Function;
+
+/* A line of source that a block is on, or is counted on */
+typedef struct {
+    size_t source;
+    unsigned line;
+    size_t block;
+} LineUse;
+
+typedef struct {
+    unsigned char *data;        /* the file, which the strings point into */
+    size_t length;
+    size_t pos;
+    int swap;
+    int major;
+    int bad;
+    unsigned long stamp;
+    unsigned long checksum;
+    const char *cwd;
+    const char **sources;
+    size_t sourceCount, sourceSize;
+    Function *functions;
+    size_t functionCount, functionSize;
+    Block *blocks;
+    size_t blockCount, blockSize;
+    Arc *arcs;
+    size_t arcCount, arcSize;
+    LineUse *uses;
+    size_t useCount, useSize;
+    LineUse *counted;           /* per block, the last line in each source */
+    size_t countedCount, countedSize;
+    size_t *arcLists;           /* where the blocks' succ and pred point */
+} Notes;
+
+/*
+ * grow makes room for one more item in an array.
+ * Returns 0, or -1 when out of memory.
+ */
+static int grow(void *array, size_t *size, size_t count, size_t item)
+{
+    void **p = array;
+
+    if (count == *size) {
+        size_t n = *size ? *size * 2 : 64;
+        void *list = realloc(*p, n * item);
+
+        if (!list) {
+            return -1;
+        }
+        *p = list;
+        *size = n;
+    }
+    return 0;
+}
+
+static unsigned long read_word(Notes *notes)
+{
+    unsigned int w;
+
+    if (notes->pos > notes->length || notes->length - notes->pos < 4) {
+        notes->bad = 1;
+        return 0;
+    }
+    memcpy(&w, notes->data + notes->pos, 4);
+    notes->pos += 4;
+    if (notes->swap) {
+        w = ((w >> 24) & 0xff) | ((w >> 8) & 0xff00) | ((w << 8) & 0xff0000) | ((w << 24) & 0xff000000);
+    }
+    return w;
+}
+
+/*
+ * read_string returns the string at the read position,
+ * "" for an empty one, or NULL if damaged.
+ * Its length is in bytes since gcc 12, else in words (padded).
+ */
+static const char *read_string(Notes *notes)
+{
+    size_t bytes = read_word(notes);
+    const char *s = (const char *)notes->data + notes->pos;
+
+    if (notes->major < 12) {
+        bytes *= 4;
+    }
+    if (notes->bad || bytes > notes->length - notes->pos) {
+        notes->bad = 1;
+        return NULL;
+    }
+    notes->pos += bytes;
+    if (bytes == 0) {
+        return "";
+    }
+    return memchr(s, '\0', bytes) ? s : NULL;
+}
+
+/*
+ * source_index returns the index of a source file name.
+ */
+static size_t source_index(Notes *notes, const char *name)
+{
+    for (size_t i = notes->sourceCount; i-- > 0;) {
+        if (strcmp(notes->sources[i], name) == 0) {
+            return i;
+        }
+    }
+    if (grow(&notes->sources, &notes->sourceSize, notes->sourceCount, sizeof(char *)) != 0) {
+        notes->bad = 1;
+        return 0;
+    }
+    notes->sources[notes->sourceCount] = name;
+    return notes->sourceCount++;
+}
+
+/*
+ * read_function reads a FUNCTION record.
+ */
+static void read_function(Notes *notes, size_t end)
+{
+    Function *fn;
+    const char *source;
+
+    if (grow(&notes->functions, &notes->functionSize, notes->functionCount, sizeof(Function)) != 0) {
+        notes->bad = 1;
+        return;
+    }
+    fn = &notes->functions[notes->functionCount++];
+    memset(fn, 0, sizeof(*fn));
+    fn->ident = read_word(notes);
+    fn->linenoChecksum = read_word(notes);
+    fn->cfgChecksum = read_word(notes);
+    fn->name = read_string(notes);
+    fn->artificial = (int)read_word(notes);
+    source = read_string(notes);
+    fn->startLine = (unsigned)read_word(notes);
+    (void)read_word(notes); /* start column */
+    fn->endLine = (unsigned)read_word(notes);
+    if (!fn->name || !source || notes->pos > end) {
+        notes->bad = 1;
+        return;
+    }
+    fn->source = source_index(notes, source);
+    fn->firstBlock = notes->blockCount;
+    fn->firstArc = notes->arcCount;
+}
+
+/*
+ * read_blocks reads the BLOCKS record of a function,
+ * which since gcc 8 just has the number of blocks.
+ */
+static void read_blocks(Notes *notes, Function *fn)
+{
+    unsigned long count = read_word(notes);
+
+    if (fn->blockCount || count < 2 || count > notes->length) {
+        notes->bad = 1;
+        return;
+    }
+    for (unsigned long i = 0; i < count; i++) {
+        if (grow(&notes->blocks, &notes->blockSize, notes->blockCount, sizeof(Block)) != 0) {
+            notes->bad = 1;
+            return;
+        }
+        memset(&notes->blocks[notes->blockCount], 0, sizeof(Block));
+        notes->blocks[notes->blockCount++].function = (size_t)(fn - notes->functions);
+    }
+    fn->blockCount = count;
+}
+
+/*
+ * read_arcs reads an ARCS record: the arcs out of one block.
+ */
+static void read_arcs(Notes *notes, Function *fn, size_t end)
+{
+    unsigned long src = read_word(notes);
+
+    if (src >= fn->blockCount) {
+        notes->bad = 1;
+        return;
+    }
+    while (!notes->bad && notes->pos < end) {
+        unsigned long dst = read_word(notes);
+        unsigned long flags = read_word(notes);
+        Arc *arc;
+
+        if (dst >= fn->blockCount ||
+            grow(&notes->arcs, &notes->arcSize, notes->arcCount, sizeof(Arc)) != 0) {
+            notes->bad = 1;
+            return;
+        }
+        arc = &notes->arcs[notes->arcCount++];
+        memset(arc, 0, sizeof(*arc));
+        arc->src = fn->firstBlock + src;
+        arc->dst = fn->firstBlock + dst;
+        arc->flags = (unsigned)flags;
+        arc->callNonReturn = (flags & GCNO_ARC_FAKE) && src != ENTRY_BLOCK;
+        fn->arcCount++;
+    }
+}
+
+/*
+ * add_line adds a line to one of the lists of block lines.
+ * Returns 0, or -1 when out of memory.
+ */
+static int add_line(LineUse **list, size_t *count, size_t *size, size_t source, unsigned line, size_t block)
+{
+    if (grow(list, size, *count, sizeof(LineUse)) != 0) {
+        return -1;
+    }
+    (*list)[*count].source = source;
+    (*list)[*count].line = line;
+    (*list)[*count].block = block;
+    (*count)++;
+    return 0;
+}
+
+/*
+ * read_lines reads a LINES record: the source lines of one block,
+ * each file name followed by its line numbers.
+ * As gcov does, the block is counted on the highest of its lines
+ * in each file name's run (usually just one).
+ */
+static void read_lines(Notes *notes, Function *fn)
+{
+    unsigned long blockNo = read_word(notes);
+    size_t block = fn->firstBlock + blockNo;
+    size_t source = fn->source;
+    unsigned top = 0;
+
+    if (blockNo >= fn->blockCount) {
+        notes->bad = 1;
+        return;
+    }
+    for (;;) {
+        unsigned long line = read_word(notes);
+
+        if (notes->bad) {
+            return;
+        }
+        if (line == 0) {
+            const char *name = read_string(notes);
+
+            if (!name) {
+                notes->bad = 1;
+                return;
+            }
+            if (top && add_line(&notes->counted, &notes->countedCount, &notes->countedSize,
+                                source, top, block) != 0) {
+                notes->bad = 1;
+                return;
+            }
+            top = 0;
+            if (!*name) {
+                break;
+            }
+            source = source_index(notes, name);
+            continue;
+        }
+        if (add_line(&notes->uses, &notes->useCount, &notes->useSize, source, (unsigned)line, block) != 0) {
+            notes->bad = 1;
+            return;
+        }
+        if (line > top) {
+            top = (unsigned)line;
+        }
+    }
+}
+
+static int compare_start(const void *a, const void *b)
+{
+    const Function *x = *(const Function * const *)a;
+    const Function *y = *(const Function * const *)b;
+
+    if (x->source != y->source) {
+        return x->source < y->source ? -1 : 1;
+    }
+    return x->startLine < y->startLine ? -1 : (x->startLine > y->startLine);
+}
+
+/*
+ * mark_groups marks the functions that start on the same line
+ * as another, such as the instances of a template.
+ * gcov counts their lines for each of them on its own.
+ * Returns 0, or -1 when out of memory.
+ */
+static int mark_groups(Notes *notes)
+{
+    Function **order = malloc((notes->functionCount + 1) * sizeof(Function *));
+
+    if (!order) {
+        return -1;
+    }
+    for (size_t i = 0; i < notes->functionCount; i++) {
+        order[i] = &notes->functions[i];
+    }
+    qsort(order, notes->functionCount, sizeof(Function *), compare_start);
+    for (size_t i = 1; i < notes->functionCount; i++) {
+        if (compare_start(&order[i - 1], &order[i]) == 0) {
+            order[i - 1]->group = 1;
+            order[i]->group = 1;
+        }
+    }
+    free(order);
+    return 0;
+}
+
+/*
+ * read_notes reads a .gcno file into notes.
+ * Returns 0, or -1 with *why set.
+ */
+static int read_notes(const char *path, Notes *notes, const char **why)
+{
+    FILE *f = fopen(path, "rb");
+    Function *fn = NULL;
+    unsigned long version;
+    struct stat st;
+
+    memset(notes, 0, sizeof(*notes));
+    if (!f || fstat(fileno(f), &st) != 0 || !(notes->data = malloc((size_t)st.st_size + 1)) ||
+        fread(notes->data, 1, (size_t)st.st_size, f) != (size_t)st.st_size) {
+        *why = strerror(errno);
+        if (f) {
+            fclose(f);
+        }
+        return -1;
+    }
+    fclose(f);
+    notes->length = (size_t)st.st_size;
+
+    if (read_word(notes) != GCNO_MAGIC) {
+        notes->pos = 0;
+        notes->swap = 1;
+        if (read_word(notes) != GCNO_MAGIC) {
+            *why = "not a gcno file";
+            return -1;
+        }
+    }
+    /* Version is like "B22*" for gcc 12.2, as in gcda_io.c */
+    version = read_word(notes);
+    notes->major = (int)((version >> 24) & 0xff) - 'A';
+    notes->major = notes->major * 10 + (int)((version >> 16) & 0xff) - '0';
+    if (notes->major < 8) {
+        *why = "gcno file of gcc before 8";
+        return -1;
+    }
+    notes->stamp = read_word(notes);
+    if (notes->major >= 12) {
+        notes->checksum = read_word(notes);
+    }
+    notes->cwd = read_string(notes);
+    (void)read_word(notes); /* has_unexecuted_blocks */
+
+    while (!notes->bad && notes->length - notes->pos >= 8) {
+        unsigned long tag = read_word(notes);
+        size_t length = read_word(notes);
+        size_t end;
+
+        /* record lengths are in bytes for gcc 12 and later, else in words */
+        if (notes->major < 12) {
+            length *= 4;
+        }
+        if (length > notes->length - notes->pos) {
+            notes->bad = 1;
+            break;
+        }
+        end = notes->pos + length;
+        if (tag == GCNO_TAG_FUNCTION) {
+            read_function(notes, end);
+            fn = notes->bad ? NULL : &notes->functions[notes->functionCount - 1];
+        } else if (fn && tag == GCNO_TAG_BLOCKS) {
+            read_blocks(notes, fn);
+        } else if (fn && fn->blockCount && tag == GCNO_TAG_ARCS) {
+            read_arcs(notes, fn, end);
+        } else if (fn && fn->blockCount && tag == GCNO_TAG_LINES) {
+            read_lines(notes, fn);
+        }
+        if (notes->pos > end) {
+            notes->bad = 1;
+        }
+        notes->pos = end;
+    }
+    if (notes->bad || !notes->cwd) {
+        *why = "damaged gcno file";
+        return -1;
+    }
+    if (mark_groups(notes) != 0) {
+        *why = "out of memory";
+        return -1;
+    }
+    return 0;
+}
+
+static void free_notes(Notes *notes)
+{
+    free(notes->data);
+    free(notes->sources);
+    free(notes->functions);
+    free(notes->blocks);
+    free(notes->arcs);
+    free(notes->uses);
+    free(notes->counted);
+    free(notes->arcLists);
+}
+
+/* ----------------------------------------------------------- */
+/*
+ * link_arcs fills in the successor and predecessor lists
+ * of the blocks, in the order the arcs are in the file.
+ * Returns 0, or -1 when out of memory.
+ */
+static int link_arcs(Notes *notes)
+{
+    size_t used = 0;
+
+    notes->arcLists = malloc((2 * notes->arcCount + 1) * sizeof(size_t));
+    if (!notes->arcLists) {
+        return -1;
+    }
+    for (size_t i = 0; i < notes->arcCount; i++) {
+        notes->blocks[notes->arcs[i].src].succCount++;
+        notes->blocks[notes->arcs[i].dst].predCount++;
+    }
+    for (size_t i = 0; i < notes->blockCount; i++) {
+        Block *b = &notes->blocks[i];
+
+        b->succ = notes->arcLists + used;
+        used += b->succCount;
+        b->pred = notes->arcLists + used;
+        used += b->predCount;
+        b->succCount = 0;
+        b->predCount = 0;
+    }
+    for (size_t i = 0; i < notes->arcCount; i++) {
+        Block *src = &notes->blocks[notes->arcs[i].src];
+        Block *dst = &notes->blocks[notes->arcs[i].dst];
+
+        src->succ[src->succCount++] = i;
+        dst->pred[dst->predCount++] = i;
+    }
+    return 0;
+}
+
+/*
+ * find_counts returns the arc counters of a function
+ * in a .gcda file, or NULL if there are none.
+ * *from is where to start looking, as they are usually in order.
+ */
+static const GcdaCounters *find_counts(const GcdaInfo *info, const Function *fn, size_t *from)
+{
+    for (size_t n = 0; n < info->functionCount; n++) {
+        size_t i = (*from + n) % info->functionCount;
+        const GcdaFunction *f = &info->functions[i];
+
+        if (f->empty || f->ident != fn->ident) {
+            continue;
+        }
+        *from = i + 1;
+        if (f->linenoChecksum != fn->linenoChecksum || f->cfgChecksum != fn->cfgChecksum) {
+            return NULL;
+        }
+        for (size_t k = 0; k < f->counterCount; k++) {
+            if (f->counters[k].tag == GCDA_TAG_FOR_COUNTER(0)) {
+                return &f->counters[k];
+            }
+        }
+        return NULL;
+    }
+    return NULL;
+}
+
+/*
+ * solve_function works out the count of every block and arc
+ * of a function from its arc counters (or zeros, if NULL),
+ * as gcov does.
+ * Returns 0, or -1 if the counters do not fit the graph.
+ */
+static int solve_function(Notes *notes, const Function *fn, const GcdaCounters *counts)
+{
+    Block *blocks = notes->blocks + fn->firstBlock;
+    size_t measured = 0;
+    int changed = 1;
+
+    for (size_t i = 0; i < fn->arcCount; i++) {
+        if (!(notes->arcs[fn->firstArc + i].flags & GCNO_ARC_ON_TREE)) {
+            measured++;
+        }
+    }
+    if (counts && counts->count != measured) {
+        return -1;
+    }
+
+    /* The counters go to the arcs off the spanning tree, in file order */
+    measured = 0;
+    for (size_t i = 0; i < fn->blockCount; i++) {
+        Block *b = &blocks[i];
+        size_t nonFake = 0;
+        size_t only = 0;
+
+        for (size_t k = 0; k < b->succCount; k++) {
+            Arc *arc = &notes->arcs[b->succ[k]];
+
+            if (arc->flags & GCNO_ARC_ON_TREE) {
+                b->succUnknown++;
+                notes->blocks[arc->dst].predUnknown++;
+            } else {
+                arc->count = counts ? counts->values[measured++] : 0;
+                arc->known = 1;
+            }
+            if (!(arc->flags & GCNO_ARC_FAKE)) {
+                nonFake++;
+                only = b->succ[k];
+            }
+        }
+        if (nonFake == 1) {
+            notes->arcs[only].unconditional = 1;
+        }
+        /* Then by destination, keeping the order of equal ones */
+        for (size_t k = 1; k < b->succCount; k++) {
+            size_t a = b->succ[k];
+            size_t j = k;
+
+            for (; j > 0 && notes->arcs[b->succ[j - 1]].dst > notes->arcs[a].dst; j--) {
+                b->succ[j] = b->succ[j - 1];
+            }
+            b->succ[j] = a;
+        }
+    }
+
+    /*
+     * A block count is the sum over its arcs in or out, once those
+     * are known; then an arc left unknown is the difference.
+     * (Not from the missing arcs into the entry or out of the exit.)
+     */
+    while (changed) {
+        changed = 0;
+        for (size_t i = 0; i < fn->blockCount; i++) {
+            Block *b = &blocks[i];
+            long long total = 0;
+
+            if (!b->known && i != EXIT_BLOCK && b->succUnknown == 0) {
+                for (size_t k = 0; k < b->succCount; k++) {
+                    total += notes->arcs[b->succ[k]].count;
+                }
+                b->count = total;
+                b->known = changed = 1;
+            } else if (!b->known && i != ENTRY_BLOCK && b->predUnknown == 0) {
+                for (size_t k = 0; k < b->predCount; k++) {
+                    total += notes->arcs[b->pred[k]].count;
+                }
+                b->count = total;
+                b->known = changed = 1;
+            }
+            if (!b->known) {
+                continue;
+            }
+            if (b->succUnknown == 1) {
+                Arc *unknown = NULL;
+
+                total = b->count;
+                for (size_t k = 0; k < b->succCount; k++) {
+                    Arc *arc = &notes->arcs[b->succ[k]];
+
+                    if (!arc->known) {
+                        unknown = arc;
+                    } else {
+                        total -= arc->count;
+                    }
+                }
+                unknown->count = total;
+                unknown->known = 1;
+                b->succUnknown--;
+                notes->blocks[unknown->dst].predUnknown--;
+                changed = 1;
+            }
+            if (b->predUnknown == 1) {
+                Arc *unknown = NULL;
+
+                total = b->count;
+                for (size_t k = 0; k < b->predCount; k++) {
+                    Arc *arc = &notes->arcs[b->pred[k]];
+
+                    if (!arc->known) {
+                        unknown = arc;
+                    } else {
+                        total -= arc->count;
+                    }
+                }
+                unknown->count = total;
+                unknown->known = 1;
+                b->predUnknown--;
+                notes->blocks[unknown->src].succUnknown--;
+                changed = 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* ----------------------------------------------------------- */
+/* Coverage of one source file, as written to the tracefile */
+typedef struct {
+    unsigned line;
+    long long count;
+} LineCount;
+
+typedef struct {
+    unsigned line;
+    unsigned index;             /* of the branch on its line */
+    long long taken;            /* -1 if its block never ran ("-") */
+} BranchCount;
+
+typedef struct {
+    unsigned line;
+    char *name;
+    long long count;
+} FunctionCount;
+
+typedef struct {
+    char *path;
+    size_t order;               /* of the objects, to keep merges stable */
+    LineCount *lines;
+    size_t lineCount, lineSize;
+    BranchCount *branches;
+    size_t branchCount, branchSize;
+    FunctionCount *functions;
+    size_t functionCount, functionSize;
+} SourceCoverage;
+
+/*
+ * The blocks counted on one line, while finding the loops
+ * that stay on it (Johnson's elementary circuits, as gcov does).
+ * Blocks are by their position in the ascending blocks array.
+ */
+typedef struct {
+    Notes *notes;
+    const size_t *blocks;
+    size_t count;
+    char *blocked;
+    size_t *lists;              /* count lists of up to count positions */
+    size_t *listCount;
+    size_t *path;               /* arcs, up to count of them */
+} LineCycles;
+
+static size_t line_position(const LineCycles *c, size_t block)
+{
+    size_t lo = 0;
+    size_t hi = c->count;
+
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+
+        if (c->blocks[mid] < block) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return (lo < c->count && c->blocks[lo] == block) ? lo : c->count;
+}
+
+static void unblock(LineCycles *c, size_t u)
+{
+    size_t n = c->listCount[u];
+
+    if (!c->blocked[u]) {
+        return;
+    }
+    c->blocked[u] = 0;
+    c->listCount[u] = 0;
+    for (size_t i = 0; i < n; i++) {
+        unblock(c, c->lists[u * c->count + i]);
+    }
+}
+
+/*
+ * handle_cycle takes the smallest count left on the arcs
+ * of a loop off all of them, and adds it to *count.
+ */
+static void handle_cycle(LineCycles *c, size_t depth, long long *count)
+{
+    long long least = c->notes->arcs[c->path[0]].cycleCount;
+
+    for (size_t i = 1; i < depth; i++) {
+        if (c->notes->arcs[c->path[i]].cycleCount < least) {
+            least = c->notes->arcs[c->path[i]].cycleCount;
+        }
+    }
+    *count += least;
+    for (size_t i = 0; i < depth; i++) {
+        c->notes->arcs[c->path[i]].cycleCount -= least;
+    }
+}
+
+/*
+ * circuit finds the loops through start (a position) that go
+ * from v on, with arcs to positions no lower than start.
+ * Returns nonzero if it found one.
+ */
+static int circuit(LineCycles *c, size_t v, size_t start, size_t depth, long long *count)
+{
+    const Block *b = &c->notes->blocks[c->blocks[v]];
+    int found = 0;
+
+    c->blocked[v] = 1;
+    for (size_t k = 0; k < b->succCount; k++) {
+        const Arc *arc = &c->notes->arcs[b->succ[k]];
+        size_t w = line_position(c, arc->dst);
+        int positive = 1;
+
+        if (w == c->count || w < start || arc->cycleCount <= 0) {
+            continue;
+        }
+        c->path[depth] = b->succ[k];
+        for (size_t i = 0; i < depth; i++) {
+            if (c->notes->arcs[c->path[i]].cycleCount <= 0) {
+                positive = 0;
+            }
+        }
+        if (w == start) {
+            handle_cycle(c, depth + 1, count);
+            found = 1;
+        } else if (positive && !c->blocked[w]) {
+            found |= circuit(c, w, start, depth + 1, count);
+        }
+    }
+
+    if (found) {
+        unblock(c, v);
+        return found;
+    }
+    for (size_t k = 0; k < b->succCount; k++) {
+        const Arc *arc = &c->notes->arcs[b->succ[k]];
+        size_t w = line_position(c, arc->dst);
+        size_t *list;
+        size_t i;
+
+        if (w == c->count || w < start || arc->cycleCount <= 0) {
+            continue;
+        }
+        list = c->lists + w * c->count;
+        for (i = 0; i < c->listCount[w] && list[i] != v; i++) {
+        }
+        if (i == c->listCount[w]) {
+            list[c->listCount[w]++] = v;
+        }
+    }
+    return found;
+}
+
+/*
+ * line_count works out how many times a line ran, from the blocks
+ * counted on it: the arcs into them from other lines, plus
+ * the loops that stay on the line.
+ * Returns -1 when out of memory.
+ */
+static long long line_count(Notes *notes, const size_t *blocks, size_t count)
+{
+    LineCycles c;
+    long long total = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        const Block *b = &notes->blocks[blocks[i]];
+
+        for (size_t k = 0; k < b->predCount; k++) {
+            const Arc *arc = &notes->arcs[b->pred[k]];
+            size_t j;
+
+            for (j = 0; j < count && blocks[j] != arc->src; j++) {
+            }
+            if (j == count) {
+                total += arc->count;
+            }
+        }
+        for (size_t k = 0; k < b->succCount; k++) {
+            notes->arcs[b->succ[k]].cycleCount = notes->arcs[b->succ[k]].count;
+        }
+    }
+
+    c.notes = notes;
+    c.blocks = blocks;
+    c.count = count;
+    c.blocked = malloc(count);
+    c.lists = malloc(count * count * sizeof(size_t));
+    c.listCount = malloc(count * sizeof(size_t));
+    c.path = malloc(count * sizeof(size_t));
+    if (!c.blocked || !c.lists || !c.listCount || !c.path) {
+        total = -1;
+    } else {
+        for (size_t start = 0; start < count; start++) {
+            memset(c.blocked, 0, count);
+            memset(c.listCount, 0, count * sizeof(size_t));
+            (void)circuit(&c, start, start, 0, &total);
+        }
+    }
+    free(c.blocked);
+    free(c.lists);
+    free(c.listCount);
+    free(c.path);
+    return total;
+}
+
+static int compare_use(const void *a, const void *b)
+{
+    const LineUse *x = a;
+    const LineUse *y = b;
+
+    if (x->source != y->source) {
+        return x->source < y->source ? -1 : 1;
+    }
+    if (x->line != y->line) {
+        return x->line < y->line ? -1 : 1;
+    }
+    return x->block < y->block ? -1 : (x->block > y->block);
+}
+
+/*
+ * count_lines adds the line and branch counts of the object
+ * to the coverage of its sources, as gcov counts them:
+ * a block is counted on the last line it is on (in each file),
+ * and its arcs are the branches of that line.
+ * Branches are numbered for each function of a group on its own,
+ * so lcov adds up those of the instances of a template.
+ * Returns 0, or -1 when out of memory.
+ */
+static int count_lines(Notes *notes, SourceCoverage *sources)
+{
+    size_t *blocks = malloc((notes->countedCount + 1) * sizeof(size_t));
+    size_t l = 0;
+    size_t u = 0;
+    size_t n = 0;
+
+    if (!blocks) {
+        return -1;
+    }
+
+    /* The lines of artificial functions are dropped */
+    for (size_t i = 0; i < notes->useCount; i++) {
+        if (!notes->blocks[notes->uses[i].block].artificial) {
+            notes->uses[n++] = notes->uses[i];
+        }
+    }
+    notes->useCount = n;
+    qsort(notes->uses, notes->useCount, sizeof(LineUse), compare_use);
+
+    n = 0;
+    for (size_t i = 0; i < notes->countedCount; i++) {
+        if (!notes->blocks[notes->counted[i].block].artificial) {
+            notes->counted[n++] = notes->counted[i];
+        }
+    }
+    notes->countedCount = n;
+    qsort(notes->counted, notes->countedCount, sizeof(LineUse), compare_use);
+
+    while (u < notes->useCount) {
+        SourceCoverage *sc = &sources[notes->uses[u].source];
+        LineUse at = notes->uses[u];
+        long long count = 0;
+        size_t blockCount = 0;
+
+        for (; u < notes->useCount && notes->uses[u].source == at.source &&
+               notes->uses[u].line == at.line; u++) {
+            count += notes->blocks[notes->uses[u].block].count;
+        }
+        at.block = 0;
+        while (l < notes->countedCount && compare_use(&notes->counted[l], &at) < 0) {
+            l++;
+        }
+        for (; l < notes->countedCount && notes->counted[l].source == at.source &&
+               notes->counted[l].line == at.line; l++) {
+            if (!blockCount || blocks[blockCount - 1] != notes->counted[l].block) {
+                blocks[blockCount++] = notes->counted[l].block;
+            }
+        }
+
+        if (blockCount) {
+            unsigned index = 0;
+            unsigned groupIndex = 0;
+            size_t groupFunction = notes->functionCount;
+
+            count = line_count(notes, blocks, blockCount);
+            if (count < 0) {
+                count = 0;
+            }
+            for (size_t i = 0; i < blockCount; i++) {
+                const Block *b = &notes->blocks[blocks[i]];
+                const Function *fn = &notes->functions[b->function];
+                int inGroup = fn->group && fn->source == at.source &&
+                              at.line >= fn->startLine && at.line <= fn->endLine;
+
+                if (inGroup && b->function != groupFunction) {
+                    groupFunction = b->function;
+                    groupIndex = 0;
+                }
+                for (size_t k = 0; k < b->succCount; k++) {
+                    const Arc *arc = &notes->arcs[b->succ[k]];
+
+                    if (arc->unconditional || arc->callNonReturn) {
+                        continue;
+                    }
+                    if (grow(&sc->branches, &sc->branchSize, sc->branchCount, sizeof(BranchCount)) != 0) {
+                        free(blocks);
+                        return -1;
+                    }
+                    sc->branches[sc->branchCount].line = at.line;
+                    sc->branches[sc->branchCount].index = inGroup ? groupIndex++ : index++;
+                    sc->branches[sc->branchCount].taken = b->count ? arc->count : -1;
+                    sc->branchCount++;
+                }
+            }
+        }
+
+        if (grow(&sc->lines, &sc->lineSize, sc->lineCount, sizeof(LineCount)) != 0) {
+            free(blocks);
+            return -1;
+        }
+        sc->lines[sc->lineCount].line = at.line;
+        sc->lines[sc->lineCount].count = count;
+        sc->lineCount++;
+    }
+
+    free(blocks);
+    return 0;
+}
+
+/*
+ * source_path returns the full path of a source file,
+ * relative ones taken from the build directory, without
+ * "." and ".." parts, as lcov writes them.
+ */
+static char *source_path(const char *cwd, const char *name)
+{
+    size_t n = strlen(cwd) + strlen(name) + 2;
+    char *joined = malloc(n);
+    char *path = malloc(n + 1);
+    char *save = NULL;
+    size_t used = 0;
+
+    if (path) {
+        path[0] = '\0';
+    }
+
+    if (!joined || !path) {
+        free(joined);
+        free(path);
+        return NULL;
+    }
+    if (name[0] == '/' || !cwd[0]) {
+        snprintf(joined, n, "%s", name);
+    } else {
+        snprintf(joined, n, "%s/%s", cwd, name);
+    }
+
+    for (char *part = strtok_r(joined, "/", &save); part; part = strtok_r(NULL, "/", &save)) {
+        if (strcmp(part, ".") == 0) {
+            continue;
+        }
+        if (strcmp(part, "..") == 0) {
+            size_t start = used;
+
+            while (start && path[start - 1] != '/') {
+                start--;
+            }
+            if (used > start && strcmp(path + start, "..") != 0) {
+                used = start ? start - 1 : 0;
+                path[used] = '\0';
+                continue;
+            }
+            if (!used && joined[0] == '/') {
+                continue; /* "/.." is "/" */
+            }
+        }
+        if (used || joined[0] == '/') {
+            path[used++] = '/';
+        }
+        strcpy(path + used, part);
+        used += strlen(part);
+    }
+    if (!used && joined[0] == '/') {
+        path[used++] = '/';
+    }
+    path[used] = '\0';
+    free(joined);
+    return path;
+}
+
+/*
+ * cover_object works out the coverage of one object file,
+ * from its .gcno file and (unless NULL) its .gcda file.
+ * Returns 0, or -1 after saying why.
+ */
+static int cover_object(const char *notesPath, const char *dataPath,
+                        SourceCoverage **out, size_t *outCount)
+{
+    Notes notes;
+    GcdaInfo info;
+    SourceCoverage *sources = NULL;
+    const char *why = NULL;
+    size_t from = 0;
+    size_t count = 0;
+    int result = -1;
+
+    memset(&info, 0, sizeof(info));
+    if (read_notes(notesPath, &notes, &why) != 0) {
+        fprintf(stderr, "gcov_lcov: cannot read %s: %s\n", notesPath, why);
+        free_notes(&notes);
+        return -1;
+    }
+    if (dataPath && gcda_read(dataPath, &info, &why) != 0) {
+        fprintf(stderr, "gcov_lcov: cannot read %s: %s\n", dataPath, why);
+        goto done;
+    }
+    if (dataPath && info.stamp != notes.stamp) {
+        fprintf(stderr, "gcov_lcov: %s is not from the build of %s (stamp differs)\n",
+                dataPath, notesPath);
+        goto done;
+    }
+    if (link_arcs(&notes) != 0 ||
+        !(sources = calloc(notes.sourceCount + 1, sizeof(SourceCoverage)))) {
+        fprintf(stderr, "gcov_lcov: out of memory\n");
+        goto done;
+    }
+
+    for (size_t i = 0; i < notes.functionCount; i++) {
+        const Function *fn = &notes.functions[i];
+        const GcdaCounters *counts = dataPath ? find_counts(&info, fn, &from) : NULL;
+
+        if (!fn->blockCount) {
+            continue;
+        }
+        if (solve_function(&notes, fn, counts) != 0) {
+            fprintf(stderr, "gcov_lcov: %s: counters of %s do not fit its graph\n",
+                    dataPath, fn->name);
+            (void)solve_function(&notes, fn, NULL);
+        }
+        for (size_t k = 0; fn->artificial && k < fn->blockCount; k++) {
+            notes.blocks[fn->firstBlock + k].artificial = 1;
+        }
+    }
+    if (count_lines(&notes, sources) != 0) {
+        fprintf(stderr, "gcov_lcov: out of memory\n");
+        goto done;
+    }
+
+    /* Functions are on their first line, counted by their entry block */
+    for (size_t i = 0; i < notes.functionCount; i++) {
+        const Function *fn = &notes.functions[i];
+        SourceCoverage *sc = &sources[fn->source];
+
+        if (fn->artificial || !fn->blockCount) {
+            continue;
+        }
+        if (grow(&sc->functions, &sc->functionSize, sc->functionCount, sizeof(FunctionCount)) != 0 ||
+            !(sc->functions[sc->functionCount].name = strdup(fn->name))) {
+            fprintf(stderr, "gcov_lcov: out of memory\n");
+            goto done;
+        }
+        sc->functions[sc->functionCount].line = fn->startLine;
+        sc->functions[sc->functionCount].count = notes.blocks[fn->firstBlock + ENTRY_BLOCK].count;
+        sc->functionCount++;
+    }
+
+    /* Keep the sources with something in them */
+    for (size_t i = 0; i < notes.sourceCount; i++) {
+        SourceCoverage *sc = &sources[i];
+
+        if (!sc->lineCount && !sc->functionCount) {
+            continue;
+        }
+        sc->path = source_path(notes.cwd, notes.sources[i]);
+        if (!sc->path) {
+            fprintf(stderr, "gcov_lcov: out of memory\n");
+            goto done;
+        }
+        sources[count++] = *sc;
+        if (count - 1 != i) {
+            memset(sc, 0, sizeof(*sc));
+        }
+    }
+    result = 0;
+
+done:
+    if (result != 0 && sources) {
+        for (size_t i = 0; i < notes.sourceCount; i++) {
+            free(sources[i].path);
+            free(sources[i].lines);
+            free(sources[i].branches);
+            for (size_t k = 0; k < sources[i].functionCount; k++) {
+                free(sources[i].functions[k].name);
+            }
+            free(sources[i].functions);
+        }
+        free(sources);
+        sources = NULL;
+        count = 0;
+    }
+    *out = sources;
+    *outCount = count;
+    gcda_free(&info);
+    free_notes(&notes);
+    return result;
+}
+
+/* ----------------------------------------------------------- */
+static int compare_source(const void *a, const void *b)
+{
+    const SourceCoverage *x = a;
+    const SourceCoverage *y = b;
+    int c = strcmp(x->path, y->path);
+
+    if (c) {
+        return c;
+    }
+    return x->order < y->order ? -1 : (x->order > y->order);
+}
+
+static int compare_line(const void *a, const void *b)
+{
+    const LineCount *x = a;
+    const LineCount *y = b;
+
+    return x->line < y->line ? -1 : (x->line > y->line);
+}
+
+static int compare_branch(const void *a, const void *b)
+{
+    const BranchCount *x = a;
+    const BranchCount *y = b;
+
+    if (x->line != y->line) {
+        return x->line < y->line ? -1 : 1;
+    }
+    return x->index < y->index ? -1 : (x->index > y->index);
+}
+
+static int compare_function_name(const void *a, const void *b)
+{
+    const FunctionCount *x = a;
+    const FunctionCount *y = b;
+    int c = strcmp(x->name, y->name);
+
+    if (c) {
+        return c;
+    }
+    return x->line < y->line ? -1 : (x->line > y->line);
+}
+
+static int compare_function_line(const void *a, const void *b)
+{
+    const FunctionCount *x = a;
+    const FunctionCount *y = b;
+
+    if (x->line != y->line) {
+        return x->line < y->line ? -1 : 1;
+    }
+    return strcmp(x->name, y->name);
+}
+
+/*
+ * append adds count items of from to an array.
+ * Returns 0, or -1 when out of memory.
+ */
+static int append(void *array, size_t *count, size_t *size, const void *from, size_t add, size_t item)
+{
+    void **p = array;
+
+    if (*count + add > *size) {
+        size_t n = *count + add;
+        void *list = realloc(*p, n * item);
+
+        if (!list) {
+            return -1;
+        }
+        *p = list;
+        *size = n;
+    }
+    memcpy((char *)*p + *count * item, from, add * item);
+    *count += add;
+    return 0;
+}
+
+/*
+ * add_source adds the coverage of from (of the same source file)
+ * into to, as lcov adds up tracefiles: counts of the same line,
+ * branch or function name are summed.
+ * Returns 0, or -1 when out of memory.
+ */
+static int add_source(SourceCoverage *to, SourceCoverage *from)
+{
+    size_t n = 0;
+
+    if (from) {
+        if (append(&to->lines, &to->lineCount, &to->lineSize,
+                   from->lines, from->lineCount, sizeof(LineCount)) != 0 ||
+            append(&to->branches, &to->branchCount, &to->branchSize,
+                   from->branches, from->branchCount, sizeof(BranchCount)) != 0 ||
+            append(&to->functions, &to->functionCount, &to->functionSize,
+                   from->functions, from->functionCount, sizeof(FunctionCount)) != 0) {
+            return -1;
+        }
+        /* (the function names now belong to to) */
+        from->functionCount = 0;
+    }
+
+    qsort(to->lines, to->lineCount, sizeof(LineCount), compare_line);
+    for (size_t i = 0; i < to->lineCount; i++) {
+        if (n && to->lines[n - 1].line == to->lines[i].line) {
+            to->lines[n - 1].count += to->lines[i].count;
+        } else {
+            to->lines[n++] = to->lines[i];
+        }
+    }
+    to->lineCount = n;
+
+    n = 0;
+    qsort(to->branches, to->branchCount, sizeof(BranchCount), compare_branch);
+    for (size_t i = 0; i < to->branchCount; i++) {
+        BranchCount *last = n ? &to->branches[n - 1] : NULL;
+
+        if (last && last->line == to->branches[i].line && last->index == to->branches[i].index) {
+            if (to->branches[i].taken >= 0) {
+                last->taken = (last->taken < 0 ? 0 : last->taken) + to->branches[i].taken;
+            }
+        } else {
+            to->branches[n++] = to->branches[i];
+        }
+    }
+    to->branchCount = n;
+
+    n = 0;
+    qsort(to->functions, to->functionCount, sizeof(FunctionCount), compare_function_name);
+    for (size_t i = 0; i < to->functionCount; i++) {
+        if (n && strcmp(to->functions[n - 1].name, to->functions[i].name) == 0) {
+            to->functions[n - 1].count += to->functions[i].count;
+            free(to->functions[i].name);
+        } else {
+            to->functions[n++] = to->functions[i];
+        }
+    }
+    to->functionCount = n;
+    qsort(to->functions, to->functionCount, sizeof(FunctionCount), compare_function_line);
+    return 0;
+}
+
+static void free_source(SourceCoverage *sc)
+{
+    free(sc->path);
+    free(sc->lines);
+    free(sc->branches);
+    for (size_t i = 0; i < sc->functionCount; i++) {
+        free(sc->functions[i].name);
+    }
+    free(sc->functions);
+}
+
+/*
+ * write_source writes the record of one source file,
+ * in the order lcov writes them.
+ */
+static void write_source(FILE *f, const char *testName, const SourceCoverage *sc)
+{
+    size_t hit = 0;
+
+    fprintf(f, "TN:%s\n", testName);
+    fprintf(f, "SF:%s\n", sc->path);
+    for (size_t i = 0; i < sc->functionCount; i++) {
+        fprintf(f, "FN:%u,%s\n", sc->functions[i].line, sc->functions[i].name);
+    }
+    for (size_t i = 0; i < sc->functionCount; i++) {
+        fprintf(f, "FNDA:%lld,%s\n", sc->functions[i].count, sc->functions[i].name);
+        hit += sc->functions[i].count > 0;
+    }
+    fprintf(f, "FNF:%lu\nFNH:%lu\n", (unsigned long)sc->functionCount, (unsigned long)hit);
+
+    hit = 0;
+    for (size_t i = 0; i < sc->branchCount; i++) {
+        const BranchCount *br = &sc->branches[i];
+
+        if (br->taken < 0) {
+            fprintf(f, "BRDA:%u,0,%u,-\n", br->line, br->index);
+        } else {
+            fprintf(f, "BRDA:%u,0,%u,%lld\n", br->line, br->index, br->taken);
+        }
+        hit += br->taken > 0;
+    }
+    if (sc->branchCount) {
+        fprintf(f, "BRF:%lu\nBRH:%lu\n", (unsigned long)sc->branchCount, (unsigned long)hit);
+    }
+
+    hit = 0;
+    for (size_t i = 0; i < sc->lineCount; i++) {
+        fprintf(f, "DA:%u,%lld\n", sc->lines[i].line, sc->lines[i].count);
+        hit += sc->lines[i].count > 0;
+    }
+    fprintf(f, "LF:%lu\nLH:%lu\n", (unsigned long)sc->lineCount, (unsigned long)hit);
+    fprintf(f, "end_of_record\n");
+}
+
+/* ----------------------------------------------------------- */
+/*
+ * With -c, the baseline record of each .gcno file is kept in the
+ * cache directory, in a file named after a hash of the .gcno file.
+ * Only the .gcno files that changed are worked out again; the rest
+ * are read back from the cache. Cached records are never removed.
+ */
+#define CACHE_VERSION   1       /* of the records, part of the name */
+
+/*
+ * hash_file returns the 64-bit FNV-1a hash of a file's contents.
+ * Returns 0, or -1 if it cannot be read.
+ */
+static int hash_file(const char *path, unsigned long long *hash, long long *size)
+{
+    FILE *f = fopen(path, "rb");
+    unsigned char buffer[65536];
+    size_t n;
+
+    if (!f) {
+        return -1;
+    }
+    *hash = 0xcbf29ce484222325ULL;
+    *size = 0;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            *hash = (*hash ^ buffer[i]) * 0x100000001b3ULL;
+        }
+        *size += (long long)n;
+    }
+    n = (size_t)ferror(f);
+    fclose(f);
+    return n ? -1 : 0;
+}
+
+/*
+ * read_cached reads back the records of one object from a cache file.
+ * Returns 0, or -1 if there is none (or it is damaged).
+ */
+static int read_cached(const char *path, SourceCoverage **out, size_t *outCount)
+{
+    FILE *f = fopen(path, "r");
+    SourceCoverage *sources = NULL;
+    SourceCoverage *sc = NULL;
+    size_t count = 0;
+    size_t size = 0;
+    size_t fnda = 0;
+    char line[4096];
+    int ended = 1;
+    int bad = 0;
+
+    if (!f) {
+        return -1;
+    }
+    while (!bad && fgets(line, sizeof(line), f)) {
+        size_t n = strlen(line);
+        char *name;
+        unsigned at;
+        unsigned index;
+        long long value;
+
+        if (n == 0 || line[n - 1] != '\n') {
+            bad = 1;
+            break;
+        }
+        line[n - 1] = '\0';
+        if (strncmp(line, "SF:", 3) == 0) {
+            if (!ended || grow(&sources, &size, count, sizeof(SourceCoverage)) != 0) {
+                bad = 1;
+                break;
+            }
+            sc = &sources[count++];
+            memset(sc, 0, sizeof(*sc));
+            bad = !(sc->path = strdup(line + 3));
+            ended = 0;
+            fnda = 0;
+        } else if (strcmp(line, "end_of_record") == 0) {
+            bad = ended;
+            ended = 1;
+        } else if (ended) {
+            continue; /* (TN: lines) */
+        } else if (strncmp(line, "FN:", 3) == 0 && (name = strchr(line, ',')) != NULL) {
+            if (grow(&sc->functions, &sc->functionSize, sc->functionCount, sizeof(FunctionCount)) != 0 ||
+                !(sc->functions[sc->functionCount].name = strdup(name + 1))) {
+                bad = 1;
+                break;
+            }
+            sc->functions[sc->functionCount].line = (unsigned)strtoul(line + 3, NULL, 10);
+            sc->functions[sc->functionCount].count = 0;
+            sc->functionCount++;
+        } else if (strncmp(line, "FNDA:", 5) == 0 && (name = strchr(line, ',')) != NULL) {
+            /* in the order of the FN: lines */
+            if (fnda >= sc->functionCount || strcmp(sc->functions[fnda].name, name + 1) != 0) {
+                bad = 1;
+                break;
+            }
+            sc->functions[fnda++].count = strtoll(line + 5, NULL, 10);
+        } else if (sscanf(line, "BRDA:%u,0,%u,%lld", &at, &index, &value) == 3 ||
+                   sscanf(line, "BRDA:%u,0,%u,-", &at, &index) == 2) {
+            if (grow(&sc->branches, &sc->branchSize, sc->branchCount, sizeof(BranchCount)) != 0) {
+                bad = 1;
+                break;
+            }
+            sc->branches[sc->branchCount].line = at;
+            sc->branches[sc->branchCount].index = index;
+            sc->branches[sc->branchCount].taken = line[n - 2] == '-' ? -1 : value;
+            sc->branchCount++;
+        } else if (sscanf(line, "DA:%u,%lld", &at, &value) == 2) {
+            if (grow(&sc->lines, &sc->lineSize, sc->lineCount, sizeof(LineCount)) != 0) {
+                bad = 1;
+                break;
+            }
+            sc->lines[sc->lineCount].line = at;
+            sc->lines[sc->lineCount].count = value;
+            sc->lineCount++;
+        }
+    }
+    fclose(f);
+
+    if (bad || !ended) {
+        for (size_t i = 0; i < count; i++) {
+            free_source(&sources[i]);
+        }
+        free(sources);
+        return -1;
+    }
+    *out = sources;
+    *outCount = count;
+    return 0;
+}
+
+/*
+ * write_cached writes the records of one object to a cache file,
+ * through a temporary file, so that runs sharing the cache
+ * never see half of one.
+ */
+static void write_cached(const char *path, const SourceCoverage *sources, size_t count)
+{
+    size_t n = strlen(path) + 32;
+    char *tmp = malloc(n);
+    FILE *f;
+
+    if (!tmp) {
+        return;
+    }
+    snprintf(tmp, n, "%s.%ld.tmp", path, (long)getpid());
+    f = fopen(tmp, "w");
+    if (f) {
+        for (size_t i = 0; i < count; i++) {
+            write_source(f, "", &sources[i]);
+        }
+        if (fclose(f) != 0 || rename(tmp, path) != 0) {
+            (void)remove(tmp);
+        }
+    }
+    free(tmp);
+}
+
+/*
+ * cover_cached is cover_object for a baseline, through the cache.
+ * Returns 0, or -1 after saying why.
+ */
+static int cover_cached(const char *cacheDir, const char *notesPath,
+                        SourceCoverage **out, size_t *outCount, int *hit)
+{
+    unsigned long long hash;
+    long long size;
+    size_t n = strlen(cacheDir) + 64;
+    char *path = malloc(n);
+    int result;
+
+    *hit = 0;
+    if (!path) {
+        fprintf(stderr, "gcov_lcov: out of memory\n");
+        return -1;
+    }
+    if (hash_file(notesPath, &hash, &size) != 0) {
+        fprintf(stderr, "gcov_lcov: cannot read %s: %s\n", notesPath, strerror(errno));
+        free(path);
+        return -1;
+    }
+    snprintf(path, n, "%s/%016llx-%llx-%d.info", cacheDir, hash, (unsigned long long)size, CACHE_VERSION);
+    if (read_cached(path, out, outCount) == 0) {
+        *hit = 1;
+        free(path);
+        return 0;
+    }
+    result = cover_object(notesPath, NULL, out, outCount);
+    if (result == 0) {
+        write_cached(path, *out, *outCount);
+    }
+    free(path);
+    return result;
+}
+
+/* ----------------------------------------------------------- */
+/* The object files found under the inputs: .gcda, or .gcno with -i */
+static char **names = NULL;
+static size_t nameCount = 0;
+static size_t nameSize = 0;
+static const char *nameSuffix = ".gcda";
+
+/*
+ * add_name is the nftw callback listing the object files of one input.
+ */
+static int add_name(const char *path, const struct stat *st, int type, struct FTW *ftw)
+{
+    size_t n = strlen(path);
+
+    (void)st; // ignore unused param
+    (void)ftw; // ignore unused param
+
+    if (type != FTW_F || n < 5 || strcmp(path + n - 5, nameSuffix) != 0) {
+        return 0;
+    }
+    if (grow(&names, &nameSize, nameCount, sizeof(char *)) != 0) {
+        return -1;
+    }
+    names[nameCount] = strdup(path);
+    return names[nameCount++] ? 0 : -1;
+}
+
+static int compare_name(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+typedef struct {
+    int baseline;
+    const char *cacheDir;       /* of baseline records, or NULL */
+    unsigned long cached;       /* records read from the cache */
+    size_t next;                /* next name to take */
+    SourceCoverage **results;   /* of each name */
+    size_t *resultCounts;
+    unsigned long failed;
+} CoverWork;
+
+static pthread_mutex_t workLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *cover_objects(void *arg)
+{
+    CoverWork *work = arg;
+
+    for (;;) {
+        char *notesPath;
+        size_t i;
+        int failed;
+        int hit = 0;
+
+        pthread_mutex_lock(&workLock);
+        i = work->next++;
+        pthread_mutex_unlock(&workLock);
+        if (i >= nameCount) {
+            break;
+        }
+
+        /* The .gcno file is next to the .gcda file */
+        notesPath = strdup(names[i]);
+        if (!notesPath) {
+            failed = 1;
+        } else {
+            strcpy(notesPath + strlen(notesPath) - 5, ".gcno");
+            if (work->baseline && work->cacheDir) {
+                failed = cover_cached(work->cacheDir, notesPath,
+                                      &work->results[i], &work->resultCounts[i], &hit) != 0;
+            } else {
+                failed = cover_object(notesPath, work->baseline ? NULL : names[i],
+                                      &work->results[i], &work->resultCounts[i]) != 0;
+            }
+            free(notesPath);
+        }
+        if (failed || hit) {
+            pthread_mutex_lock(&workLock);
+            work->failed += (unsigned long)failed;
+            work->cached += (unsigned long)hit;
+            pthread_mutex_unlock(&workLock);
+        }
+    }
+    return NULL;
+}
+
+/* ----------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+    CoverWork work;
+    SourceCoverage *all = NULL;
+    size_t allCount = 0;
+    size_t allSize = 0;
+    size_t written = 0;
+    const char *outPath = NULL;
+    const char *testName = "";
+    FILE *out = stdout;
+    pthread_t *tids;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int started = 0;
+    int argi = 1;
+    int status = 0;
+
+    memset(&work, 0, sizeof(work));
+    while (argi < argc && argv[argi][0] == '-') {
+        if (strcmp(argv[argi], "-o") == 0 && argi + 1 < argc) {
+            outPath = argv[argi + 1];
+            argi += 2;
+        } else if (strcmp(argv[argi], "-t") == 0 && argi + 1 < argc) {
+            testName = argv[argi + 1];
+            argi += 2;
+        } else if (strcmp(argv[argi], "-j") == 0 && argi + 1 < argc) {
+            threads = atol(argv[argi + 1]);
+            argi += 2;
+        } else if (strcmp(argv[argi], "-c") == 0 && argi + 1 < argc) {
+            work.cacheDir = argv[argi + 1];
+            argi += 2;
+        } else if (strcmp(argv[argi], "-i") == 0) {
+            work.baseline = 1;
+            argi++;
+        } else {
+            argi = argc;
+        }
+    }
+    if (argi >= argc) {
+        fprintf(stderr, "usage: gcov_lcov [-i [-c cachedir]] [-t testname] [-o file] [-j threads] dir ...\n");
+        return 2;
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    /* lcov --capture reads the .gcda files, --initial the .gcno files */
+    if (work.baseline) {
+        nameSuffix = ".gcno";
+    }
+    if (work.baseline && work.cacheDir) {
+        (void)mkdir(work.cacheDir, 0777);
+    }
+    for (int i = argi; i < argc; i++) {
+        if (nftw(argv[i], add_name, 16, FTW_PHYS) != 0) {
+            fprintf(stderr, "gcov_lcov: cannot list %s: %s\n", argv[i], strerror(errno));
+            return 1;
+        }
+    }
+    qsort(names, nameCount, sizeof(char *), compare_name);
+
+    work.results = calloc(nameCount + 1, sizeof(SourceCoverage *));
+    work.resultCounts = calloc(nameCount + 1, sizeof(size_t));
+    tids = malloc((size_t)threads * sizeof(pthread_t));
+    if (!work.results || !work.resultCounts) {
+        fprintf(stderr, "gcov_lcov: out of memory\n");
+        return 1;
+    }
+    for (; tids && started < threads && (size_t)started < nameCount; started++) {
+        if (pthread_create(&tids[started], NULL, cover_objects, &work) != 0) {
+            break;
+        }
+    }
+    if (started == 0) {
+        (void)cover_objects(&work);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    free(tids);
+
+    /* One record per source file, in order of their paths */
+    for (size_t i = 0; i < nameCount; i++) {
+        for (size_t k = 0; k < work.resultCounts[i]; k++) {
+            work.results[i][k].order = allCount;
+            if (append(&all, &allCount, &allSize, &work.results[i][k], 1, sizeof(SourceCoverage)) != 0) {
+                fprintf(stderr, "gcov_lcov: out of memory\n");
+                return 1;
+            }
+        }
+        free(work.results[i]);
+        free(names[i]);
+    }
+    qsort(all, allCount, sizeof(SourceCoverage), compare_source);
+
+    if (outPath && !(out = fopen(outPath, "w"))) {
+        fprintf(stderr, "gcov_lcov: cannot write %s: %s\n", outPath, strerror(errno));
+        return 1;
+    }
+    for (size_t i = 0; i < allCount;) {
+        size_t k = i + 1;
+
+        if (add_source(&all[i], NULL) != 0) {
+            status = 1;
+        }
+        for (; k < allCount && strcmp(all[k].path, all[i].path) == 0; k++) {
+            if (add_source(&all[i], &all[k]) != 0) {
+                status = 1;
+            }
+            free_source(&all[k]);
+        }
+        write_source(out, testName, &all[i]);
+        free_source(&all[i]);
+        written++;
+        i = k;
+    }
+    if (out != stdout && fclose(out) != 0) {
+        fprintf(stderr, "gcov_lcov: cannot write %s: %s\n", outPath, strerror(errno));
+        status = 1;
+    }
+
+    fprintf(stderr, "gcov_lcov: %lu object files, %lu source files, %lu not read\n",
+            (unsigned long)nameCount, (unsigned long)written, work.failed);
+    if (work.baseline && work.cacheDir) {
+        fprintf(stderr, "gcov_lcov: %lu of them from the cache\n", work.cached);
+    }
+
+    free(all);
+    free(names);
+    free(work.results);
+    free(work.resultCounts);
+    return (status || work.failed) ? 1 : 0;
+}
+
+/** @}
+ */
+/*
+ * embedded-gcov gcov_lcov.c host tool to write lcov tracefiles from gcno and gcda files
+ *
+ * Copyright (c) 2021 California Institute of Technology (“Caltech”).
+ * U.S. Government sponsorship acknowledged.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *        this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *        this list of conditions and the following disclaimer in the documentation
+ *        and/or other materials provided with the distribution.
+ *    Neither the name of Caltech nor its operating division, the Jet Propulsion Laboratory,
+ *        nor the names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
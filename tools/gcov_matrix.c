@@ -0,0 +1,638 @@
+/**********************************************************************/
+/** @addtogroup embedded_gcov
+ * @{
+ * @file
+ * @version $Id: $
+ *
+ * @brief Host tool to build a test by function coverage matrix.
+ *
+ * Typical usage: ./gcov_matrix -g ../objs -o ../results/matrix.csv ../results/tests/test_*
+ *
+ * Each input is a directory holding the .gcda files of one test,
+ * such as the test_<id> directories gcov_decode writes from the
+ * test dumps of GCOV_OPT_TEST_CAPTURE, which hold only the files
+ * the test ran code in. The functions are listed from the .gcno
+ * files under the -g directory, and each .gcda file is matched
+ * to the .gcno file with the same basename.
+ *
+ * The matrix is written as CSV: a heading line, then one line per
+ * function, with its source file, first line and name, and for
+ * each test (named after its directory) 1 if the test ran the
+ * function, 0 if not. A function ran if any of its arc counters
+ * is nonzero. A function listed by several objects (such as an
+ * inline function in a header) has one line, which counts a test
+ * as running it if any of the objects say so.
+ * So the tests to run again after a change are those with a 1
+ * on the lines of the functions that changed.
+ *
+ * Options:
+ *   -g dir   find the .gcno files under dir
+ *   -o file  write the matrix to file (default is standard output)
+ *
+ * Only the graph files of gcc 8 and later are understood.
+ * Exit status is 0 if every file was read and matched, 1 otherwise.
+ *
+ **********************************************************************/
+
+#define _XOPEN_SOURCE 700 /* for nftw */
+
+#include <errno.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "gcda_io.h"
+
+/* Compare to gcc/gcov-io.h */
+#define GCNO_MAGIC              0x67636e6fUL    /* "gcno" */
+#define GCNO_TAG_FUNCTION       0x01000000UL
+
+/* ----------------------------------------------------------- */
+/* One function of an object file, as read from its .gcno file */
+typedef struct {
+    unsigned long ident;
+    unsigned long cfgChecksum;
+    const char *name;
+    const char *source;
+    unsigned line;
+    size_t row;                 /* of the matrix */
+} Function;
+
+typedef struct {
+    char *stem;                 /* basename without .gcno */
+    unsigned char *data;        /* the file, which the strings point into */
+    Function *functions;
+    size_t functionCount;
+} Object;
+
+static Object *objects = NULL;
+static size_t objectCount = 0;
+static size_t objectSize = 0;
+
+/* A line of the matrix, one for each distinct function */
+typedef struct {
+    const char *source;
+    unsigned line;
+    const char *name;
+    unsigned char *ran;         /* per test */
+} Row;
+
+static Row *rows = NULL;
+static size_t rowCount = 0;
+
+/* Files that could not be read or matched */
+static unsigned long failures = 0;
+
+/*
+ * grow makes room for one more item in an array.
+ * Returns 0, or -1 when out of memory.
+ */
+static int grow(void *array, size_t *size, size_t count, size_t item)
+{
+    void **p = array;
+
+    if (count == *size) {
+        size_t n = *size ? *size * 2 : 64;
+        void *list = realloc(*p, n * item);
+
+        if (!list) {
+            return -1;
+        }
+        *p = list;
+        *size = n;
+    }
+    return 0;
+}
+
+/*
+ * stem_of returns the basename of path without its 5 character
+ * suffix, malloc'd, or NULL when out of memory.
+ */
+static char *stem_of(const char *path)
+{
+    const char *base = strrchr(path, '/');
+    char *stem;
+
+    base = base ? base + 1 : path;
+    stem = strdup(base);
+    if (stem && strlen(stem) >= 5) {
+        stem[strlen(stem) - 5] = '\0';
+    }
+    return stem;
+}
+
+/* ----------------------------------------------------------- */
+/* Read position in a .gcno file */
+typedef struct {
+    const unsigned char *data;
+    size_t length;
+    size_t pos;
+    int swap;
+    int major;
+    int bad;
+} Notes;
+
+static unsigned long read_word(Notes *notes)
+{
+    unsigned int w;
+
+    if (notes->pos > notes->length || notes->length - notes->pos < 4) {
+        notes->bad = 1;
+        return 0;
+    }
+    memcpy(&w, notes->data + notes->pos, 4);
+    notes->pos += 4;
+    if (notes->swap) {
+        w = ((w >> 24) & 0xff) | ((w >> 8) & 0xff00) | ((w << 8) & 0xff0000) | ((w << 24) & 0xff000000);
+    }
+    return w;
+}
+
+/*
+ * read_string returns the string at the read position,
+ * "" for an empty one, or NULL if damaged.
+ * Its length is in bytes since gcc 12, else in words (padded).
+ */
+static const char *read_string(Notes *notes)
+{
+    size_t bytes = read_word(notes);
+    const char *s = (const char *)notes->data + notes->pos;
+
+    if (notes->major < 12) {
+        bytes *= 4;
+    }
+    if (notes->bad || bytes > notes->length - notes->pos) {
+        notes->bad = 1;
+        return NULL;
+    }
+    notes->pos += bytes;
+    if (bytes == 0) {
+        return "";
+    }
+    return memchr(s, '\0', bytes) ? s : NULL;
+}
+
+/*
+ * read_functions reads the FUNCTION records of a .gcno file
+ * into object, leaving the other records alone.
+ * Returns 0, or -1 with *why set.
+ */
+static int read_functions(const char *path, Object *object, const char **why)
+{
+    FILE *f = fopen(path, "rb");
+    Notes notes;
+    struct stat st;
+    unsigned long version;
+    size_t functionSize = 0;
+
+    memset(&notes, 0, sizeof(notes));
+    if (!f || fstat(fileno(f), &st) != 0 || !(object->data = malloc((size_t)st.st_size + 1)) ||
+        fread(object->data, 1, (size_t)st.st_size, f) != (size_t)st.st_size) {
+        *why = strerror(errno);
+        if (f) {
+            fclose(f);
+        }
+        return -1;
+    }
+    fclose(f);
+    notes.data = object->data;
+    notes.length = (size_t)st.st_size;
+
+    if (read_word(&notes) != GCNO_MAGIC) {
+        notes.pos = 0;
+        notes.swap = 1;
+        if (read_word(&notes) != GCNO_MAGIC) {
+            *why = "not a gcno file";
+            return -1;
+        }
+    }
+    /* Version is like "B22*" for gcc 12.2, as in gcda_io.c */
+    version = read_word(&notes);
+    notes.major = (int)((version >> 24) & 0xff) - 'A';
+    notes.major = notes.major * 10 + (int)((version >> 16) & 0xff) - '0';
+    if (notes.major < 8) {
+        *why = "gcno file of gcc before 8";
+        return -1;
+    }
+    (void)read_word(&notes); /* stamp */
+    if (notes.major >= 12) {
+        (void)read_word(&notes); /* checksum */
+    }
+    (void)read_string(&notes); /* cwd */
+    (void)read_word(&notes); /* has_unexecuted_blocks */
+
+    while (!notes.bad && notes.length - notes.pos >= 8) {
+        unsigned long tag = read_word(&notes);
+        size_t length = read_word(&notes);
+        size_t end;
+
+        /* record lengths are in bytes for gcc 12 and later, else in words */
+        if (notes.major < 12) {
+            length *= 4;
+        }
+        if (length > notes.length - notes.pos) {
+            notes.bad = 1;
+            break;
+        }
+        end = notes.pos + length;
+        if (tag == GCNO_TAG_FUNCTION) {
+            Function *fn;
+
+            if (grow(&object->functions, &functionSize, object->functionCount,
+                     sizeof(Function)) != 0) {
+                *why = "out of memory";
+                return -1;
+            }
+            fn = &object->functions[object->functionCount++];
+            memset(fn, 0, sizeof(*fn));
+            fn->ident = read_word(&notes);
+            (void)read_word(&notes); /* lineno_checksum */
+            fn->cfgChecksum = read_word(&notes);
+            fn->name = read_string(&notes);
+            (void)read_word(&notes); /* artificial */
+            fn->source = read_string(&notes);
+            fn->line = (unsigned)read_word(&notes);
+            if (!fn->name || !fn->source || notes.pos > end) {
+                notes.bad = 1;
+            }
+        }
+        notes.pos = end;
+    }
+    if (notes.bad) {
+        *why = "damaged gcno file";
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * add_notes is the nftw callback reading the .gcno files under -g.
+ */
+static int add_notes(const char *path, const struct stat *st, int type, struct FTW *ftw)
+{
+    size_t n = strlen(path);
+    const char *why = NULL;
+    Object *object;
+
+    (void)st; // ignore unused param
+    (void)ftw; // ignore unused param
+
+    if (type != FTW_F || n < 5 || strcmp(path + n - 5, ".gcno") != 0) {
+        return 0;
+    }
+    if (grow(&objects, &objectSize, objectCount, sizeof(Object)) != 0) {
+        return -1;
+    }
+    object = &objects[objectCount];
+    memset(object, 0, sizeof(*object));
+    object->stem = stem_of(path);
+    if (!object->stem) {
+        return -1;
+    }
+    if (read_functions(path, object, &why) != 0) {
+        fprintf(stderr, "gcov_matrix: cannot read %s: %s\n", path, why);
+        free(object->stem);
+        free(object->data);
+        free(object->functions);
+        failures++;
+        return 0;
+    }
+    objectCount++;
+    return 0;
+}
+
+static int compare_object(const void *a, const void *b)
+{
+    return strcmp(((const Object *)a)->stem, ((const Object *)b)->stem);
+}
+
+static Object *find_object(const char *stem)
+{
+    Object key;
+
+    key.stem = (char *)stem;
+    return bsearch(&key, objects, objectCount, sizeof(Object), compare_object);
+}
+
+/* ----------------------------------------------------------- */
+static int compare_row(const void *a, const void *b)
+{
+    const Row *ra = a;
+    const Row *rb = b;
+    int c = strcmp(ra->source, rb->source);
+
+    if (c) {
+        return c;
+    }
+    if (ra->line != rb->line) {
+        return ra->line < rb->line ? -1 : 1;
+    }
+    return strcmp(ra->name, rb->name);
+}
+
+static const Row *sortRows;
+
+static int compare_row_index(const void *a, const void *b)
+{
+    size_t i = *(const size_t *)a;
+    size_t k = *(const size_t *)b;
+    int c = compare_row(&sortRows[i], &sortRows[k]);
+
+    return c ? c : (i > k) - (i < k);
+}
+
+/*
+ * make_rows gives each distinct function (by source, line
+ * and name) a row of the matrix, in that order, with room
+ * for tests columns. Returns 0, or -1 when out of memory.
+ */
+static int make_rows(size_t tests)
+{
+    Row *all = NULL;
+    size_t *order = NULL;
+    Function **owners = NULL;
+    size_t total = 0;
+    size_t n = 0;
+
+    for (size_t i = 0; i < objectCount; i++) {
+        total += objects[i].functionCount;
+    }
+    all = malloc((total ? total : 1) * sizeof(Row));
+    order = malloc((total ? total : 1) * sizeof(size_t));
+    owners = malloc((total ? total : 1) * sizeof(Function *));
+    rows = malloc((total ? total : 1) * sizeof(Row));
+    if (!all || !order || !owners || !rows) {
+        free(all);
+        free(order);
+        free(owners);
+        return -1;
+    }
+
+    for (size_t i = 0; i < objectCount; i++) {
+        for (size_t k = 0; k < objects[i].functionCount; k++) {
+            Function *fn = &objects[i].functions[k];
+
+            all[n].source = fn->source;
+            all[n].line = fn->line;
+            all[n].name = fn->name;
+            all[n].ran = NULL;
+            owners[n] = fn;
+            order[n] = n;
+            n++;
+        }
+    }
+    sortRows = all;
+    qsort(order, total, sizeof(size_t), compare_row_index);
+
+    for (size_t i = 0; i < total; i++) {
+        const Row *r = &all[order[i]];
+
+        if (i == 0 || compare_row(r, &all[order[i - 1]]) != 0) {
+            rows[rowCount] = *r;
+            rows[rowCount].ran = calloc(tests ? tests : 1, 1);
+            if (!rows[rowCount].ran) {
+                free(all);
+                free(order);
+                free(owners);
+                return -1;
+            }
+            rowCount++;
+        }
+        owners[order[i]]->row = rowCount - 1;
+    }
+
+    free(all);
+    free(order);
+    free(owners);
+    return 0;
+}
+
+/* ----------------------------------------------------------- */
+/* The test being read, for the nftw callback */
+static size_t currentTest;
+
+/*
+ * mark_data is the nftw callback marking the functions
+ * that ran, from one .gcda file of the current test.
+ */
+static int mark_data(const char *path, const struct stat *st, int type, struct FTW *ftw)
+{
+    size_t n = strlen(path);
+    const char *why = NULL;
+    GcdaInfo info;
+    Object *object;
+    char *stem;
+
+    (void)st; // ignore unused param
+    (void)ftw; // ignore unused param
+
+    if (type != FTW_F || n < 5 || strcmp(path + n - 5, ".gcda") != 0) {
+        return 0;
+    }
+    stem = stem_of(path);
+    if (!stem) {
+        return -1;
+    }
+    object = find_object(stem);
+    free(stem);
+    if (!object) {
+        fprintf(stderr, "gcov_matrix: no .gcno file for %s\n", path);
+        failures++;
+        return 0;
+    }
+    if (gcda_read(path, &info, &why) != 0) {
+        fprintf(stderr, "gcov_matrix: cannot read %s: %s\n", path, why);
+        failures++;
+        return 0;
+    }
+
+    for (size_t i = 0; i < info.functionCount; i++) {
+        const GcdaFunction *gf = &info.functions[i];
+        const Function *fn = NULL;
+        long long any = 0;
+
+        if (gf->empty) {
+            continue;
+        }
+        for (size_t k = 0; k < object->functionCount; k++) {
+            if (object->functions[k].ident == gf->ident) {
+                fn = &object->functions[k];
+                break;
+            }
+        }
+        if (!fn || fn->cfgChecksum != gf->cfgChecksum) {
+            fprintf(stderr, "gcov_matrix: %s is from another build than its .gcno file\n", path);
+            failures++;
+            break;
+        }
+        for (size_t c = 0; c < gf->counterCount; c++) {
+            if (gf->counters[c].tag != GCDA_TAG_FOR_COUNTER(0)) {
+                continue;
+            }
+            for (size_t v = 0; v < gf->counters[c].count; v++) {
+                any |= gf->counters[c].values[v];
+            }
+        }
+        if (any) {
+            rows[fn->row].ran[currentTest] = 1;
+        }
+    }
+
+    gcda_free(&info);
+    return 0;
+}
+
+/*
+ * write_field writes one CSV field, quoted if it needs to be.
+ */
+static void write_field(FILE *f, const char *s)
+{
+    if (!strpbrk(s, ",\"\n")) {
+        fputs(s, f);
+        return;
+    }
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"') {
+            fputc('"', f);
+        }
+        fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+/* ----------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+    const char *notesDir = NULL;
+    const char *outPath = NULL;
+    FILE *out = stdout;
+    size_t tests;
+    int argi = 1;
+
+    while (argi < argc && argv[argi][0] == '-') {
+        if (strcmp(argv[argi], "-g") == 0 && argi + 1 < argc) {
+            notesDir = argv[argi + 1];
+            argi += 2;
+        } else if (strcmp(argv[argi], "-o") == 0 && argi + 1 < argc) {
+            outPath = argv[argi + 1];
+            argi += 2;
+        } else {
+            argi = argc + 1;
+        }
+    }
+    if (!notesDir || argi >= argc) {
+        fprintf(stderr, "usage: gcov_matrix -g gcno_dir [-o matrix.csv] test_dir ...\n");
+        return 2;
+    }
+    tests = (size_t)(argc - argi);
+
+    if (nftw(notesDir, add_notes, 32, FTW_PHYS) != 0) {
+        fprintf(stderr, "gcov_matrix: cannot read %s: %s\n", notesDir, strerror(errno));
+        return 1;
+    }
+    qsort(objects, objectCount, sizeof(Object), compare_object);
+    for (size_t i = 1; i < objectCount; i++) {
+        if (strcmp(objects[i].stem, objects[i - 1].stem) == 0) {
+            fprintf(stderr, "gcov_matrix: more than one %s.gcno, matching only one\n",
+                    objects[i].stem);
+        }
+    }
+    if (make_rows(tests) != 0) {
+        fprintf(stderr, "gcov_matrix: out of memory\n");
+        return 1;
+    }
+
+    for (currentTest = 0; currentTest < tests; currentTest++) {
+        if (nftw(argv[argi + currentTest], mark_data, 32, FTW_PHYS) != 0) {
+            fprintf(stderr, "gcov_matrix: cannot read %s: %s\n",
+                    argv[argi + currentTest], strerror(errno));
+            failures++;
+        }
+    }
+
+    if (outPath) {
+        out = fopen(outPath, "w");
+        if (!out) {
+            fprintf(stderr, "gcov_matrix: cannot write %s: %s\n", outPath, strerror(errno));
+            return 1;
+        }
+    }
+
+    fputs("source,line,function", out);
+    for (size_t t = 0; t < tests; t++) {
+        char *name = strdup(argv[argi + t]);
+        char *base;
+        size_t n;
+
+        if (!name) {
+            fprintf(stderr, "gcov_matrix: out of memory\n");
+            return 1;
+        }
+        /* The test is named after its directory */
+        for (n = strlen(name); n > 1 && name[n - 1] == '/'; n--) {
+            name[n - 1] = '\0';
+        }
+        base = strrchr(name, '/');
+        fputc(',', out);
+        write_field(out, base && base[1] ? base + 1 : name);
+        free(name);
+    }
+    fputc('\n', out);
+
+    for (size_t r = 0; r < rowCount; r++) {
+        write_field(out, rows[r].source);
+        fprintf(out, ",%u,", rows[r].line);
+        write_field(out, rows[r].name);
+        for (size_t t = 0; t < tests; t++) {
+            fputs(rows[r].ran[t] ? ",1" : ",0", out);
+        }
+        fputc('\n', out);
+    }
+
+    if (out != stdout && fclose(out) != 0) {
+        fprintf(stderr, "gcov_matrix: cannot write %s: %s\n", outPath, strerror(errno));
+        return 1;
+    }
+    fprintf(stderr, "gcov_matrix: %zu functions, %zu tests, %lu files not read\n",
+            rowCount, tests, failures);
+
+    return failures ? 1 : 0;
+}
+
+/** @}
+ */
+/*
+ * embedded-gcov gcov_matrix.c host tool to build a test by function coverage matrix
+ *
+ * Copyright (c) 2021 California Institute of Technology (“Caltech”).
+ * U.S. Government sponsorship acknowledged.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *        this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *        this list of conditions and the following disclaimer in the documentation
+ *        and/or other materials provided with the distribution.
+ *    Neither the name of Caltech nor its operating division, the Jet Propulsion Laboratory,
+ *        nor the names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */